@@ -9,10 +9,9 @@
 
 #include "ai_vox_engine.h"
 #include "audio_device/audio_device_es8311.h"
+#include "audio_device/prompt_player.h"
 #include "components/espressif/button/button_gpio.h"
 #include "components/espressif/button/iot_button.h"
-#include "components/espressif/esp_audio_codec/esp_audio_simple_dec.h"
-#include "components/espressif/esp_audio_codec/esp_mp3_dec.h"
 #include "components/wifi_configurator/wifi_configurator.h"
 #include "display.h"
 #include "led_strip.h"
@@ -80,6 +79,7 @@ constexpr uint32_t kAudioSampleRate = 16000;
 
 i2c_master_bus_handle_t g_i2c_master_bus_handle = nullptr;
 std::shared_ptr<ai_vox::AudioDeviceEs8311> g_audio_device_es8311;
+std::unique_ptr<ai_vox::PromptPlayer> g_prompt_player;
 std::unique_ptr<Display> g_display;
 auto g_observer = std::make_shared<ai_vox::Observer>();
 button_handle_t g_button_boot_handle = nullptr;
@@ -241,70 +241,6 @@ void PrintMemInfo() {
 }
 #endif
 
-void PlayMp3(const uint8_t* data, size_t size) {
-  auto ret = esp_mp3_dec_register();
-  if (ret != ESP_AUDIO_ERR_OK) {
-    printf("Failed to register mp3 decoder: %d\n", ret);
-    abort();
-  }
-
-  esp_audio_simple_dec_handle_t decoder = nullptr;
-  esp_audio_simple_dec_cfg_t audio_dec_cfg{
-      .dec_type = ESP_AUDIO_SIMPLE_DEC_TYPE_MP3,
-      .dec_cfg = nullptr,
-      .cfg_size = 0,
-  };
-  ret = esp_audio_simple_dec_open(&audio_dec_cfg, &decoder);
-  if (ret != ESP_AUDIO_ERR_OK) {
-    printf("Failed to open mp3 decoder: %d\n", ret);
-    abort();
-  }
-  g_audio_device_es8311->OpenOutput(16000);
-
-  esp_audio_simple_dec_raw_t raw = {
-      .buffer = const_cast<uint8_t*>(data),
-      .len = size,
-      .eos = true,
-      .consumed = 0,
-      .frame_recover = ESP_AUDIO_SIMPLE_DEC_RECOVERY_NONE,
-  };
-
-  uint8_t* frame_data = (uint8_t*)malloc(4096);
-  esp_audio_simple_dec_out_t out_frame = {
-      .buffer = frame_data,
-      .len = 4096,
-      .needed_size = 0,
-      .decoded_size = 0,
-  };
-
-  while (raw.len > 0) {
-    const auto ret = esp_audio_simple_dec_process(decoder, &raw, &out_frame);
-    if (ret == ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
-      // Handle output buffer not enough case
-      out_frame.buffer = reinterpret_cast<uint8_t*>(realloc(out_frame.buffer, out_frame.needed_size));
-      if (out_frame.buffer == nullptr) {
-        break;
-      }
-      out_frame.len = out_frame.needed_size;
-      continue;
-    }
-
-    if (ret != ESP_AUDIO_ERR_OK) {
-      break;
-    }
-
-    g_audio_device_es8311->Write(reinterpret_cast<int16_t*>(out_frame.buffer), out_frame.decoded_size >> 1);
-    raw.len -= raw.consumed;
-    raw.buffer += raw.consumed;
-  }
-
-  free(frame_data);
-
-  g_audio_device_es8311->CloseOutput();
-  esp_audio_simple_dec_close(decoder);
-  esp_audio_dec_unregister(ESP_AUDIO_TYPE_MP3);
-}
-
 void ConfigureWifi() {
   printf("configure wifi\n");
   auto wifi_configurator = std::make_unique<WifiConfigurator>(WiFi, kSmartConfigType);
@@ -320,7 +256,7 @@ void ConfigureWifi() {
       wifi_configurator.get()));
 
   g_display->ShowStatus("网络配置中");
-  PlayMp3(kNotification0mp3, sizeof(kNotification0mp3));
+  g_prompt_player->Play(kNotification0mp3, sizeof(kNotification0mp3));
 
 #if defined(WIFI_SSID) && defined(WIFI_PASSWORD)
   printf("wifi config start with wifi: %s, %s\n", WIFI_SSID, WIFI_PASSWORD);
@@ -338,7 +274,7 @@ void ConfigureWifi() {
     } else if (state == WifiConfigurator::State::kSmartConfiguring) {
       printf("wifi smart configuring\n");
       g_display->ShowStatus("配网模式");
-      PlayMp3(kNetworkConfigModeMp3, sizeof(kNetworkConfigModeMp3));
+      g_prompt_player->Play(kNetworkConfigModeMp3, sizeof(kNetworkConfigModeMp3));
     } else if (state == WifiConfigurator::State::kFinished) {
       break;
     }
@@ -355,7 +291,7 @@ void ConfigureWifi() {
   printf("- subnet mask: %s\n", WiFi.subnetMask().toString().c_str());
 
   g_display->ShowStatus("网络已连接");
-  PlayMp3(kNetworkConnectedMp3, sizeof(kNetworkConnectedMp3));
+  g_prompt_player->Play(kNetworkConnectedMp3, sizeof(kNetworkConnectedMp3));
 }
 
 void InitMcpTools() {
@@ -438,6 +374,7 @@ void setup() {
   }
 
   g_display->ShowStatus("初始化");
+  g_prompt_player = std::make_unique<ai_vox::PromptPlayer>(g_audio_device_es8311);
   ConfigureWifi();
   InitMcpTools();
 
@@ -451,6 +388,8 @@ void setup() {
   printf("engine starting\n");
   g_display->ShowStatus("AI引擎启动中");
 
+  g_prompt_player->Wait();  // the engine opens the same output device
+
   ai_vox_engine.Start(g_audio_device_es8311, g_audio_device_es8311);
 
   printf("engine started\n");
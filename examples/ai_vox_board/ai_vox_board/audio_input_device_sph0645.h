@@ -5,6 +5,8 @@
 
 #include <driver/i2s_std.h>
 
+#include <vector>
+
 #include "audio_device/audio_input_device.h"
 
 class AudioInputDeviceSph0645 : public ai_vox::AudioInputDevice {
@@ -70,15 +72,16 @@ class AudioInputDeviceSph0645 : public ai_vox::AudioInputDevice {
   }
 
   size_t Read(int16_t* buffer, uint32_t samples) override {
-    auto raw_32bit_samples = new int32_t[samples];
+    if (raw_32bit_samples_.size() < samples) {
+      raw_32bit_samples_.resize(samples);
+    }
     size_t bytes_read = 0;
-    i2s_channel_read(i2s_rx_handle_, raw_32bit_samples, samples * sizeof(raw_32bit_samples[0]), &bytes_read, 1000);
+    i2s_channel_read(i2s_rx_handle_, raw_32bit_samples_.data(), samples * sizeof(raw_32bit_samples_[0]), &bytes_read, 1000);
 
     for (int i = 0; i < samples; i++) {
-      int32_t value = raw_32bit_samples[i] >> 14;
+      int32_t value = raw_32bit_samples_[i] >> 14;
       buffer[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
     }
-    delete[] raw_32bit_samples;
     return samples;
   }
 
@@ -105,6 +108,7 @@ class AudioInputDeviceSph0645 : public ai_vox::AudioInputDevice {
   };
   i2s_std_gpio_config_t gpio_cfg_;
   uint32_t sample_rate_ = 0;
+  std::vector<int32_t> raw_32bit_samples_;
 };
 
 #endif
\ No newline at end of file
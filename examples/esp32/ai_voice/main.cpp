@@ -4,10 +4,9 @@
 #include "audio_device/audio_input_device_i2s_std.h"
 #include "audio_device/audio_input_device_pdm.h"
 #include "audio_device/audio_output_device_i2s_std.h"
+#include "audio_device/prompt_player.h"
 #include "components/espressif/button/button_gpio.h"
 #include "components/espressif/button/iot_button.h"
-#include "components/espressif/esp_audio_codec/esp_audio_simple_dec.h"
-#include "components/espressif/esp_audio_codec/esp_mp3_dec.h"
 #include "components/wifi_configurator/wifi_configurator.h"
 #include "network_config_mode_mp3.h"
 #include "network_connected_mp3.h"
@@ -60,72 +59,9 @@ constexpr gpio_num_t kLedPin = GPIO_NUM_2;
 
 auto g_observer = std::make_shared<ai_vox::Observer>();
 auto g_audio_output_device = std::make_shared<ai_vox::AudioOutputDeviceI2sStd>(kSpeakerPinSck, kSpeakerPinWs, kSpeakerPinSd);
+std::unique_ptr<ai_vox::PromptPlayer> g_prompt_player;
 button_handle_t g_button_boot_handle = nullptr;
 
-void PlayMp3(const uint8_t* data, size_t size) {
-  auto ret = esp_mp3_dec_register();
-  if (ret != ESP_AUDIO_ERR_OK) {
-    printf("Failed to register mp3 decoder: %d\n", ret);
-    abort();
-  }
-
-  esp_audio_simple_dec_handle_t decoder = nullptr;
-  esp_audio_simple_dec_cfg_t audio_dec_cfg{
-      .dec_type = ESP_AUDIO_SIMPLE_DEC_TYPE_MP3,
-      .dec_cfg = nullptr,
-      .cfg_size = 0,
-  };
-  ret = esp_audio_simple_dec_open(&audio_dec_cfg, &decoder);
-  if (ret != ESP_AUDIO_ERR_OK) {
-    printf("Failed to open mp3 decoder: %d\n", ret);
-    abort();
-  }
-  g_audio_output_device->OpenOutput(16000);
-
-  esp_audio_simple_dec_raw_t raw = {
-      .buffer = const_cast<uint8_t*>(data),
-      .len = size,
-      .eos = true,
-      .consumed = 0,
-      .frame_recover = ESP_AUDIO_SIMPLE_DEC_RECOVERY_NONE,
-  };
-
-  uint8_t* frame_data = (uint8_t*)malloc(4096);
-  esp_audio_simple_dec_out_t out_frame = {
-      .buffer = frame_data,
-      .len = 4096,
-      .needed_size = 0,
-      .decoded_size = 0,
-  };
-
-  while (raw.len > 0) {
-    const auto ret = esp_audio_simple_dec_process(decoder, &raw, &out_frame);
-    if (ret == ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
-      // Handle output buffer not enough case
-      out_frame.buffer = reinterpret_cast<uint8_t*>(realloc(out_frame.buffer, out_frame.needed_size));
-      if (out_frame.buffer == nullptr) {
-        break;
-      }
-      out_frame.len = out_frame.needed_size;
-      continue;
-    }
-
-    if (ret != ESP_AUDIO_ERR_OK) {
-      break;
-    }
-
-    g_audio_output_device->Write(reinterpret_cast<int16_t*>(out_frame.buffer), out_frame.decoded_size >> 1);
-    raw.len -= raw.consumed;
-    raw.buffer += raw.consumed;
-  }
-
-  free(frame_data);
-
-  g_audio_output_device->CloseOutput();
-  esp_audio_simple_dec_close(decoder);
-  esp_audio_dec_unregister(ESP_AUDIO_TYPE_MP3);
-}
-
 #ifdef PRINT_HEAP_INFO_INTERVAL
 void PrintMemInfo() {
   if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0) {
@@ -183,7 +119,7 @@ void ConfigureWifi() {
       },
       wifi_configurator.get()));
 
-  PlayMp3(kNotification0mp3, sizeof(kNotification0mp3));
+  g_prompt_player->Play(kNotification0mp3, sizeof(kNotification0mp3));
 
 #if defined(WIFI_SSID) && defined(WIFI_PASSWORD)
   printf("wifi config start with wifi: %s, %s\n", WIFI_SSID, WIFI_PASSWORD);
@@ -199,7 +135,7 @@ void ConfigureWifi() {
       printf("wifi connecting\n");
     } else if (state == WifiConfigurator::State::kSmartConfiguring) {
       printf("wifi smart configuring\n");
-      PlayMp3(kNetworkConfigModeMp3, sizeof(kNetworkConfigModeMp3));
+      g_prompt_player->Play(kNetworkConfigModeMp3, sizeof(kNetworkConfigModeMp3));
     } else if (state == WifiConfigurator::State::kFinished) {
       break;
     }
@@ -215,7 +151,7 @@ void ConfigureWifi() {
   printf("- gateway:     %s\n", WiFi.gatewayIP().toString().c_str());
   printf("- subnet mask: %s\n", WiFi.subnetMask().toString().c_str());
 
-  PlayMp3(kNetworkConnectedMp3, sizeof(kNetworkConnectedMp3));
+  g_prompt_player->Play(kNetworkConnectedMp3, sizeof(kNetworkConnectedMp3));
 }
 
 void InitMcpTools() {
@@ -289,6 +225,7 @@ void setup() {
 
   ESP_ERROR_CHECK(iot_button_new_gpio_device(&btn_cfg, &gpio_cfg, &g_button_boot_handle));
 
+  g_prompt_player = std::make_unique<ai_vox::PromptPlayer>(g_audio_output_device);
   ConfigureWifi();
   InitMcpTools();
 
@@ -306,6 +243,7 @@ void setup() {
                                     {"Authorization", "Bearer test-token"},
                                 });
   printf("engine starting\n");
+  g_prompt_player->Wait();  // the engine opens the same output device
   ai_vox_engine.Start(audio_input_device, g_audio_output_device);
   printf("engine started\n");
 
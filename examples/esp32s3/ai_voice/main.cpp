@@ -5,10 +5,11 @@
 #include "audio_device/audio_input_device_i2s_std.h"
 #include "audio_device/audio_input_device_pdm.h"
 #include "audio_device/audio_output_device_i2s_std.h"
+#include "audio_device/audio_output_mixer.h"
+#include "audio_device/prompt_player.h"
+#include "audio_device/stream_player.h"
 #include "components/espressif/button/button_gpio.h"
 #include "components/espressif/button/iot_button.h"
-#include "components/espressif/esp_audio_codec/esp_audio_simple_dec.h"
-#include "components/espressif/esp_audio_codec/esp_mp3_dec.h"
 #include "components/wifi_configurator/wifi_configurator.h"
 #include "network_config_mode_mp3.h"
 #include "network_connected_mp3.h"
@@ -57,72 +58,11 @@ constexpr gpio_num_t kLedPin = GPIO_NUM_2;
 
 auto g_observer = std::make_shared<ai_vox::Observer>();
 auto g_audio_output_device = std::make_shared<ai_vox::AudioOutputDeviceI2sStd>(kSpeakerPinSck, kSpeakerPinWs, kSpeakerPinSd);
+std::unique_ptr<ai_vox::PromptPlayer> g_prompt_player;
+std::shared_ptr<ai_vox::AudioOutputMixer> g_audio_output_mixer;
+std::unique_ptr<ai_vox::StreamPlayer> g_stream_player;
 button_handle_t g_button_boot_handle = nullptr;
 
-void PlayMp3(const uint8_t* data, size_t size) {
-  auto ret = esp_mp3_dec_register();
-  if (ret != ESP_AUDIO_ERR_OK) {
-    printf("Failed to register mp3 decoder: %d\n", ret);
-    abort();
-  }
-
-  esp_audio_simple_dec_handle_t decoder = nullptr;
-  esp_audio_simple_dec_cfg_t audio_dec_cfg{
-      .dec_type = ESP_AUDIO_SIMPLE_DEC_TYPE_MP3,
-      .dec_cfg = nullptr,
-      .cfg_size = 0,
-  };
-  ret = esp_audio_simple_dec_open(&audio_dec_cfg, &decoder);
-  if (ret != ESP_AUDIO_ERR_OK) {
-    printf("Failed to open mp3 decoder: %d\n", ret);
-    abort();
-  }
-  g_audio_output_device->OpenOutput(16000);
-
-  esp_audio_simple_dec_raw_t raw = {
-      .buffer = const_cast<uint8_t*>(data),
-      .len = size,
-      .eos = true,
-      .consumed = 0,
-      .frame_recover = ESP_AUDIO_SIMPLE_DEC_RECOVERY_NONE,
-  };
-
-  uint8_t* frame_data = (uint8_t*)malloc(4096);
-  esp_audio_simple_dec_out_t out_frame = {
-      .buffer = frame_data,
-      .len = 4096,
-      .needed_size = 0,
-      .decoded_size = 0,
-  };
-
-  while (raw.len > 0) {
-    const auto ret = esp_audio_simple_dec_process(decoder, &raw, &out_frame);
-    if (ret == ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
-      // Handle output buffer not enough case
-      out_frame.buffer = reinterpret_cast<uint8_t*>(realloc(out_frame.buffer, out_frame.needed_size));
-      if (out_frame.buffer == nullptr) {
-        break;
-      }
-      out_frame.len = out_frame.needed_size;
-      continue;
-    }
-
-    if (ret != ESP_AUDIO_ERR_OK) {
-      break;
-    }
-
-    g_audio_output_device->Write(reinterpret_cast<int16_t*>(out_frame.buffer), out_frame.decoded_size >> 1);
-    raw.len -= raw.consumed;
-    raw.buffer += raw.consumed;
-  }
-
-  free(frame_data);
-
-  g_audio_output_device->CloseOutput();
-  esp_audio_simple_dec_close(decoder);
-  esp_audio_dec_unregister(ESP_AUDIO_TYPE_MP3);
-}
-
 void ConfigureWifi() {
   printf("configure wifi\n");
   auto wifi_configurator = std::make_unique<WifiConfigurator>(WiFi, kSmartConfigType);
@@ -137,7 +77,7 @@ void ConfigureWifi() {
       },
       wifi_configurator.get()));
 
-  PlayMp3(kNotification0mp3, sizeof(kNotification0mp3));
+  g_prompt_player->Play(kNotification0mp3, sizeof(kNotification0mp3));
 
 #if defined(WIFI_SSID) && defined(WIFI_PASSWORD)
   printf("wifi config start with wifi: %s, %s\n", WIFI_SSID, WIFI_PASSWORD);
@@ -153,7 +93,7 @@ void ConfigureWifi() {
       printf("wifi connecting\n");
     } else if (state == WifiConfigurator::State::kSmartConfiguring) {
       printf("wifi smart configuring\n");
-      PlayMp3(kNetworkConfigModeMp3, sizeof(kNetworkConfigModeMp3));
+      g_prompt_player->Play(kNetworkConfigModeMp3, sizeof(kNetworkConfigModeMp3));
     } else if (state == WifiConfigurator::State::kFinished) {
       break;
     }
@@ -169,7 +109,7 @@ void ConfigureWifi() {
   printf("- gateway:     %s\n", WiFi.gatewayIP().toString().c_str());
   printf("- subnet mask: %s\n", WiFi.subnetMask().toString().c_str());
 
-  PlayMp3(kNetworkConnectedMp3, sizeof(kNetworkConnectedMp3));
+  g_prompt_player->Play(kNetworkConnectedMp3, sizeof(kNetworkConnectedMp3));
 }
 
 #ifdef PRINT_HEAP_INFO_INTERVAL
@@ -241,6 +181,39 @@ void InitMcpTools() {
                     }  // parameter schema
   );
 
+  engine.AddMcpTool("self.music.play",                                                                      // tool name
+                    "Play music from an http(s) URL of an mp3, aac, m4a, ts, flac or wav file or stream.",  // tool description
+                    {
+                        {
+                            "url",  // parameter name
+                            ai_vox::ParamSchema<std::string>{
+                                .default_value = std::nullopt,
+                            },
+                        },
+                    }  // parameter schema
+  );
+
+  engine.AddMcpTool("self.music.stop",      // tool name
+                    "Stop playing music.",  // tool description
+                    {
+                        // empty
+                    }  // parameter schema
+  );
+
+  engine.AddMcpTool("self.music.seek",                                        // tool name
+                    "Jump to a position, in seconds, of the music playing.",  // tool description
+                    {
+                        {
+                            "position",  // parameter name
+                            ai_vox::ParamSchema<int64_t>{
+                                .default_value = std::nullopt,
+                                .min = 0,
+                                .max = std::nullopt,
+                            },
+                        },
+                    }  // parameter schema
+  );
+
   engine.AddMcpTool("self.led.set",                                           // tool name
                     "Set the state of the LED, true for on, false for off.",  // tool description
                     {
@@ -286,6 +259,11 @@ void setup() {
 
   ESP_ERROR_CHECK(iot_button_new_gpio_device(&btn_cfg, &gpio_cfg, &g_button_boot_handle));
 
+  // The prompts, the engine and the music share the speaker through a mixer. A prompt turns the engine down while it
+  // plays, the engine turns the music down while it speaks.
+  g_audio_output_mixer = std::make_shared<ai_vox::AudioOutputMixer>(g_audio_output_device, 24000);
+  g_prompt_player = std::make_unique<ai_vox::PromptPlayer>(g_audio_output_mixer->CreateSource({.priority = 2, .duck_gain = 40}));
+  g_prompt_player->Preload(kNotification0mp3, sizeof(kNotification0mp3));
   ConfigureWifi();
   InitMcpTools();
 
@@ -298,12 +276,16 @@ void setup() {
   auto& ai_vox_engine = ai_vox::Engine::GetInstance();
   ai_vox_engine.SetObserver(g_observer);
   ai_vox_engine.SetOtaUrl("https://api.tenclass.net/xiaozhi/ota/");
+  ai_vox_engine.SetTtsCacheSize(256 << 10);  // replay repeated phrases from PSRAM
   ai_vox_engine.ConfigWebsocket("wss://api.tenclass.net/xiaozhi/v1/",
                                 {
                                     {"Authorization", "Bearer test-token"},
                                 });
+  auto tts_output = g_audio_output_mixer->CreateSource({.priority = 1, .duck_gain = 20});
+  g_stream_player = std::make_unique<ai_vox::StreamPlayer>(g_audio_output_mixer->CreateSource({.buffer_duration = 60}));
+
   printf("engine starting\n");
-  ai_vox_engine.Start(audio_input_device, g_audio_output_device);
+  ai_vox_engine.Start(audio_input_device, tts_output);
   printf("engine started\n");
 
   ESP_ERROR_CHECK(iot_button_register_cb(
@@ -366,6 +348,8 @@ void loop() {
         }
         case ai_vox::ChatState::kListening: {
           printf("Listening...\n");
+          // Over the end of the reply when listening resumes by itself, the reply is ducked meanwhile.
+          g_prompt_player->Play(kNotification0mp3, sizeof(kNotification0mp3));
           break;
         }
         case ai_vox::ChatState::kSpeaking: {
@@ -405,6 +389,27 @@ void loop() {
         const auto volume = g_audio_output_device->volume();
         printf("on mcp tool call: self.audio_speaker.get_volume, volume: %" PRIu16 "\n", volume);
         engine.SendMcpCallResponse(mcp_tool_call_event->id, volume);
+      } else if ("self.music.play" == mcp_tool_call_event->name) {
+        const auto url_ptr = mcp_tool_call_event->param<std::string>("url");
+        if (url_ptr == nullptr) {
+          engine.SendMcpCallError(mcp_tool_call_event->id, "Missing valid argument: url");
+        } else if (g_stream_player->Play(*url_ptr)) {
+          engine.SendMcpCallResponse(mcp_tool_call_event->id, true);
+        } else {
+          engine.SendMcpCallError(mcp_tool_call_event->id, "Unsupported format");
+        }
+      } else if ("self.music.stop" == mcp_tool_call_event->name) {
+        g_stream_player->Stop();
+        engine.SendMcpCallResponse(mcp_tool_call_event->id, true);
+      } else if ("self.music.seek" == mcp_tool_call_event->name) {
+        const auto position_ptr = mcp_tool_call_event->param<int64_t>("position");
+        if (position_ptr == nullptr) {
+          engine.SendMcpCallError(mcp_tool_call_event->id, "Missing valid argument: position");
+        } else if (g_stream_player->Seek(*position_ptr)) {
+          engine.SendMcpCallResponse(mcp_tool_call_event->id, true);
+        } else {
+          engine.SendMcpCallError(mcp_tool_call_event->id, "The music playing cannot seek");
+        }
       } else if ("self.led.set" == mcp_tool_call_event->name) {
         const auto state_ptr = mcp_tool_call_event->param<bool>("state");
         if (state_ptr != nullptr) {
@@ -23,6 +23,16 @@ class Engine {
   virtual void SetObserver(std::shared_ptr<Observer> observer) = 0;
   virtual void SetOtaUrl(const std::string url) = 0;
   virtual void ConfigWebsocket(const std::string url, const std::map<std::string, std::string> headers) = 0;
+  // Audio carried by each uplink websocket message, in ms: 60 (default), 80, 100 or 120. Longer packets mean fewer messages.
+  virtual void SetAudioFrameDuration(const uint32_t frame_duration) = 0;
+  // Bytes of TTS audio kept on the device for sentences the server says again, which then play without waiting for the
+  // server. 0 (default) disables the cache. Best with PSRAM.
+  virtual void SetTtsCacheSize(const size_t size) = 0;
+  // Whether and how the uplink skips silence, see SilenceSuppressionConfig. On by default.
+  virtual void SetSilenceSuppression(const SilenceSuppressionConfig& config) = 0;
+  // Speed of the TTS playback in percent, from 50 to 200, without changing the pitch. 100 by default. Can be changed at
+  // any time, it takes effect within a frame.
+  virtual void SetSpeechSpeed(const uint32_t speed) = 0;
   virtual void AddMcpTool(std::string name, std::string description, std::map<std::string, ParamSchemaVariant> attributes) = 0;
   virtual void Start(std::shared_ptr<AudioInputDevice> audio_input_device, std::shared_ptr<AudioOutputDevice> audio_output_device) = 0;
   virtual void Advance() = 0;
@@ -12,7 +12,7 @@
 
 namespace ai_vox {
 
-using Event = std::variant<TextReceivedEvent, TextTranslatedEvent, StateChangedEvent, ActivationEvent, ChatMessageEvent, EmotionEvent, McpToolCallEvent>;
+using Event = std::variant<TextReceivedEvent, TextTranslatedEvent, StateChangedEvent, ActivationEvent, ChatMessageEvent, EmotionEvent, McpToolCallEvent, TurnSwitchEvent>;
 
 class Observer {
  public:
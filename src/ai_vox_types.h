@@ -3,6 +3,7 @@
 #ifndef _AI_VOX_TYPES_H_
 #define _AI_VOX_TYPES_H_
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <optional>
@@ -58,6 +59,11 @@ struct EmotionEvent {
   std::string emotion;
 };
 
+struct TurnSwitchEvent {
+  ChatState new_state;   // kListening or kSpeaking
+  int64_t duration_us;   // time taken to pause the previous turn's audio pipeline and resume the next one
+};
+
 struct McpToolCallEvent {
   int64_t id;
   std::string name;
@@ -96,6 +102,16 @@ struct McpToolCallEvent {
   };
 };
 
+// Frames the voice activity detector classifies as silence are not sent, but for one every |keep_alive_interval|. The
+// server hears the end of speech only from the audio it receives, so it may detect it up to |keep_alive_interval| late.
+struct SilenceSuppressionConfig {
+  bool enabled = true;
+  uint32_t threshold = 300;            // percent of the tracked noise floor a frame's level has to reach to be speech
+  uint32_t min_speech_level = 64;      // mean absolute amplitude, quieter frames are never speech
+  uint32_t hangover = 1000;            // ms, speech is held this long after the last speech frame
+  uint32_t keep_alive_interval = 500;  // ms
+};
+
 template <typename T>
 struct ParamSchema {
   static_assert(false, "You can only use ParamSchema<int64_t>, ParamSchema<std::string>, or ParamSchema<bool>.");
@@ -1,5 +1,8 @@
 #include "audio_device_es8311.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "core/espressif_esp_codec_dev/esp_codec_dev.h"
 #include "core/espressif_esp_codec_dev/esp_codec_dev_defaults.h"
 
@@ -9,6 +12,13 @@
 #include "core/clogger/clogger.h"
 
 namespace ai_vox {
+namespace {
+constexpr uint32_t kDmaDescNum = 4;
+constexpr uint32_t kDmaFrameNum = 240;
+// The codec reconfigures the channel to mono, the bound still covers a stereo DMA frame.
+constexpr size_t kMaxStreamFrameSamples = kDmaFrameNum * 2;
+}  // namespace
+
 AudioDeviceEs8311::AudioDeviceEs8311(const i2c_master_bus_handle_t i2c_master_bus_handle,
                                      const uint8_t i2c_addr,
                                      const i2c_port_t i2c_port,
@@ -18,12 +28,12 @@ AudioDeviceEs8311::AudioDeviceEs8311(const i2c_master_bus_handle_t i2c_master_bu
                                      const gpio_num_t ws,
                                      const gpio_num_t din,
                                      const gpio_num_t dout)
-    : sample_rate_(sample_rate) {
+    : sample_rate_(sample_rate), stream_(&ConvertSamples, kMaxStreamFrameSamples) {
   i2s_chan_config_t chan_cfg = {
       .id = I2S_NUM_0,
       .role = I2S_ROLE_MASTER,
-      .dma_desc_num = 4,
-      .dma_frame_num = 240,
+      .dma_desc_num = kDmaDescNum,
+      .dma_frame_num = kDmaFrameNum,
       .auto_clear_after_cb = true,
       .auto_clear_before_cb = false,
       .allow_pd = false,
@@ -53,6 +63,7 @@ AudioDeviceEs8311::AudioDeviceEs8311(const i2c_master_bus_handle_t i2c_master_bu
 
   ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_handle_, &std_cfg));
   ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle_, &std_cfg));
+  drain_.Register(tx_handle_, kDmaDescNum);
   ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
   ESP_ERROR_CHECK(i2s_channel_enable(rx_handle_));
 
@@ -129,6 +140,22 @@ bool AudioDeviceEs8311::OpenInput(uint32_t sample_rate) {
 }
 
 void AudioDeviceEs8311::CloseInput() {
+  StopStream();
+}
+
+bool AudioDeviceEs8311::StartStream(StreamBufferHandle_t stream) {
+  return stream_.Start(rx_handle_, stream);
+}
+
+void AudioDeviceEs8311::StopStream() {
+  stream_.Stop(rx_handle_);
+}
+
+size_t IRAM_ATTR AudioDeviceEs8311::ConvertSamples(const void* dma_buffer, size_t bytes, int16_t* pcm, size_t max_samples) {
+  // No std::min here, an out of line instantiation would live in flash.
+  const size_t samples = bytes / sizeof(int16_t) < max_samples ? bytes / sizeof(int16_t) : max_samples;
+  memcpy(pcm, dma_buffer, samples * sizeof(int16_t));
+  return samples;
 }
 
 size_t AudioDeviceEs8311::Read(int16_t* buffer, uint32_t samples) {
@@ -154,9 +181,14 @@ size_t AudioDeviceEs8311::Write(const int16_t* pcm, size_t samples) {
     CLOGE("read failed with: %d", ret);
     abort();
   }
+  drain_.MarkWritten();
   return samples;
 }
 
+bool AudioDeviceEs8311::WaitForDrained(const uint32_t timeout_ms) {
+  return drain_.WaitForDrained(timeout_ms);
+}
+
 void AudioDeviceEs8311::set_volume(uint16_t volume) {
   volume_ = volume;
   ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(audio_device_, volume_));
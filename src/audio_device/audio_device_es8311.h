@@ -10,6 +10,8 @@
 
 #include "audio_input_device.h"
 #include "audio_output_device.h"
+#include "i2s_input_stream.h"
+#include "i2s_output_drain.h"
 
 struct audio_codec_data_if_t;
 struct audio_codec_ctrl_if_t;
@@ -38,6 +40,8 @@ class AudioDeviceEs8311 : public AudioInputDevice, public AudioOutputDevice {
   uint32_t input_sample_rate() override {
     return sample_rate_;
   }
+  bool StartStream(StreamBufferHandle_t stream) override;
+  void StopStream() override;
 
   bool OpenOutput(uint32_t sample_rate) override;
   void CloseOutput() override;
@@ -45,6 +49,7 @@ class AudioDeviceEs8311 : public AudioInputDevice, public AudioOutputDevice {
   uint32_t output_sample_rate() override {
     return sample_rate_;
   }
+  bool WaitForDrained(const uint32_t timeout_ms) override;
 
   void set_volume(uint16_t volume) override;
   uint16_t volume() const override;
@@ -52,6 +57,7 @@ class AudioDeviceEs8311 : public AudioInputDevice, public AudioOutputDevice {
  private:
   AudioDeviceEs8311(const AudioDeviceEs8311&) = delete;
   AudioDeviceEs8311& operator=(const AudioDeviceEs8311&) = delete;
+  static size_t IRAM_ATTR ConvertSamples(const void* dma_buffer, size_t bytes, int16_t* pcm, size_t max_samples);
 
   uint32_t sample_rate_ = 0;
   i2s_chan_handle_t tx_handle_ = nullptr;
@@ -64,6 +70,8 @@ class AudioDeviceEs8311 : public AudioInputDevice, public AudioOutputDevice {
   uint16_t volume_ = 80;
   std::shared_ptr<AudioInputDevice> audio_input_device_;
   std::shared_ptr<AudioOutputDevice> audio_output_device_;
+  I2sInputStream stream_;
+  I2sOutputDrain drain_;
 };
 }  // namespace ai_vox
 #endif
\ No newline at end of file
@@ -3,6 +3,9 @@
 #ifndef _AUDIO_INPUT_DEVICE_H_
 #define _AUDIO_INPUT_DEVICE_H_
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/stream_buffer.h>
+
 #include <cstdint>
 #include <vector>
 
@@ -14,6 +17,16 @@ class AudioInputDevice {
   virtual void CloseInput() = 0;
   virtual size_t Read(int16_t* buffer, uint32_t samples) = 0;
   virtual uint32_t input_sample_rate() = 0;
+
+  // Optional push mode. After OpenInput(), the device writes the 16-bit PCM of every received DMA frame into |stream|
+  // from its receive interrupt instead of waiting to be polled with Read(), so a reader blocked on the stream buffer
+  // wakes only once its trigger level is reached. Stops with StopStream() or CloseInput(). Returns false if unsupported.
+  virtual bool StartStream(StreamBufferHandle_t stream) {
+    return false;
+  }
+
+  virtual void StopStream() {
+  }
 };
 }  // namespace ai_vox
 
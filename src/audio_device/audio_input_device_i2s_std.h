@@ -5,12 +5,17 @@
 
 #include <driver/i2s_std.h>
 
+#include <algorithm>
+
 #include "audio_input_device.h"
+#include "core/flex_array/flex_array.h"
+#include "i2s_input_stream.h"
 
 namespace ai_vox {
 class AudioInputDeviceI2sStd : public AudioInputDevice {
  public:
-  AudioInputDeviceI2sStd(gpio_num_t bclk, gpio_num_t ws, gpio_num_t din) : pin_bclk_(bclk), pin_ws_(ws), pin_din_(din) {
+  AudioInputDeviceI2sStd(gpio_num_t bclk, gpio_num_t ws, gpio_num_t din)
+      : pin_bclk_(bclk), pin_ws_(ws), pin_din_(din), stream_(&ConvertSamples, kDmaFrameNum) {
   }
 
   ~AudioInputDeviceI2sStd() {
@@ -24,7 +29,7 @@ class AudioInputDeviceI2sStd : public AudioInputDevice {
         .id = I2S_NUM_0,
         .role = I2S_ROLE_MASTER,
         .dma_desc_num = 2,
-        .dma_frame_num = 320,
+        .dma_frame_num = kDmaFrameNum,
         .auto_clear_after_cb = true,
         .auto_clear_before_cb = false,
         .allow_pd = false,
@@ -58,6 +63,7 @@ class AudioInputDeviceI2sStd : public AudioInputDevice {
     if (i2s_rx_handle_ == nullptr) {
       return;
     }
+    stream_.Reset();
     i2s_channel_disable(i2s_rx_handle_);
     i2s_del_channel(i2s_rx_handle_);
     i2s_rx_handle_ = nullptr;
@@ -65,14 +71,16 @@ class AudioInputDeviceI2sStd : public AudioInputDevice {
   }
 
   size_t Read(int16_t* buffer, uint32_t samples) override {
-    auto raw_32bit_samples = new int32_t[samples];
+    if (raw_32bit_samples_.size() < samples) {
+      raw_32bit_samples_.Resize(samples);
+    }
+    const auto raw_32bit_samples = raw_32bit_samples_.data();
     i2s_channel_read(i2s_rx_handle_, raw_32bit_samples, samples * sizeof(raw_32bit_samples[0]), nullptr, 1000);
 
     for (int i = 0; i < samples; i++) {
       int32_t value = raw_32bit_samples[i] >> 12;
       buffer[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
     }
-    delete[] raw_32bit_samples;
     return samples;
   }
 
@@ -80,11 +88,32 @@ class AudioInputDeviceI2sStd : public AudioInputDevice {
     return sample_rate_;
   }
 
+  bool StartStream(StreamBufferHandle_t stream) override {
+    return stream_.Start(i2s_rx_handle_, stream);
+  }
+
+  void StopStream() override {
+    stream_.Stop(i2s_rx_handle_);
+  }
+
+  static size_t IRAM_ATTR ConvertSamples(const void* dma_buffer, size_t bytes, int16_t* pcm, size_t max_samples) {
+    const auto raw_32bit_samples = static_cast<const int32_t*>(dma_buffer);
+    const size_t samples = bytes / sizeof(int32_t) < max_samples ? bytes / sizeof(int32_t) : max_samples;
+    for (size_t i = 0; i < samples; i++) {
+      const int32_t value = raw_32bit_samples[i] >> 12;
+      pcm[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+    }
+    return samples;
+  }
+
+  static constexpr uint32_t kDmaFrameNum = 320;
   const gpio_num_t pin_bclk_ = GPIO_NUM_NC;
   const gpio_num_t pin_ws_ = GPIO_NUM_NC;
   const gpio_num_t pin_din_ = GPIO_NUM_NC;
   i2s_chan_handle_t i2s_rx_handle_ = nullptr;
   uint32_t sample_rate_ = 0;
+  FlexArray<int32_t> raw_32bit_samples_{0, MemoryPlacement::kDma};
+  I2sInputStream stream_;
 };
 }  // namespace ai_vox
 #endif
\ No newline at end of file
@@ -2,12 +2,16 @@
 
 #include <driver/i2s_pdm.h>
 
+#include <algorithm>
+#include <cstring>
+
 #include "audio_input_device.h"
+#include "i2s_input_stream.h"
 
 namespace ai_vox {
 class PdmAudioInputDevice : public AudioInputDevice {
  public:
-  PdmAudioInputDevice(gpio_num_t clk, gpio_num_t din) : clk_pin_(clk), din_pin_(din) {
+  PdmAudioInputDevice(gpio_num_t clk, gpio_num_t din) : clk_pin_(clk), din_pin_(din), stream_(&ConvertSamples, kDmaFrameNum) {
   }
   ~PdmAudioInputDevice() {
     CloseInput();
@@ -20,7 +24,7 @@ class PdmAudioInputDevice : public AudioInputDevice {
         .id = I2S_NUM_0,
         .role = I2S_ROLE_MASTER,
         .dma_desc_num = 2,
-        .dma_frame_num = 240,
+        .dma_frame_num = kDmaFrameNum,
         .auto_clear_after_cb = true,
         .auto_clear_before_cb = false,
         .allow_pd = false,
@@ -50,6 +54,7 @@ class PdmAudioInputDevice : public AudioInputDevice {
     if (i2s_rx_handle_ == nullptr) {
       return;
     }
+    stream_.Reset();
     i2s_channel_disable(i2s_rx_handle_);
     i2s_del_channel(i2s_rx_handle_);
     i2s_rx_handle_ = nullptr;
@@ -64,10 +69,26 @@ class PdmAudioInputDevice : public AudioInputDevice {
     return sample_rate_;
   }
 
+  bool StartStream(StreamBufferHandle_t stream) override {
+    return stream_.Start(i2s_rx_handle_, stream);
+  }
+
+  void StopStream() override {
+    stream_.Stop(i2s_rx_handle_);
+  }
+
  private:
+  static size_t IRAM_ATTR ConvertSamples(const void* dma_buffer, size_t bytes, int16_t* pcm, size_t max_samples) {
+    const size_t samples = bytes / sizeof(int16_t) < max_samples ? bytes / sizeof(int16_t) : max_samples;
+    memcpy(pcm, dma_buffer, samples * sizeof(int16_t));
+    return samples;
+  }
+
+  static constexpr uint32_t kDmaFrameNum = 240;
   const gpio_num_t clk_pin_ = GPIO_NUM_NC;
   const gpio_num_t din_pin_ = GPIO_NUM_NC;
   i2s_chan_handle_t i2s_rx_handle_ = nullptr;
   uint32_t sample_rate_ = 0;
+  I2sInputStream stream_;
 };
 }  // namespace ai_vox
@@ -19,6 +19,12 @@ class AudioOutputDevice {
   virtual void set_volume(uint16_t volume) = 0;
   virtual uint16_t volume() const = 0;
   virtual uint32_t output_sample_rate() = 0;
+
+  // Blocks until every sample written so far has left the DMA engine, or |timeout_ms| has passed. Returns false if the
+  // device cannot tell or the timeout expired, the audio may then still be playing.
+  virtual bool WaitForDrained(const uint32_t timeout_ms) {
+    return false;
+  }
 };
 }  // namespace ai_vox
 
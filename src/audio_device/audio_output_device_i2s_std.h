@@ -9,6 +9,8 @@
 #include <cmath>
 
 #include "audio_output_device.h"
+#include "core/flex_array/flex_array.h"
+#include "i2s_output_drain.h"
 
 namespace ai_vox {
 class AudioOutputDeviceI2sStd : public AudioOutputDevice {
@@ -41,7 +43,7 @@ class AudioOutputDeviceI2sStd : public AudioOutputDevice {
         .id = I2S_NUM_0,
 #endif
         .role = I2S_ROLE_MASTER,
-        .dma_desc_num = 2,
+        .dma_desc_num = kDmaDescNum,
         .dma_frame_num = 480,
         .auto_clear_after_cb = true,
         .auto_clear_before_cb = false,
@@ -67,6 +69,7 @@ class AudioOutputDeviceI2sStd : public AudioOutputDevice {
                                    }};
     tx_std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_BOTH;
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(i2s_tx_handle_, &tx_std_cfg));
+    drain_.Register(i2s_tx_handle_, kDmaDescNum);
     ESP_ERROR_CHECK(i2s_channel_enable(i2s_tx_handle_));
     sample_rate_ = sample_rate;
     return true;
@@ -83,8 +86,11 @@ class AudioOutputDeviceI2sStd : public AudioOutputDevice {
     sample_rate_ = 0;
   }
   size_t Write(const int16_t* pcm, size_t samples) override {
-    std::vector<int32_t> buffer(samples);
+    if (buffer_.size() < samples) {
+      buffer_.Resize(samples);
+    }
 
+    auto buffer = buffer_.data();
     for (size_t i = 0; i < samples; i++) {
       int64_t temp = int64_t(pcm[i]) * volume_factor_;
       if (temp > INT32_MAX) {
@@ -97,14 +103,21 @@ class AudioOutputDeviceI2sStd : public AudioOutputDevice {
     }
 
     size_t bytes_written = 0;
-    ESP_ERROR_CHECK(i2s_channel_write(i2s_tx_handle_, buffer.data(), buffer.size() * sizeof(int32_t), &bytes_written, 1000));
-    return buffer.size();
+    ESP_ERROR_CHECK(i2s_channel_write(i2s_tx_handle_, buffer_.data(), samples * sizeof(int32_t), &bytes_written, 1000));
+    drain_.MarkWritten();
+    return samples;
   }
   uint32_t output_sample_rate() override {
     return sample_rate_;
   }
 
+  bool WaitForDrained(const uint32_t timeout_ms) override {
+    return i2s_tx_handle_ != nullptr && drain_.WaitForDrained(timeout_ms);
+  }
+
  private:
+  static constexpr uint32_t kDmaDescNum = 2;
+
   i2s_chan_handle_t i2s_tx_handle_ = nullptr;
   const gpio_num_t pin_bclk_ = I2S_GPIO_UNUSED;
   const gpio_num_t pin_ws_ = I2S_GPIO_UNUSED;
@@ -112,6 +125,8 @@ class AudioOutputDeviceI2sStd : public AudioOutputDevice {
   std::atomic<uint16_t> volume_ = 70;
   std::atomic<int32_t> volume_factor_ = pow(double(volume_) / 100.0, 2) * 65536;
   uint32_t sample_rate_ = 0;
+  FlexArray<int32_t> buffer_{0, MemoryPlacement::kDma};  // the driver copies it into its DMA buffers
+  I2sOutputDrain drain_;
 };
 }  // namespace ai_vox
 
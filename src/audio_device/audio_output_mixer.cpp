@@ -0,0 +1,255 @@
+#include "audio_output_mixer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "components/task_queue/active_task_queue.h"
+
+#ifndef CLOGGER_SEVERITY
+#define CLOGGER_SEVERITY CLOGGER_SEVERITY_WARN
+#endif
+#include "core/clogger/clogger.h"
+
+namespace ai_vox {
+namespace {
+constexpr uint32_t kMixChunkDuration = 10;  // ms
+constexpr int32_t kUnityGain = 1 << 15;     // Q15
+
+int32_t PercentToGain(const uint16_t percent) {
+  return static_cast<int32_t>(std::min<uint16_t>(percent, AudioOutputDevice::kMaxVolume)) * kUnityGain / AudioOutputDevice::kMaxVolume;
+}
+}  // namespace
+
+AudioOutputMixer::Source::Source(std::shared_ptr<AudioOutputMixer> mixer, const Config& config)
+    : mixer_(std::move(mixer)),
+      priority_(config.priority),
+      duck_gain_(PercentToGain(config.duck_gain)),
+      buffer_duration_(config.buffer_duration),
+      volume_(config.gain),
+      gain_(PercentToGain(config.gain)) {
+}
+
+AudioOutputMixer::Source::~Source() {
+  CloseOutput();
+  if (ring_ != nullptr) {
+    vStreamBufferDelete(ring_);
+  }
+}
+
+bool AudioOutputMixer::Source::OpenOutput(uint32_t sample_rate) {
+  if (open_) {
+    return true;
+  }
+  mixer_->Attach(this);
+  open_ = true;
+  return true;
+}
+
+void AudioOutputMixer::Source::CloseOutput() {
+  if (!open_) {
+    return;
+  }
+  mixer_->Detach(this);
+  xStreamBufferReset(ring_);
+  open_ = false;
+}
+
+size_t AudioOutputMixer::Source::Write(const int16_t* pcm, size_t samples) {
+  if (!open_) {
+    return 0;
+  }
+
+  const auto data = reinterpret_cast<const uint8_t*>(pcm);
+  const size_t bytes = samples * sizeof(int16_t);
+  size_t sent = 0;
+  while (sent < bytes) {
+    const auto ret = xStreamBufferSend(ring_, data + sent, bytes - sent, pdMS_TO_TICKS(1000));
+    xSemaphoreGive(mixer_->data_sem_);
+    if (ret == 0) {
+      CLOGW("mixer stalled");
+      break;
+    }
+    sent += ret;
+  }
+  return sent / sizeof(int16_t);
+}
+
+void AudioOutputMixer::Source::set_volume(uint16_t volume) {
+  volume_ = std::min(volume, kMaxVolume);
+  gain_ = PercentToGain(volume);
+}
+
+uint16_t AudioOutputMixer::Source::volume() const {
+  return volume_;
+}
+
+uint32_t AudioOutputMixer::Source::output_sample_rate() {
+  return mixer_->output_sample_rate();
+}
+
+bool AudioOutputMixer::Source::WaitForDrained(const uint32_t timeout_ms) {
+  const auto deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+  if (!open_ || !mixer_->WaitForMixed(this, deadline)) {
+    return false;
+  }
+  const auto remaining = static_cast<int32_t>(deadline - xTaskGetTickCount());
+  return remaining > 0 && mixer_->audio_output_device_->WaitForDrained(remaining * portTICK_PERIOD_MS);
+}
+
+AudioOutputMixer::AudioOutputMixer(std::shared_ptr<AudioOutputDevice> audio_output_device, const uint32_t sample_rate)
+    : audio_output_device_(std::move(audio_output_device)), sample_rate_(sample_rate), data_sem_(xSemaphoreCreateBinary()) {
+  assert(data_sem_ != nullptr);
+  mix_task_queue_ = new ActiveTaskQueue("AudioMixer", 4 << 10, tskIDLE_PRIORITY + 2);
+}
+
+AudioOutputMixer::~AudioOutputMixer() {
+  // Every source holds a reference, so none is attached any more.
+  delete mix_task_queue_;
+  vSemaphoreDelete(data_sem_);
+}
+
+std::shared_ptr<AudioOutputMixer::Source> AudioOutputMixer::CreateSource(const Source::Config& config) {
+  return std::make_shared<Source>(shared_from_this(), config);
+}
+
+void AudioOutputMixer::Attach(Source* source) {
+  std::lock_guard attach_lock(attach_mutex_);
+  if (sources_.empty()) {
+    Open();
+  }
+
+  const size_t ring_bytes = output_sample_rate_ / 1000 * source->buffer_duration_ * sizeof(int16_t);
+  if (ring_bytes != source->ring_bytes_) {
+    if (source->ring_ != nullptr) {
+      vStreamBufferDelete(source->ring_);
+    }
+    source->ring_ = xStreamBufferCreate(ring_bytes, sizeof(int16_t));
+    assert(source->ring_ != nullptr);
+    source->ring_bytes_ = ring_bytes;
+  }
+
+  std::lock_guard lock(mutex_);
+  sources_.push_back(source);
+}
+
+void AudioOutputMixer::Detach(Source* source) {
+  std::lock_guard attach_lock(attach_mutex_);
+  {
+    std::lock_guard lock(mutex_);
+    auto it = std::find(sources_.begin(), sources_.end(), source);
+    if (it == sources_.end()) {
+      return;
+    }
+    sources_.erase(it);
+  }
+
+  if (sources_.empty()) {
+    Close();
+  }
+}
+
+void AudioOutputMixer::Open() {
+  CLOGI();
+  audio_output_device_->OpenOutput(sample_rate_);
+  output_sample_rate_ = audio_output_device_->output_sample_rate();
+  const size_t chunk = output_sample_rate_ / 1000 * kMixChunkDuration;
+  mix_.resize(chunk);
+  pcm_.resize(chunk);
+
+  const auto run = run_.load();
+  mix_task_queue_->Enqueue([this, run]() { Mix(run); });
+  CLOGI("OK, %" PRIu32 " Hz", output_sample_rate_.load());
+}
+
+void AudioOutputMixer::Close() {
+  CLOGI();
+  ++run_;
+  xSemaphoreGive(data_sem_);
+  mix_task_queue_->Sync();
+  {
+    std::lock_guard lock(mutex_);
+    busy_ = false;
+  }
+  mixed_condition_.notify_all();
+  audio_output_device_->CloseOutput();
+  CLOGI("OK");
+}
+
+void AudioOutputMixer::Mix(const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
+
+  size_t mixed = 0;
+  {
+    std::lock_guard lock(mutex_);
+    for (auto* source : sources_) {
+      const size_t available = xStreamBufferBytesAvailable(source->ring_) / sizeof(int16_t);
+      source->active_ = available > 0;
+      if (source->active_) {
+        mixed = std::min(mixed == 0 ? pcm_.size() : mixed, available);
+      }
+    }
+    busy_ = mixed > 0;
+
+    std::fill(mix_.begin(), mix_.end(), 0);
+    for (auto* source : sources_) {
+      if (!source->active_) {
+        source->current_gain_ = -1;
+        continue;
+      }
+
+      int32_t gain = source->gain_;
+      for (const auto* other : sources_) {
+        if (other->active_ && other->priority_ > source->priority_) {
+          gain = gain * other->duck_gain_ >> 15;
+        }
+      }
+      if (source->current_gain_ < 0) {
+        source->current_gain_ = gain;  // starting to play, nothing to ramp from
+      }
+
+      // Every active source has at least |mixed| samples queued.
+      const size_t samples = xStreamBufferReceive(source->ring_, pcm_.data(), mixed * sizeof(int16_t), 0) / sizeof(int16_t);
+      const int32_t from = source->current_gain_;
+      for (size_t i = 0; i < samples; i++) {
+        const int32_t ramped_gain = from + (gain - from) * static_cast<int32_t>(i) / static_cast<int32_t>(samples);
+        mix_[i] += pcm_[i] * ramped_gain >> 15;
+      }
+      source->current_gain_ = gain;
+    }
+  }
+
+  if (mixed == 0) {
+    xSemaphoreTake(data_sem_, pdMS_TO_TICKS(kMixChunkDuration));
+    mix_task_queue_->Enqueue([this, run]() { Mix(run); });
+    return;
+  }
+
+  for (size_t i = 0; i < mixed; i++) {
+    pcm_[i] = static_cast<int16_t>(std::clamp<int32_t>(mix_[i], INT16_MIN, INT16_MAX));
+  }
+  audio_output_device_->Write(pcm_.data(), mixed);
+  {
+    std::lock_guard lock(mutex_);
+    busy_ = false;
+  }
+  mixed_condition_.notify_all();
+
+  mix_task_queue_->Enqueue([this, run]() { Mix(run); });
+}
+
+bool AudioOutputMixer::WaitForMixed(Source* source, const TickType_t deadline) {
+  const auto remaining = static_cast<int32_t>(deadline - xTaskGetTickCount());
+  if (remaining <= 0) {
+    return false;
+  }
+
+  // The last of it may still be in the chunk being written, Mix() signals once that is done.
+  std::unique_lock lock(mutex_);
+  return mixed_condition_.wait_for(lock, std::chrono::milliseconds(remaining * portTICK_PERIOD_MS), [this, source]() {
+    return xStreamBufferIsEmpty(source->ring_) && !busy_;
+  });
+}
+
+}  // namespace ai_vox
@@ -0,0 +1,119 @@
+#pragma once
+
+#ifndef _AUDIO_OUTPUT_MIXER_H_
+#define _AUDIO_OUTPUT_MIXER_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "audio_output_device.h"
+
+class ActiveTaskQueue;
+
+namespace ai_vox {
+
+/**
+ * Mixes several PCM sources into one output device, e.g. the engine's TTS, an earcon and a streamed prompt. Each source
+ * is itself an AudioOutputDevice, so it can be handed to Engine::Start() or written to directly.
+ *
+ * The device is open while at least one source is open. Sources play at output_sample_rate() of the mixer, with their
+ * own gain. While a source has audio, every source of lower priority is scaled by its duck gain. Gain changes ramp over
+ * one mix chunk so ducking does not click.
+ *
+ * A chunk is only as long as the shortest of the sources with audio, the rest stays queued for the next chunk, so a
+ * source that is momentarily short gets no gap padded into its audio.
+ *
+ * Must be created with std::make_shared.
+ */
+class AudioOutputMixer : public std::enable_shared_from_this<AudioOutputMixer> {
+ public:
+  class Source : public AudioOutputDevice {
+   public:
+    struct Config {
+      uint16_t gain = kMaxVolume;       // percent
+      int32_t priority = 0;             // higher ducks lower
+      uint16_t duck_gain = kMaxVolume;  // percent, applied to lower priority sources while this one plays
+      uint32_t buffer_duration = 30;    // ms queued in front of the mixer, Write() blocks once it is full
+    };
+
+    Source(std::shared_ptr<AudioOutputMixer> mixer, const Config& config);
+    ~Source();
+
+    // Opens the mixer's device if this is the first open source. The written PCM has to be at output_sample_rate(),
+    // |sample_rate| is ignored.
+    bool OpenOutput(uint32_t sample_rate) override;
+    // Drops what has not been mixed yet.
+    void CloseOutput() override;
+    size_t Write(const int16_t* pcm, size_t samples) override;
+    // The gain of this source.
+    void set_volume(uint16_t volume) override;
+    uint16_t volume() const override;
+    uint32_t output_sample_rate() override;
+    bool WaitForDrained(const uint32_t timeout_ms) override;
+
+   private:
+    friend class AudioOutputMixer;
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+
+    std::shared_ptr<AudioOutputMixer> mixer_;
+    const int32_t priority_ = 0;
+    const int32_t duck_gain_ = 0;  // Q15
+    const uint32_t buffer_duration_ = 0;
+    std::atomic<uint16_t> volume_ = kMaxVolume;
+    std::atomic<int32_t> gain_ = 0;  // Q15
+    StreamBufferHandle_t ring_ = nullptr;
+    size_t ring_bytes_ = 0;
+    bool open_ = false;
+    bool active_ = false;        // mixer task only
+    int32_t current_gain_ = -1;  // Q15, mixer task only, negative while the source is idle
+  };
+
+  AudioOutputMixer(std::shared_ptr<AudioOutputDevice> audio_output_device, const uint32_t sample_rate);
+  ~AudioOutputMixer();
+
+  std::shared_ptr<Source> CreateSource(const Source::Config& config);
+
+  // The rate the device opened at, valid while a source is open.
+  uint32_t output_sample_rate() const {
+    return output_sample_rate_;
+  }
+
+ private:
+  AudioOutputMixer(const AudioOutputMixer&) = delete;
+  AudioOutputMixer& operator=(const AudioOutputMixer&) = delete;
+
+  void Attach(Source* source);
+  void Detach(Source* source);
+  void Open();
+  void Close();
+  void Mix(const uint32_t run);
+  // Blocks until everything written to |source| has been handed to the device.
+  bool WaitForMixed(Source* source, const TickType_t deadline);
+
+  std::shared_ptr<AudioOutputDevice> audio_output_device_;
+  const uint32_t sample_rate_ = 0;
+  std::atomic<uint32_t> output_sample_rate_ = 0;
+  std::mutex attach_mutex_;  // serializes opening and closing the device
+  std::mutex mutex_;
+  std::vector<Source*> sources_;
+  std::atomic<uint32_t> run_ = 0;
+  bool busy_ = false;  // guarded by |mutex_|, a chunk is being mixed or written
+  std::condition_variable mixed_condition_;  // signaled with |mutex_| whenever a chunk has been written
+  SemaphoreHandle_t data_sem_ = nullptr;
+  std::vector<int32_t> mix_;
+  std::vector<int16_t> pcm_;
+  ActiveTaskQueue* mix_task_queue_ = nullptr;
+};
+
+}  // namespace ai_vox
+
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef _I2S_INPUT_STREAM_H_
+#define _I2S_INPUT_STREAM_H_
+
+#include <driver/i2s_common.h>
+#include <esp_idf_version.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/stream_buffer.h>
+
+#include <vector>
+
+namespace ai_vox {
+
+/**
+ * Pushes every received I2S DMA frame into a stream buffer from the receive interrupt, converted to 16-bit PCM by the
+ * owning device. Shared by the I2S based input devices to implement AudioInputDevice::StartStream().
+ */
+class I2sInputStream {
+ public:
+  // Converts |bytes| of raw DMA data to at most |max_samples| of |pcm| in interrupt context, returns the samples written.
+  using Converter = size_t (*)(const void* dma_buffer, size_t bytes, int16_t* pcm, size_t max_samples);
+
+  I2sInputStream(const Converter converter, const size_t max_frame_samples) : converter_(converter), pcm_(max_frame_samples) {
+  }
+
+  // The channel is briefly disabled, event callbacks can only be registered on a stopped channel.
+  bool Start(i2s_chan_handle_t handle, StreamBufferHandle_t stream) {
+    if (handle == nullptr || stream == nullptr) {
+      return false;
+    }
+
+    i2s_channel_disable(handle);
+    stream_ = stream;
+    i2s_event_callbacks_t callbacks = {};
+    callbacks.on_recv = &OnReceive;
+    const auto ret = i2s_channel_register_event_callback(handle, &callbacks, this);
+    i2s_channel_enable(handle);
+    if (ret != ESP_OK) {
+      stream_ = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  void Stop(i2s_chan_handle_t handle) {
+    if (handle == nullptr || stream_ == nullptr) {
+      return;
+    }
+
+    i2s_channel_disable(handle);
+    i2s_event_callbacks_t callbacks = {};
+    i2s_channel_register_event_callback(handle, &callbacks, nullptr);
+    stream_ = nullptr;
+    i2s_channel_enable(handle);
+  }
+
+  // For devices that delete the channel on close, which drops the callback along with it.
+  void Reset() {
+    stream_ = nullptr;
+  }
+
+ private:
+  I2sInputStream(const I2sInputStream&) = delete;
+  I2sInputStream& operator=(const I2sInputStream&) = delete;
+
+  static bool IRAM_ATTR OnReceive(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto self = static_cast<I2sInputStream*>(user_ctx);
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0)
+    const void* dma_buffer = event->dma_buf;
+#else
+    const void* dma_buffer = *static_cast<void* const*>(event->data);
+#endif
+    const auto samples = self->converter_(dma_buffer, event->size, self->pcm_.data(), self->pcm_.size());
+    BaseType_t task_woken = pdFALSE;
+    xStreamBufferSendFromISR(self->stream_, self->pcm_.data(), samples * sizeof(int16_t), &task_woken);
+    return task_woken == pdTRUE;
+  }
+
+  const Converter converter_;
+  std::vector<int16_t> pcm_;
+  StreamBufferHandle_t stream_ = nullptr;
+};
+
+}  // namespace ai_vox
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#ifndef _I2S_OUTPUT_DRAIN_H_
+#define _I2S_OUTPUT_DRAIN_H_
+
+#include <driver/i2s_common.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace ai_vox {
+
+/**
+ * Tells when audio written to an I2S TX channel has actually been clocked out. Counts the DMA buffers sent with the
+ * on_sent event: once a write has returned its samples sit in at most |dma_desc_num| buffers, which have all been sent
+ * after that many more events plus the one in flight. Shared by the I2S based output devices to implement
+ * AudioOutputDevice::WaitForDrained().
+ */
+class I2sOutputDrain {
+ public:
+  I2sOutputDrain() : sent_sem_(xSemaphoreCreateBinaryStatic(&sent_sem_buffer_)) {
+  }
+
+  // Must be called while the channel is not enabled.
+  bool Register(i2s_chan_handle_t handle, const uint32_t dma_desc_num) {
+    dma_desc_num_ = dma_desc_num;
+    i2s_event_callbacks_t callbacks = {};
+    callbacks.on_sent = &OnSent;
+    return i2s_channel_register_event_callback(handle, &callbacks, this) == ESP_OK;
+  }
+
+  // After every write returned, from the writing task. WaitForDrained() may run on another task.
+  void MarkWritten() {
+    last_write_sent_count_.store(sent_count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    written_.store(true, std::memory_order_release);
+  }
+
+  bool WaitForDrained(const uint32_t timeout_ms) {
+    if (dma_desc_num_ == 0) {
+      return false;
+    }
+
+    if (!written_.load(std::memory_order_acquire)) {
+      return true;
+    }
+
+    const auto target = last_write_sent_count_.load(std::memory_order_relaxed) + dma_desc_num_ + 1;
+    const auto deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    while (static_cast<int32_t>(sent_count_.load(std::memory_order_relaxed) - target) < 0) {
+      const auto now = xTaskGetTickCount();
+      if (static_cast<int32_t>(deadline - now) <= 0) {
+        return false;
+      }
+      xSemaphoreTake(sent_sem_, deadline - now);
+    }
+    return true;
+  }
+
+ private:
+  I2sOutputDrain(const I2sOutputDrain&) = delete;
+  I2sOutputDrain& operator=(const I2sOutputDrain&) = delete;
+
+  static bool IRAM_ATTR OnSent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto self = static_cast<I2sOutputDrain*>(user_ctx);
+    self->sent_count_.fetch_add(1, std::memory_order_relaxed);
+    BaseType_t task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(self->sent_sem_, &task_woken);
+    return task_woken == pdTRUE;
+  }
+
+  StaticSemaphore_t sent_sem_buffer_;
+  SemaphoreHandle_t sent_sem_ = nullptr;
+  uint32_t dma_desc_num_ = 0;
+  std::atomic<uint32_t> sent_count_ = 0;
+  std::atomic<uint32_t> last_write_sent_count_ = 0;
+  std::atomic<bool> written_ = false;
+};
+
+}  // namespace ai_vox
+
+#endif
@@ -0,0 +1,252 @@
+#include "prompt_player.h"
+
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "components/espressif/esp_audio_codec/esp_audio_simple_dec.h"
+#include "components/espressif/esp_audio_codec/esp_mp3_dec.h"
+#include "components/task_queue/active_task_queue.h"
+#include "core/resampler.h"
+
+#ifndef CLOGGER_SEVERITY
+#define CLOGGER_SEVERITY CLOGGER_SEVERITY_WARN
+#endif
+#include "core/clogger/clogger.h"
+
+namespace ai_vox {
+namespace {
+constexpr size_t kFrameBufferSize = 1152 * 2 * sizeof(int16_t);  // the largest MP3 frame, stereo
+constexpr uint32_t kWriteChunkDuration = 20;                     // ms
+constexpr uint32_t kDrainTimeout = 200;                          // ms
+
+bool RegisterDecoder() {
+  static std::once_flag once;
+  static esp_audio_err_t ret = ESP_AUDIO_ERR_OK;
+  std::call_once(once, []() { ret = esp_mp3_dec_register(); });
+  return ret == ESP_AUDIO_ERR_OK || ret == ESP_AUDIO_ERR_ALREADY_EXIST;  // the stream player may have registered it
+}
+
+int16_t* ReallocPcm(int16_t* pcm, const size_t samples) {
+  auto ret = static_cast<int16_t*>(heap_caps_realloc(pcm, samples * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+  if (ret == nullptr) {
+    ret = static_cast<int16_t*>(heap_caps_realloc(pcm, samples * sizeof(int16_t), MALLOC_CAP_8BIT | MALLOC_CAP_DEFAULT));
+  }
+  return ret;
+}
+}  // namespace
+
+PromptPlayer::PromptPlayer(std::shared_ptr<AudioOutputDevice> audio_output_device)
+    : audio_output_device_(std::move(audio_output_device)), frame_buffer_(kFrameBufferSize) {
+  task_queue_ = new ActiveTaskQueue("PromptPlayer", 8 << 10, tskIDLE_PRIORITY + 1);
+}
+
+PromptPlayer::~PromptPlayer() {
+  Stop();
+  delete task_queue_;
+  for (auto& prompt : cache_) {
+    heap_caps_free(prompt.pcm);
+  }
+}
+
+bool PromptPlayer::Preload(const uint8_t* data, const size_t size) {
+  if (FindCached(data) != nullptr) {
+    return true;
+  }
+
+  CachedPrompt prompt;
+  prompt.data = data;
+  size_t capacity = 0;
+  const auto ok = Decode(data, size, [&prompt, &capacity](const int16_t* pcm, const size_t samples, const uint32_t sample_rate) {
+    prompt.sample_rate = sample_rate;
+    if (prompt.samples + samples > capacity) {
+      const auto new_capacity = std::max(capacity * 2, prompt.samples + samples);
+      auto new_pcm = ReallocPcm(prompt.pcm, new_capacity);
+      if (new_pcm == nullptr) {
+        CLOGE("out of memory");
+        return false;
+      }
+      prompt.pcm = new_pcm;
+      capacity = new_capacity;
+    }
+    std::memcpy(prompt.pcm + prompt.samples, pcm, samples * sizeof(int16_t));
+    prompt.samples += samples;
+    return true;
+  });
+
+  if (!ok || prompt.samples == 0) {
+    heap_caps_free(prompt.pcm);
+    return false;
+  }
+
+  if (capacity > prompt.samples) {
+    if (auto pcm = ReallocPcm(prompt.pcm, prompt.samples); pcm != nullptr) {
+      prompt.pcm = pcm;
+    }
+  }
+
+  CLOGI("cached %zu samples at %" PRIu32 " Hz", prompt.samples, prompt.sample_rate);
+  std::lock_guard lock(cache_mutex_);
+  cache_.push_back(prompt);
+  return true;
+}
+
+void PromptPlayer::Play(const uint8_t* data, const size_t size) {
+  const auto run = run_.load();
+  task_queue_->Enqueue([this, data, size, run]() { PlayPrompt(data, size, run); });
+}
+
+void PromptPlayer::Stop() {
+  ++run_;
+}
+
+void PromptPlayer::Wait() {
+  task_queue_->Sync();
+}
+
+const PromptPlayer::CachedPrompt* PromptPlayer::FindCached(const uint8_t* data) {
+  std::lock_guard lock(cache_mutex_);
+  const auto it = std::find_if(cache_.begin(), cache_.end(), [data](const CachedPrompt& prompt) { return prompt.data == data; });
+  return it != cache_.end() ? &(*it) : nullptr;
+}
+
+void PromptPlayer::PlayPrompt(const uint8_t* data, const size_t size, const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
+
+  bool opened = false;
+  if (const auto prompt = FindCached(data); prompt != nullptr) {
+    audio_output_device_->OpenOutput(prompt->sample_rate);
+    PrepareResampler(prompt->sample_rate);
+    opened = true;
+    WritePcm(prompt->pcm, prompt->samples, prompt->sample_rate, run);
+  } else {
+    Decode(data, size, [this, run, &opened](const int16_t* pcm, const size_t samples, const uint32_t sample_rate) {
+      if (!opened) {
+        audio_output_device_->OpenOutput(sample_rate);
+        PrepareResampler(sample_rate);
+        opened = true;
+      }
+      return WritePcm(pcm, samples, sample_rate, run);
+    });
+  }
+
+  if (!opened) {
+    return;
+  }
+
+  if (run == run_) {
+    audio_output_device_->WaitForDrained(kDrainTimeout);
+  }
+  audio_output_device_->CloseOutput();
+}
+
+void PromptPlayer::PrepareResampler(const uint32_t sample_rate) {
+  const auto output_sample_rate = audio_output_device_->output_sample_rate();
+  if (output_sample_rate == sample_rate) {
+    resampler_.reset();
+  } else if (!resampler_ || resampler_->input_sample_rate() != sample_rate || resampler_->output_sample_rate() != output_sample_rate) {
+    resampler_ = Resampler::Create(sample_rate, output_sample_rate);
+  } else {
+    resampler_->Reset();
+  }
+}
+
+bool PromptPlayer::WritePcm(const int16_t* pcm, const size_t samples, const uint32_t sample_rate, const uint32_t run) {
+  const size_t chunk = sample_rate / 1000 * kWriteChunkDuration;
+  for (size_t offset = 0; offset < samples; offset += chunk) {
+    if (run != run_) {
+      return false;
+    }
+
+    const auto count = std::min(chunk, samples - offset);
+    if (!resampler_) {
+      audio_output_device_->Write(pcm + offset, count);
+      continue;
+    }
+
+    resampled_.resize(resampler_->output_size(count));
+    const auto resampled = resampler_->Resample(pcm + offset, count, resampled_.data(), resampled_.size());
+    audio_output_device_->Write(resampled_.data(), resampled);
+  }
+  return run == run_;
+}
+
+template <typename Sink>
+bool PromptPlayer::Decode(const uint8_t* data, const size_t size, Sink&& sink) {
+  if (!RegisterDecoder()) {
+    CLOGE("failed to register the mp3 decoder");
+    return false;
+  }
+
+  std::lock_guard lock(decode_mutex_);
+  esp_audio_simple_dec_handle_t decoder = nullptr;
+  esp_audio_simple_dec_cfg_t config{
+      .dec_type = ESP_AUDIO_SIMPLE_DEC_TYPE_MP3,
+      .dec_cfg = nullptr,
+      .cfg_size = 0,
+  };
+  if (esp_audio_simple_dec_open(&config, &decoder) != ESP_AUDIO_ERR_OK) {
+    CLOGE("failed to open the mp3 decoder");
+    return false;
+  }
+
+  esp_audio_simple_dec_raw_t raw = {
+      .buffer = const_cast<uint8_t*>(data),
+      .len = static_cast<uint32_t>(size),
+      .eos = true,
+      .consumed = 0,
+      .frame_recover = ESP_AUDIO_SIMPLE_DEC_RECOVERY_NONE,
+  };
+  esp_audio_simple_dec_out_t out_frame = {
+      .buffer = frame_buffer_.data(),
+      .len = static_cast<uint32_t>(frame_buffer_.size()),
+      .needed_size = 0,
+      .decoded_size = 0,
+  };
+  esp_audio_simple_dec_info_t info = {};
+
+  bool ok = true;
+  while (raw.len > 0) {
+    const auto ret = esp_audio_simple_dec_process(decoder, &raw, &out_frame);
+    if (ret != ESP_AUDIO_ERR_OK) {
+      CLOGE("decode failed: %d", ret);
+      ok = false;
+      break;
+    }
+    raw.len -= raw.consumed;
+    raw.buffer += raw.consumed;
+
+    if (out_frame.decoded_size == 0) {
+      continue;
+    }
+
+    if (info.sample_rate == 0 && (esp_audio_simple_dec_get_info(decoder, &info) != ESP_AUDIO_ERR_OK || info.bits_per_sample != 16)) {
+      CLOGE("unsupported stream");
+      ok = false;
+      break;
+    }
+
+    // Prompts are played mono, downmix in place.
+    auto pcm = reinterpret_cast<int16_t*>(out_frame.buffer);
+    size_t samples = out_frame.decoded_size / sizeof(int16_t);
+    if (info.channel == 2) {
+      samples /= 2;
+      for (size_t i = 0; i < samples; i++) {
+        pcm[i] = static_cast<int16_t>((pcm[2 * i] + pcm[2 * i + 1]) / 2);
+      }
+    }
+
+    if (!sink(pcm, samples, info.sample_rate)) {
+      ok = false;
+      break;
+    }
+  }
+
+  esp_audio_simple_dec_close(decoder);
+  return ok;
+}
+
+}  // namespace ai_vox
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifndef _PROMPT_PLAYER_H_
+#define _PROMPT_PLAYER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <vector>
+
+#include "audio_output_device.h"
+
+class ActiveTaskQueue;
+class Resampler;
+
+namespace ai_vox {
+
+/**
+ * Plays MP3 prompts on its own task, so the caller is not blocked while they decode and play. Prompts are decoded
+ * frame by frame into a fixed buffer and written straight to the output. Best used with an AudioOutputMixer source,
+ * then prompts can overlap with the engine's TTS.
+ *
+ * A prompt can be decoded once with Preload(). Its mono PCM is kept in PSRAM when available, and later plays of it
+ * start without running the decoder.
+ */
+class PromptPlayer {
+ public:
+  explicit PromptPlayer(std::shared_ptr<AudioOutputDevice> audio_output_device);
+  ~PromptPlayer();
+
+  // Blocks while decoding. |data| is the cache key and has to stay valid, typically a const array in flash.
+  bool Preload(const uint8_t* data, const size_t size);
+
+  // Returns right away, prompts play one after another.
+  void Play(const uint8_t* data, const size_t size);
+
+  // Cuts the prompt being played and drops the queued ones.
+  void Stop();
+
+  // Blocks until every prompt queued so far has played.
+  void Wait();
+
+ private:
+  PromptPlayer(const PromptPlayer&) = delete;
+  PromptPlayer& operator=(const PromptPlayer&) = delete;
+
+  struct CachedPrompt {
+    const uint8_t* data = nullptr;
+    int16_t* pcm = nullptr;
+    size_t samples = 0;
+    uint32_t sample_rate = 0;
+  };
+
+  void PlayPrompt(const uint8_t* data, const size_t size, const uint32_t run);
+  // Sets up the resampler for a prompt at |sample_rate|, once per prompt so its state carries across the frames.
+  void PrepareResampler(const uint32_t sample_rate);
+  // Writes mono PCM at |sample_rate| to the output, resampling if needed. Returns false once stopped.
+  bool WritePcm(const int16_t* pcm, const size_t samples, const uint32_t sample_rate, const uint32_t run);
+  // Calls |sink| with the mono PCM of every decoded frame until it returns false.
+  template <typename Sink>
+  bool Decode(const uint8_t* data, const size_t size, Sink&& sink);
+  const CachedPrompt* FindCached(const uint8_t* data);
+
+  std::shared_ptr<AudioOutputDevice> audio_output_device_;
+  ActiveTaskQueue* task_queue_ = nullptr;
+  std::atomic<uint32_t> run_ = 0;
+  std::vector<uint8_t> frame_buffer_;  // decoder output, one MP3 frame
+  std::unique_ptr<Resampler> resampler_;
+  std::vector<int16_t> resampled_;
+  std::mutex cache_mutex_;
+  std::list<CachedPrompt> cache_;  // a list, so a prompt being played stays put while another one is added
+  std::mutex decode_mutex_;  // Preload() and the player task share the decoder output buffer
+};
+
+}  // namespace ai_vox
+
+#endif
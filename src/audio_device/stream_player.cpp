@@ -0,0 +1,454 @@
+#include "stream_player.h"
+
+#include <esp_crt_bundle.h>
+#include <esp_http_client.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include "components/espressif/esp_audio_codec/esp_aac_dec.h"
+#include "components/espressif/esp_audio_codec/esp_audio_simple_dec.h"
+#include "components/espressif/esp_audio_codec/esp_flac_dec.h"
+#include "components/espressif/esp_audio_codec/esp_m4a_dec.h"
+#include "components/espressif/esp_audio_codec/esp_mp3_dec.h"
+#include "components/espressif/esp_audio_codec/esp_pcm_dec.h"
+#include "components/espressif/esp_audio_codec/esp_ts_dec.h"
+#include "components/espressif/esp_audio_codec/esp_wav_dec.h"
+#include "components/task_queue/active_task_queue.h"
+#include "core/resampler.h"
+
+#ifndef CLOGGER_SEVERITY
+#define CLOGGER_SEVERITY CLOGGER_SEVERITY_WARN
+#endif
+#include "core/clogger/clogger.h"
+
+namespace ai_vox {
+namespace {
+constexpr size_t kFetchChunkSize = 2 << 10;
+constexpr size_t kInputBufferSize = 4 << 10;
+constexpr size_t kFrameBufferSize = 1152 * 2 * sizeof(int16_t);  // an MP3 frame, grown on demand for other formats
+constexpr size_t kMaxFrameBufferSize = 32 << 10;
+constexpr uint32_t kRingWaitTime = 20;     // ms
+constexpr uint32_t kReconnectDelay = 500;  // ms
+constexpr uint32_t kMaxReconnects = 5;     // in a row without getting any data
+constexpr uint32_t kDrainTimeout = 500;    // ms
+
+bool RegisterDecoders() {
+  static std::once_flag once;
+  static bool ok = true;
+  std::call_once(once, []() {
+    for (const auto reg : {esp_mp3_dec_register,
+                           esp_aac_dec_register,
+                           esp_flac_dec_register,
+                           esp_pcm_dec_register,
+                           esp_m4a_dec_register,
+                           esp_ts_dec_register,
+                           esp_wav_dec_register}) {
+      const auto ret = reg();
+      if (ret != ESP_AUDIO_ERR_OK && ret != ESP_AUDIO_ERR_ALREADY_EXIST) {
+        CLOGE("failed to register a decoder: %d", ret);
+        ok = false;
+      }
+    }
+  });
+  return ok;
+}
+
+esp_audio_simple_dec_type_t DecoderType(const std::string& url) {
+  const auto path = url.substr(0, url.find_first_of("?#"));
+  const auto dot = path.rfind('.');
+  if (dot == std::string::npos) {
+    return ESP_AUDIO_SIMPLE_DEC_TYPE_NONE;
+  }
+
+  std::string extension = path.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) { return std::tolower(c); });
+  if (extension == "mp3") {
+    return ESP_AUDIO_SIMPLE_DEC_TYPE_MP3;
+  } else if (extension == "aac") {
+    return ESP_AUDIO_SIMPLE_DEC_TYPE_AAC;
+  } else if (extension == "m4a" || extension == "mp4") {
+    return ESP_AUDIO_SIMPLE_DEC_TYPE_M4A;
+  } else if (extension == "ts") {
+    return ESP_AUDIO_SIMPLE_DEC_TYPE_TS;
+  } else if (extension == "flac") {
+    return ESP_AUDIO_SIMPLE_DEC_TYPE_FLAC;
+  } else if (extension == "wav") {
+    return ESP_AUDIO_SIMPLE_DEC_TYPE_WAV;
+  }
+  return ESP_AUDIO_SIMPLE_DEC_TYPE_NONE;
+}
+}  // namespace
+
+StreamPlayer::StreamPlayer(std::shared_ptr<AudioOutputDevice> audio_output_device) : StreamPlayer(std::move(audio_output_device), Config()) {
+}
+
+StreamPlayer::StreamPlayer(std::shared_ptr<AudioOutputDevice> audio_output_device, const Config& config)
+    : audio_output_device_(std::move(audio_output_device)),
+      config_(config),
+      ring_storage_(config.ring_size + 1, MemoryPlacement::kSpiram),  // a stream buffer keeps one byte free
+      fetch_buffer_(kFetchChunkSize),
+      input_buffer_(kInputBufferSize),
+      frame_buffer_(kFrameBufferSize) {
+  assert(ring_storage_.data() != nullptr);
+  ring_ = xStreamBufferCreateStatic(config_.ring_size, 1, ring_storage_.data(), &ring_buffer_);
+  assert(ring_ != nullptr);
+
+  // TLS needs the larger stack.
+  fetch_task_queue_ = new ActiveTaskQueue("StreamFetch", 8 << 10, tskIDLE_PRIORITY + 1);
+  decode_task_queue_ = new ActiveTaskQueue("StreamDecode", 8 << 10, tskIDLE_PRIORITY + 1);
+}
+
+StreamPlayer::~StreamPlayer() {
+  Stop();
+  delete fetch_task_queue_;
+  delete decode_task_queue_;
+  vStreamBufferDelete(ring_);
+}
+
+bool StreamPlayer::Play(const std::string& url) {
+  const auto decoder_type = DecoderType(url);
+  if (decoder_type == ESP_AUDIO_SIMPLE_DEC_TYPE_NONE) {
+    CLOGE("unsupported format: %s", url.c_str());
+    return false;
+  }
+
+  Stop();
+  fetch_task_queue_->Sync();
+  decode_task_queue_->Sync();
+  url_ = url;
+  decoder_type_ = decoder_type;
+  bitrate_ = 0;
+  prefetch_ = config_.min_prefetch;
+  stall_count_ = 0;
+  reconnect_count_ = 0;
+  Start(0, 0);
+  return true;
+}
+
+void StreamPlayer::Stop() {
+  ++run_;
+}
+
+bool StreamPlayer::Seek(const uint32_t position) {
+  const auto bitrate = bitrate_.load();
+  if (url_.empty() || bitrate == 0 ||
+      (decoder_type_ != ESP_AUDIO_SIMPLE_DEC_TYPE_MP3 && decoder_type_ != ESP_AUDIO_SIMPLE_DEC_TYPE_AAC && decoder_type_ != ESP_AUDIO_SIMPLE_DEC_TYPE_TS)) {
+    return false;
+  }
+
+  Stop();
+  fetch_task_queue_->Sync();
+  decode_task_queue_->Sync();
+  Start(position, static_cast<uint64_t>(position) * bitrate / 8);
+  return true;
+}
+
+uint32_t StreamPlayer::position() const {
+  const auto sample_rate = played_sample_rate_.load();
+  return start_position_ + (sample_rate == 0 ? 0 : played_samples_ / sample_rate);
+}
+
+void StreamPlayer::Start(const uint32_t position, const size_t offset) {
+  CLOGI("%s at %" PRIu32 " s, offset %zu", url_.c_str(), position, offset);
+  xStreamBufferReset(ring_);
+  fetch_done_ = false;
+  start_position_ = position;
+  played_samples_ = 0;
+  played_sample_rate_ = 0;
+  resampler_.reset();
+  state_ = State::kBuffering;
+
+  const auto run = run_.load();
+  fetch_task_queue_->Enqueue([this, url = url_, offset, run]() { Fetch(url, offset, run); });
+  decode_task_queue_->Enqueue([this, decoder_type = decoder_type_, run]() { Decode(decoder_type, run); });
+}
+
+void StreamPlayer::Fetch(const std::string url, size_t offset, const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
+
+  constexpr char kFileScheme[] = "file://";
+  if (url.rfind(kFileScheme, 0) == 0) {
+    FetchFile(url.substr(sizeof(kFileScheme) - 1), &offset, run);
+  } else {
+    uint32_t failures = 0;
+    while (run == run_) {
+      const auto last_offset = offset;
+      if (FetchHttp(url, &offset, run)) {
+        break;
+      }
+
+      failures = offset == last_offset ? failures + 1 : 0;
+      if (run != run_ || failures >= kMaxReconnects) {
+        break;
+      }
+      ++reconnect_count_;
+      CLOGW("reconnecting at %zu", offset);
+      vTaskDelay(pdMS_TO_TICKS(kReconnectDelay));
+    }
+  }
+
+  if (run == run_) {
+    fetch_done_ = true;
+  }
+}
+
+bool StreamPlayer::FetchHttp(const std::string& url, size_t* offset, const uint32_t run) {
+  esp_http_client_config_t http_client_config;
+  memset(&http_client_config, 0, sizeof(http_client_config));
+  http_client_config.url = url.c_str();
+  http_client_config.crt_bundle_attach = esp_crt_bundle_attach;
+  http_client_config.timeout_ms = config_.network_timeout;
+
+  auto client = esp_http_client_init(&http_client_config);
+  if (client == nullptr) {
+    CLOGE("esp_http_client_init failed.");
+    return false;
+  }
+
+  if (*offset > 0) {
+    char range[32];
+    snprintf(range, sizeof(range), "bytes=%zu-", *offset);
+    esp_http_client_set_header(client, "Range", range);
+  }
+
+  auto err = esp_http_client_open(client, 0);
+  if (err != ESP_OK) {
+    CLOGE("esp_http_client_open failed. Error: %s", esp_err_to_name(err));
+    esp_http_client_cleanup(client);
+    return false;
+  }
+
+  bool complete = false;
+  const auto content_length = esp_http_client_fetch_headers(client);
+  const auto status_code = esp_http_client_get_status_code(client);
+  if (content_length < 0 || (status_code != 200 && status_code != 206)) {
+    CLOGE("fetching headers failed, status: %d", status_code);
+  } else {
+    // A server ignoring the range sends everything again.
+    size_t skip = status_code == 200 ? *offset : 0;
+    while (run == run_) {
+      const auto len = esp_http_client_read(client, reinterpret_cast<char*>(fetch_buffer_.data()), fetch_buffer_.size());
+      if (len <= 0) {
+        complete = len == 0 && esp_http_client_is_complete_data_received(client);
+        break;
+      }
+
+      const auto skipped = std::min<size_t>(skip, len);
+      skip -= skipped;
+      if (!SendToRing(fetch_buffer_.data() + skipped, len - skipped, run)) {
+        break;
+      }
+      *offset += len - skipped;
+    }
+  }
+
+  esp_http_client_close(client);
+  esp_http_client_cleanup(client);
+  return complete;
+}
+
+bool StreamPlayer::FetchFile(const std::string& path, size_t* offset, const uint32_t run) {
+  auto file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    CLOGE("failed to open %s", path.c_str());
+    return false;
+  }
+
+  bool complete = false;
+  if (fseek(file, *offset, SEEK_SET) == 0) {
+    while (run == run_) {
+      const auto len = fread(fetch_buffer_.data(), 1, fetch_buffer_.size(), file);
+      if (len == 0) {
+        complete = feof(file) != 0;
+        break;
+      }
+
+      if (!SendToRing(fetch_buffer_.data(), len, run)) {
+        break;
+      }
+      *offset += len;
+    }
+  }
+
+  fclose(file);
+  return complete;
+}
+
+bool StreamPlayer::SendToRing(const uint8_t* data, const size_t size, const uint32_t run) {
+  size_t sent = 0;
+  while (sent < size) {
+    if (run != run_) {
+      return false;
+    }
+    sent += xStreamBufferSend(ring_, data + sent, size - sent, pdMS_TO_TICKS(kRingWaitTime));
+  }
+  return true;
+}
+
+bool StreamPlayer::WaitForPrefetch(const uint32_t run) {
+  while (run == run_) {
+    if (fetch_done_ || xStreamBufferBytesAvailable(ring_) >= prefetch_) {
+      return true;
+    }
+    vTaskDelay(pdMS_TO_TICKS(kRingWaitTime));
+  }
+  return false;
+}
+
+void StreamPlayer::Decode(const uint32_t decoder_type, const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
+
+  esp_audio_simple_dec_handle_t decoder = nullptr;
+  esp_audio_simple_dec_cfg_t config{
+      .dec_type = static_cast<esp_audio_simple_dec_type_t>(decoder_type),
+      .dec_cfg = nullptr,
+      .cfg_size = 0,
+  };
+  if (!RegisterDecoders() || esp_audio_simple_dec_open(&config, &decoder) != ESP_AUDIO_ERR_OK) {
+    CLOGE("failed to open the decoder");
+    state_ = State::kIdle;
+    return;
+  }
+
+  esp_audio_simple_dec_out_t out_frame = {
+      .buffer = frame_buffer_.data(),
+      .len = static_cast<uint32_t>(frame_buffer_.size()),
+      .needed_size = 0,
+      .decoded_size = 0,
+  };
+  esp_audio_simple_dec_info_t info = {};
+  bool opened = false;
+  size_t input_size = 0;
+  uint64_t smooth_samples = 0;  // played since the last stall or change of the prefetch depth
+
+  while (run == run_) {
+    if (state_ == State::kBuffering) {
+      if (!WaitForPrefetch(run)) {
+        break;
+      }
+      state_ = State::kPlaying;
+    }
+
+    if (input_size < input_buffer_.size()) {
+      input_size += xStreamBufferReceive(
+          ring_, input_buffer_.data() + input_size, input_buffer_.size() - input_size, input_size == 0 ? pdMS_TO_TICKS(kRingWaitTime) : 0);
+    }
+
+    const bool eos = fetch_done_ && xStreamBufferIsEmpty(ring_);
+    if (input_size == 0) {
+      if (eos) {
+        break;
+      }
+      prefetch_ = std::min<uint32_t>(prefetch_ * 2, config_.ring_size * 3 / 4);
+      smooth_samples = 0;
+      ++stall_count_;
+      CLOGW("stalled, prefetch raised to %" PRIu32 " bytes", prefetch_.load());
+      state_ = State::kBuffering;
+      continue;
+    }
+
+    esp_audio_simple_dec_raw_t raw = {
+        .buffer = input_buffer_.data(),
+        .len = static_cast<uint32_t>(input_size),
+        .eos = eos,
+        .consumed = 0,
+        .frame_recover = ESP_AUDIO_SIMPLE_DEC_RECOVERY_NONE,
+    };
+    const auto ret = esp_audio_simple_dec_process(decoder, &raw, &out_frame);
+    if (ret == ESP_AUDIO_ERR_BUFF_NOT_ENOUGH && out_frame.needed_size <= kMaxFrameBufferSize) {
+      frame_buffer_.resize(out_frame.needed_size);
+      out_frame.buffer = frame_buffer_.data();
+      out_frame.len = frame_buffer_.size();
+      continue;
+    } else if (ret != ESP_AUDIO_ERR_OK) {
+      CLOGE("decode failed: %d", ret);
+      break;
+    }
+
+    input_size -= raw.consumed;
+    std::memmove(input_buffer_.data(), input_buffer_.data() + raw.consumed, input_size);
+    if (out_frame.decoded_size == 0) {
+      if (raw.consumed == 0 && (input_size == input_buffer_.size() || eos)) {
+        CLOGE("decoder stuck");
+        break;
+      }
+      continue;
+    }
+
+    if (info.sample_rate == 0) {
+      if (esp_audio_simple_dec_get_info(decoder, &info) != ESP_AUDIO_ERR_OK || info.bits_per_sample != 16 || info.channel == 0) {
+        CLOGE("unsupported stream");
+        break;
+      }
+      CLOGI("%" PRIu32 " Hz, %u channels, %" PRIu32 " bit/s", info.sample_rate, info.channel, info.bitrate);
+      bitrate_ = info.bitrate;
+      played_sample_rate_ = info.sample_rate;
+      audio_output_device_->OpenOutput(info.sample_rate);
+      opened = true;
+    }
+
+    // Played mono, downmix in place.
+    auto pcm = reinterpret_cast<int16_t*>(out_frame.buffer);
+    const size_t samples = out_frame.decoded_size / sizeof(int16_t) / info.channel;
+    if (info.channel > 1) {
+      for (size_t i = 0; i < samples; i++) {
+        int32_t sum = 0;
+        for (uint8_t c = 0; c < info.channel; c++) {
+          sum += pcm[i * info.channel + c];
+        }
+        pcm[i] = static_cast<int16_t>(sum / info.channel);
+      }
+    }
+
+    if (!WritePcm(pcm, samples, info.sample_rate, run)) {
+      break;
+    }
+    played_samples_ += samples;
+
+    smooth_samples += samples;
+    if (prefetch_ > config_.min_prefetch && smooth_samples >= static_cast<uint64_t>(info.sample_rate) * config_.prefetch_decay / 1000) {
+      prefetch_ = std::max<uint32_t>(prefetch_ / 2, config_.min_prefetch);
+      smooth_samples = 0;
+      CLOGI("smooth playback, prefetch lowered to %" PRIu32 " bytes", prefetch_.load());
+    }
+  }
+
+  esp_audio_simple_dec_close(decoder);
+  if (opened) {
+    if (run == run_) {
+      audio_output_device_->WaitForDrained(kDrainTimeout);
+    }
+    audio_output_device_->CloseOutput();
+  }
+  state_ = State::kIdle;
+  CLOGI("finished, %" PRIu32 " stalls, %" PRIu32 " reconnects", stall_count_.load(), reconnect_count_.load());
+}
+
+bool StreamPlayer::WritePcm(int16_t* pcm, size_t samples, const uint32_t sample_rate, const uint32_t run) {
+  if (run != run_ || samples == 0) {
+    return run == run_;
+  }
+
+  const auto output_sample_rate = audio_output_device_->output_sample_rate();
+  if (output_sample_rate == sample_rate) {
+    audio_output_device_->Write(pcm, samples);
+    return true;
+  }
+
+  if (!resampler_ || resampler_->input_sample_rate() != sample_rate || resampler_->output_sample_rate() != output_sample_rate) {
+    resampler_ = Resampler::Create(sample_rate, output_sample_rate);
+  }
+  resampled_.resize(resampler_->output_size(samples));
+  const auto resampled = resampler_->Resample(pcm, samples, resampled_.data(), resampled_.size());
+  audio_output_device_->Write(resampled_.data(), resampled);
+  return true;
+}
+
+}  // namespace ai_vox
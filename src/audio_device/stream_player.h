@@ -0,0 +1,124 @@
+#pragma once
+
+#ifndef _STREAM_PLAYER_H_
+#define _STREAM_PLAYER_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/stream_buffer.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "audio_output_device.h"
+#include "core/flex_array/flex_array.h"
+
+class ActiveTaskQueue;
+class Resampler;
+
+namespace ai_vox {
+
+/**
+ * Plays MP3, AAC, M4A, TS, FLAC and WAV streams from an http(s):// URL or a file:// path on a mounted file system. The
+ * format is taken from the extension of the URL.
+ *
+ * One task fetches the stream into a fixed prefetch ring, another decodes it with esp_audio_simple_dec and writes to
+ * the output device, so memory use does not depend on the length of the stream. Playback starts once the ring holds
+ * the prefetch depth. Whenever the ring runs dry the player rebuffers and doubles the depth, up to the ring size, so a
+ * flaky network costs fewer and fewer stalls. Once playback has gone smoothly for a while the depth halves again, down
+ * to the minimum, so a brief bad patch does not leave every later rebuffer waiting for a full ring. A dropped
+ * connection is resumed with an HTTP range request.
+ *
+ * M4A has to be "fast start", with its index in front of the media data. Best used with an AudioOutputMixer source so
+ * it plays under the engine's TTS.
+ */
+class StreamPlayer {
+ public:
+  struct Config {
+    size_t ring_size = 64 << 10;      // bytes, taken from PSRAM when available
+    size_t min_prefetch = 8 << 10;    // bytes buffered before playback starts
+    uint32_t network_timeout = 3000;  // ms
+    uint32_t prefetch_decay = 30000;  // ms played without a stall before a raised prefetch depth is halved
+  };
+
+  enum class State : uint8_t {
+    kIdle,
+    kBuffering,
+    kPlaying,
+  };
+
+  explicit StreamPlayer(std::shared_ptr<AudioOutputDevice> audio_output_device);
+  StreamPlayer(std::shared_ptr<AudioOutputDevice> audio_output_device, const Config& config);
+  ~StreamPlayer();
+
+  // Stops what is playing and starts |url|. Returns false if the format is not supported.
+  bool Play(const std::string& url);
+  void Stop();
+  // Restarts the current stream at |position| seconds. The byte offset is estimated from the bitrate, so this only
+  // works for MP3, AAC and TS once playback has started.
+  bool Seek(const uint32_t position);
+
+  State state() const {
+    return state_;
+  }
+
+  // Seconds into the stream.
+  uint32_t position() const;
+
+  uint32_t prefetch() const {
+    return prefetch_;
+  }
+
+  uint32_t stall_count() const {
+    return stall_count_;
+  }
+
+  uint32_t reconnect_count() const {
+    return reconnect_count_;
+  }
+
+ private:
+  StreamPlayer(const StreamPlayer&) = delete;
+  StreamPlayer& operator=(const StreamPlayer&) = delete;
+
+  void Start(const uint32_t position, const size_t offset);
+  void Fetch(const std::string url, size_t offset, const uint32_t run);
+  bool FetchHttp(const std::string& url, size_t* offset, const uint32_t run);
+  bool FetchFile(const std::string& path, size_t* offset, const uint32_t run);
+  bool SendToRing(const uint8_t* data, const size_t size, const uint32_t run);
+  void Decode(const uint32_t decoder_type, const uint32_t run);
+  // Blocks until the ring holds the prefetch depth or the whole rest of the stream. Returns false once stopped.
+  bool WaitForPrefetch(const uint32_t run);
+  bool WritePcm(int16_t* pcm, size_t samples, const uint32_t sample_rate, const uint32_t run);
+
+  std::shared_ptr<AudioOutputDevice> audio_output_device_;
+  const Config config_;
+  FlexArray<uint8_t> ring_storage_;
+  StaticStreamBuffer_t ring_buffer_;
+  StreamBufferHandle_t ring_ = nullptr;
+  ActiveTaskQueue* fetch_task_queue_ = nullptr;
+  ActiveTaskQueue* decode_task_queue_ = nullptr;
+  std::atomic<uint32_t> run_ = 0;
+  std::atomic<bool> fetch_done_ = false;  // everything up to the end of the stream is in the ring
+  std::atomic<State> state_ = State::kIdle;
+  std::atomic<uint32_t> prefetch_ = 0;
+  std::atomic<uint32_t> stall_count_ = 0;
+  std::atomic<uint32_t> reconnect_count_ = 0;
+  std::string url_;
+  uint32_t decoder_type_ = 0;
+  std::atomic<uint32_t> start_position_ = 0;  // s, where the current run started
+  std::atomic<uint64_t> played_samples_ = 0;  // since start_position_, at played_sample_rate_
+  std::atomic<uint32_t> played_sample_rate_ = 0;
+  std::atomic<uint32_t> bitrate_ = 0;  // bit/s, 0 until decoded
+  std::vector<uint8_t> fetch_buffer_;
+  std::vector<uint8_t> input_buffer_;
+  std::vector<uint8_t> frame_buffer_;
+  std::unique_ptr<Resampler> resampler_;
+  std::vector<int16_t> resampled_;
+};
+
+}  // namespace ai_vox
+
+#endif
@@ -0,0 +1,137 @@
+#pragma once
+
+#ifndef _BUFFER_POOL_H_
+#define _BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
+/**
+ * Process-wide pool of fixed size classes for the per-frame buffers of the audio pipelines (Opus packets, PCM frames,
+ * task closures). Freed blocks are cached per size class and handed out again, so once the pipelines are warmed up
+ * the steady state does not touch the heap. Requests larger than the biggest size class fall back to the heap.
+ */
+class BufferPool {
+ public:
+  static constexpr size_t kSizeClasses[] = {64, 256, 512, 2048, 4096};
+  static constexpr size_t kSizeClassCount = sizeof(kSizeClasses) / sizeof(kSizeClasses[0]);
+  static constexpr size_t kMaxCachedBlocks = 32;  // per size class
+
+  static BufferPool &GetInstance() {
+    static BufferPool s_instance;
+    return s_instance;
+  }
+
+  // Returns a block of at least |size| usable bytes, |capacity| receives the actual usable size.
+  void *Allocate(const size_t size, size_t *capacity = nullptr) noexcept {
+    const auto size_class = SizeClassOf(size);
+    BlockHeader *block = nullptr;
+    if (size_class < kSizeClassCount) {
+      std::lock_guard lock(mutex_);
+      block = free_lists_[size_class];
+      if (block != nullptr) {
+        free_lists_[size_class] = block->next;
+        --free_counts_[size_class];
+      }
+    }
+
+    if (block == nullptr) {
+      const auto block_capacity = size_class < kSizeClassCount ? kSizeClasses[size_class] : size;
+      block = static_cast<BlockHeader *>(std::malloc(sizeof(BlockHeader) + block_capacity));
+      if (block == nullptr) {
+        return nullptr;
+      }
+      block->size_class = size_class;
+      block->capacity = block_capacity;
+      heap_allocation_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (capacity != nullptr) {
+      *capacity = block->capacity;
+    }
+    return block + 1;
+  }
+
+  void Free(void *buffer) noexcept {
+    if (buffer == nullptr) {
+      return;
+    }
+
+    auto block = static_cast<BlockHeader *>(buffer) - 1;
+    if (block->size_class < kSizeClassCount) {
+      std::lock_guard lock(mutex_);
+      if (free_counts_[block->size_class] < kMaxCachedBlocks) {
+        block->next = free_lists_[block->size_class];
+        free_lists_[block->size_class] = block;
+        ++free_counts_[block->size_class];
+        return;
+      }
+    }
+    std::free(block);
+  }
+
+  // Number of blocks that had to be taken from the heap so far, stays constant once the pool is warmed up.
+  uint32_t heap_allocation_count() const noexcept {
+    return heap_allocation_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct alignas(alignof(std::max_align_t)) BlockHeader {
+    BlockHeader *next;
+    size_t size_class;
+    size_t capacity;
+  };
+
+  BufferPool() = default;
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  static size_t SizeClassOf(const size_t size) noexcept {
+    for (size_t i = 0; i < kSizeClassCount; i++) {
+      if (size <= kSizeClasses[i]) {
+        return i;
+      }
+    }
+    return kSizeClassCount;
+  }
+
+  std::mutex mutex_;
+  BlockHeader *free_lists_[kSizeClassCount] = {nullptr};
+  size_t free_counts_[kSizeClassCount] = {0};
+  std::atomic<uint32_t> heap_allocation_count_ = 0;
+};
+
+// Standard allocator drawing from BufferPool, for containers on the per-frame paths.
+template <typename T>
+struct BufferPoolAllocator {
+  using value_type = T;
+
+  BufferPoolAllocator() noexcept = default;
+
+  template <typename U>
+  BufferPoolAllocator(const BufferPoolAllocator<U> &) noexcept {
+  }
+
+  T *allocate(const size_t n) {
+    return static_cast<T *>(BufferPool::GetInstance().Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, const size_t) noexcept {
+    BufferPool::GetInstance().Free(p);
+  }
+
+  template <typename U>
+  bool operator==(const BufferPoolAllocator<U> &) const noexcept {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const BufferPoolAllocator<U> &) const noexcept {
+    return false;
+  }
+};
+
+#endif
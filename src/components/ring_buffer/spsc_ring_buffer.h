@@ -0,0 +1,116 @@
+#pragma once
+
+#ifndef _SPSC_RING_BUFFER_H_
+#define _SPSC_RING_BUFFER_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Fixed-capacity, lock-free ring buffer for exactly one producer task and one consumer task.
+ *
+ * Write() is only called by the producer and Read()/Clear() only by the consumer. Items that do not fit are rejected and
+ * counted as overrun, reads that cannot be fully satisfied are rejected and counted as underrun, so no sample is ever
+ * lost without being accounted for.
+ */
+template <typename T>
+class SpscRingBuffer {
+  static_assert(std::is_trivial_v<T>, "SpscRingBuffer supports only trivial types");
+
+ public:
+  explicit SpscRingBuffer(const size_t capacity)
+      : capacity_(RoundUpToPowerOfTwo(capacity)), mask_(capacity_ - 1), buffer_(reinterpret_cast<T *>(std::malloc(capacity_ * sizeof(T)))) {
+    assert(buffer_ != nullptr);
+    if (buffer_ == nullptr) {
+      abort();
+    }
+  }
+
+  ~SpscRingBuffer() {
+    std::free(buffer_);
+  }
+
+  // Producer side. Returns the number of items written, items that do not fit are dropped and counted as overrun.
+  size_t Write(const T *data, const size_t count) noexcept {
+    const auto head = head_.load(std::memory_order_relaxed);
+    const auto tail = tail_.load(std::memory_order_acquire);
+    const auto free_count = capacity_ - (head - tail);
+    const auto write_count = count < free_count ? count : free_count;
+
+    const auto offset = head & mask_;
+    const auto first_count = write_count < capacity_ - offset ? write_count : capacity_ - offset;
+    std::memcpy(buffer_ + offset, data, first_count * sizeof(T));
+    std::memcpy(buffer_, data + first_count, (write_count - first_count) * sizeof(T));
+    head_.store(head + write_count, std::memory_order_release);
+
+    if (write_count < count) {
+      overrun_count_.fetch_add(count - write_count, std::memory_order_relaxed);
+    }
+    return write_count;
+  }
+
+  // Consumer side. Reads exactly |count| items, or nothing and counts an underrun if fewer are available.
+  bool Read(T *data, const size_t count) noexcept {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    const auto head = head_.load(std::memory_order_acquire);
+    if (head - tail < count) {
+      underrun_count_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    const auto offset = tail & mask_;
+    const auto first_count = count < capacity_ - offset ? count : capacity_ - offset;
+    std::memcpy(data, buffer_ + offset, first_count * sizeof(T));
+    std::memcpy(data + first_count, buffer_, (count - first_count) * sizeof(T));
+    tail_.store(tail + count, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Drops everything that is currently readable.
+  void Clear() noexcept {
+    tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  size_t size() const noexcept {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const noexcept {
+    return capacity_;
+  }
+
+  uint32_t overrun_count() const noexcept {
+    return overrun_count_.load(std::memory_order_relaxed);
+  }
+
+  uint32_t underrun_count() const noexcept {
+    return underrun_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  SpscRingBuffer(const SpscRingBuffer &) = delete;
+  SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+  static constexpr size_t RoundUpToPowerOfTwo(const size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  const size_t capacity_ = 0;
+  const size_t mask_ = 0;
+  T *const buffer_ = nullptr;
+  std::atomic<size_t> head_ = 0;
+  std::atomic<size_t> tail_ = 0;
+  std::atomic<uint32_t> overrun_count_ = 0;
+  std::atomic<uint32_t> underrun_count_ = 0;
+};
+
+#endif
@@ -18,11 +18,17 @@
 #include <string>
 #include <utility>
 
+#include "components/buffer_pool/buffer_pool.h"
+
 #define TASK_QUEUE_DEBUG (0)
 
 class ActiveTaskQueue {
  public:
-  ActiveTaskQueue(const std::string& name, const uint32_t stack_depth, UBaseType_t priority, const bool internal_memory = false)
+  ActiveTaskQueue(const std::string& name,
+                  const uint32_t stack_depth,
+                  UBaseType_t priority,
+                  const bool internal_memory = false,
+                  const BaseType_t core_id = tskNO_AFFINITY)
       :
 #if TASK_QUEUE_DEBUG
         name_(name),
@@ -30,7 +36,7 @@ class ActiveTaskQueue {
         stack_buffer_(static_cast<StackType_t*>(internal_memory
                                                     ? heap_caps_malloc(stack_depth * sizeof(StackType_t), MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL)
                                                     : heap_caps_malloc(stack_depth * sizeof(StackType_t), MALLOC_CAP_8BIT | MALLOC_CAP_DEFAULT))),
-        task_handle_(xTaskCreateStatic(&Loop, name.c_str(), stack_depth, this, priority, stack_buffer_, &task_buffer_)) {
+        task_handle_(xTaskCreateStaticPinnedToCore(&Loop, name.c_str(), stack_depth, this, priority, stack_buffer_, &task_buffer_, core_id)) {
     assert(stack_buffer_ != nullptr && task_handle_ != nullptr);
     if (stack_buffer_ == nullptr || task_handle_ == nullptr) {
       abort();
@@ -52,6 +58,14 @@ class ActiveTaskQueue {
     heap_caps_free(stack_buffer_);
   }
 
+  // Blocks until the tasks enqueued so far have run. Must not be called from the queue's own task.
+  void Sync() {
+    const auto sync_sem = xSemaphoreCreateBinary();
+    Enqueue([sync_sem]() { xSemaphoreGive(sync_sem); });
+    xSemaphoreTake(sync_sem, portMAX_DELAY);
+    vSemaphoreDelete(sync_sem);
+  }
+
   template <class F, class... Args>
   void Enqueue(F&& f, Args&&... args) {
     auto func = [f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable { f(std::forward<Args>(args)...); };
@@ -115,6 +129,14 @@ class ActiveTaskQueue {
   struct TaskInterface {
     virtual void Invoke() = 0;
     virtual ~TaskInterface() = default;
+
+    static void* operator new(const size_t size) {
+      return BufferPool::GetInstance().Allocate(size);
+    }
+
+    static void operator delete(void* ptr) {
+      BufferPool::GetInstance().Free(ptr);
+    }
   };
 
   template <typename Callable>
@@ -172,7 +194,7 @@ class ActiveTaskQueue {
   mutable std::mutex mutex_;
   std::condition_variable condition_;
   // std::priority_queue<Task, std::vector<Task>, std::greater<>> tasks_;
-  std::deque<Task> tasks_;
+  std::deque<Task, BufferPoolAllocator<Task>> tasks_;
   StackType_t* stack_buffer_ = nullptr;
   StaticTask_t task_buffer_;
   TaskHandle_t task_handle_ = nullptr;
@@ -8,10 +8,13 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include "audio_capture_hub.h"
 #include "audio_input_engine.h"
 #include "audio_output_engine.h"
 #include "components/cjson_util/cjson_util.h"
 #include "fetch_config.h"
+#include "opus_bitrate_controller.h"
+#include "tts_cache.h"
 #include "wake_net/wake_net.h"
 
 #ifndef CLOGGER_SEVERITY
@@ -75,6 +78,53 @@ std::string Uuid() {
   return std::string(uuid_str);
 }
 
+OpusBitrateController::Config UplinkBitrateConfig(const uint32_t frame_duration) {
+  OpusBitrateController::Config config;
+  config.frame_duration = frame_duration;
+  if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0) {
+    config.min_bitrate = 6000;
+    config.max_bitrate = 12000;
+    config.initial_bitrate = 8000;
+  }
+  return config;
+}
+
+AudioInputEngine::Config UplinkConfig(const SilenceSuppressionConfig &silence_suppression) {
+  AudioInputEngine::Config config;
+  config.silence_suppression = silence_suppression.enabled;
+  config.vad.threshold_ratio_q8 = silence_suppression.threshold * 256 / 100;
+  config.vad.min_speech_level = silence_suppression.min_speech_level;
+  config.vad.hangover_ms = silence_suppression.hangover;
+  config.keep_alive_interval = silence_suppression.keep_alive_interval;
+#ifdef ARDUINO_ESP32S3_DEV
+  config.max_pre_roll = WakeNet::kPreRollDuration;
+#endif
+  return config;
+}
+
+AudioOutputEngine::Config DownlinkConfig(const uint32_t frame_duration) {
+  AudioOutputEngine::Config config;
+  config.jitter_buffer.frame_duration = frame_duration;
+  config.jitter_buffer.start_threshold = frame_duration * 2;
+  config.jitter_buffer.max_conceal = frame_duration * 2;
+  config.catch_up_speed = 108;  // a gentle speed-up that is hardly noticeable in speech
+#if !CONFIG_FREERTOS_UNICORE
+  // Decoding next to the application, playback next to the network stack where it only copies PCM into DMA buffers.
+  config.decode_core = 1;
+  config.playback_core = 0;
+#endif
+  return config;
+}
+
+TtsCache::Config TtsCacheConfig(const size_t size, const uint32_t frame_duration) {
+  // A replayed sentence is pushed into the jitter buffer at once, on top of what is still buffered of the previous one.
+  constexpr uint32_t kMaxSentenceDuration = 1800;  // ms
+  TtsCache::Config config;
+  config.budget = size;
+  config.max_packets = kMaxSentenceDuration / frame_duration;
+  return config;
+}
+
 }  // namespace
 
 EngineImpl &EngineImpl::GetInstance() {
@@ -128,6 +178,45 @@ void EngineImpl::ConfigWebsocket(const std::string url, const std::map<std::stri
   }
 }
 
+void EngineImpl::SetAudioFrameDuration(const uint32_t frame_duration) {
+  std::lock_guard lock(mutex_);
+  if (state_ != State::kIdle) {
+    return;
+  }
+
+  // Whole 20 ms Opus frames, at least the 60 ms the downlink is decoded with and at most what one Opus packet can hold.
+  if (frame_duration < 60 || frame_duration > 120 || frame_duration % 20 != 0) {
+    CLOGE("unsupported audio frame duration: %" PRIu32 " ms", frame_duration);
+    return;
+  }
+  audio_frame_duration_ = frame_duration;
+}
+
+void EngineImpl::SetTtsCacheSize(const size_t size) {
+  std::lock_guard lock(mutex_);
+  if (state_ != State::kIdle) {
+    return;
+  }
+  tts_cache_size_ = size;
+}
+
+void EngineImpl::SetSilenceSuppression(const SilenceSuppressionConfig &config) {
+  std::lock_guard lock(mutex_);
+  if (state_ != State::kIdle) {
+    return;
+  }
+  silence_suppression_ = config;
+}
+
+void EngineImpl::SetSpeechSpeed(const uint32_t speed) {
+  task_queue_.Enqueue([this, speed]() {
+    speech_speed_ = speed;
+    if (audio_output_engine_) {
+      audio_output_engine_->set_speed(speed);
+    }
+  });
+}
+
 void EngineImpl::AddMcpTool(std::string name, std::string description, std::map<std::string, ParamSchemaVariant> attributes) {
   std::lock_guard lock(mutex_);
   if (state_ != State::kIdle) {
@@ -145,9 +234,13 @@ void EngineImpl::Start(std::shared_ptr<AudioInputDevice> audio_input_device, std
 
   audio_input_device_ = std::move(audio_input_device);
   audio_output_device_ = std::move(audio_output_device);
+  capture_hub_ = std::make_shared<AudioCaptureHub>(audio_input_device_);
+  if (tts_cache_size_ > 0) {
+    tts_cache_ = std::make_unique<TtsCache>(TtsCacheConfig(tts_cache_size_, audio_frame_duration_));
+  }
 #ifdef ARDUINO_ESP32S3_DEV
-  wake_net_ = std::make_unique<WakeNet>([this]() { task_queue_.Enqueue([this]() { OnWakeUp(); }); }, audio_input_device_);
-  wake_net_->Start();
+  wake_net_ = std::make_unique<WakeNet>([this]() { task_queue_.Enqueue([this]() { OnWakeUp(); }); }, capture_hub_);
+  wake_net_->Resume();
 #endif
 
   esp_websocket_client_config_t websocket_cfg;
@@ -282,20 +375,20 @@ void EngineImpl::OnWebsocketEvent(esp_event_base_t base, int32_t event_id, void
 
       switch (data->op_code) {
         case kWebsocketTextFrame: {
-          FlexArray<uint8_t> frame(data->data_len);
-          memcpy(frame.data(), data->data_ptr, data->data_len);
-          task_queue_.Enqueue([this, frame = std::move(frame)]() mutable {
+          // Copied out of the websocket buffer once, the observer and the JSON dispatcher share it.
+          auto frame = SharedBytes::Copy(data->data_ptr, data->data_len);
+          task_queue_.Enqueue([this, frame = std::move(frame)]() {
             if (observer_) {
               observer_->PushEvent(TextReceivedEvent{
-                  .content = std::string(reinterpret_cast<const char *>(frame.data()), frame.size()),
+                  .content = std::string(frame.view()),
               });
             }
-            OnJsonData(std::move(frame));
+            OnJsonData(frame);
           });
           break;
         }
         case kWebsocketBinaryFrame: {
-          FlexArray<uint8_t> frame(data->data_len);
+          Packet frame(data->data_len);
           memcpy(frame.data(), data->data_ptr, data->data_len);
           task_queue_.Enqueue([this, frame = std::move(frame)]() mutable { OnAudioFrame(std::move(frame)); });
           break;
@@ -321,13 +414,21 @@ void EngineImpl::OnWebsocketEvent(esp_event_base_t base, int32_t event_id, void
   }
 }
 
-void EngineImpl::OnAudioFrame(FlexArray<uint8_t> &&data) {
+void EngineImpl::OnAudioFrame(Packet &&data) {
+  if (tts_replaying_) {
+    return;
+  }
+
+  if (tts_cache_) {
+    tts_cache_->Record(data.data(), data.size());
+  }
+
   if (audio_output_engine_) {
     audio_output_engine_->Write(std::move(data));
   }
 }
 
-void EngineImpl::OnJsonData(FlexArray<uint8_t> &&data) {
+void EngineImpl::OnJsonData(const SharedBytes &data) {
   CLOGI("%.*s", static_cast<int>(data.size()), data.data());
 
   auto root_json_obj = cjson_util::MakeUnique(cJSON_ParseWithLength(reinterpret_cast<const char *>(data.data()), data.size()));
@@ -345,7 +446,6 @@ void EngineImpl::OnJsonData(FlexArray<uint8_t> &&data) {
   CLOGI("got type: %s", type->c_str());
 
   if (*type == "hello") {
-    const auto state = state_;
     if (state_ != State::kWebsocketConnected && state_ != State::kWebsocketConnectedWithWakeup) {
       CLOGE("Invalid state: %u", state_);
       return;
@@ -357,15 +457,6 @@ void EngineImpl::OnJsonData(FlexArray<uint8_t> &&data) {
     }
 
     StartListening();
-
-    if (state == State::kWebsocketConnectedWithWakeup) {
-      auto message_json_obj = cjson_util::MakeUnique();
-      cJSON_AddStringToObject(message_json_obj.get(), "session_id", session_id_.c_str());
-      cJSON_AddStringToObject(message_json_obj.get(), "type", "listen");
-      cJSON_AddStringToObject(message_json_obj.get(), "state", "detect");
-      cJSON_AddStringToObject(message_json_obj.get(), "text", "你好小智");
-      SendTextInternal(cjson_util::ToString(message_json_obj));
-    }
   } else if (*type == "goodbye") {
     CLOGI("goodbye");
     if (const auto session_id = cjson_util::GetString(root_json_obj.get(), "session_id")) {
@@ -391,13 +482,27 @@ void EngineImpl::OnJsonData(FlexArray<uint8_t> &&data) {
         return;
       }
 
-      audio_input_engine_.reset();
+      const auto start_time = esp_timer_get_time();
 #ifdef ARDUINO_ESP32S3_DEV
-      wake_net_->Start();
+      wake_net_->Resume();  // before the uplink lets go of the capture hub, so the microphone stays open
 #endif
-      audio_output_engine_ = std::make_shared<AudioOutputEngine>(audio_output_device_, audio_frame_duration_);
+      if (audio_input_engine_) {
+        audio_input_engine_->Pause();
+      }
+      if (!audio_output_engine_) {
+        audio_output_engine_ =
+            std::make_shared<AudioOutputEngine>(audio_output_device_, audio_frame_duration_, DownlinkConfig(audio_frame_duration_));
+        audio_output_engine_->set_speed(speech_speed_);
+      }
+      audio_output_engine_->Resume();
+      tts_replaying_ = false;
+      OnTurnSwitched(ChatState::kSpeaking, esp_timer_get_time() - start_time);
       ChangeState(State::kSpeaking);
     } else if (tts_state == "stop") {
+      if (tts_cache_) {
+        tts_cache_->EndRecording();
+      }
+      tts_replaying_ = false;
       if (audio_output_engine_) {
         audio_output_engine_->NotifyDataEnd([this]() { task_queue_.Enqueue([this]() { OnAudioOutputDataConsumed(); }); });
       }
@@ -406,11 +511,17 @@ void EngineImpl::OnJsonData(FlexArray<uint8_t> &&data) {
       if (text) {
         CLOGI("<< %s", text->c_str());
       }
+      if (tts_cache_ && text && state_ == State::kSpeaking) {
+        ReplayOrRecordSentence(*text);
+      }
       if (observer_) {
         observer_->PushEvent(ChatMessageEvent{ChatRole::kAssistant, std::move(*text)});
       }
     } else if (tts_state == "sentence_end") {
-      // Do nothing
+      if (tts_cache_) {
+        tts_cache_->EndRecording();
+      }
+      tts_replaying_ = false;
     }
   } else if (*type == "stt") {
     auto text = cjson_util::GetString(root_json_obj.get(), "text");
@@ -435,6 +546,26 @@ void EngineImpl::OnJsonData(FlexArray<uint8_t> &&data) {
   }
 }
 
+void EngineImpl::ReplayOrRecordSentence(const std::string &text) {
+  tts_cache_->EndRecording();  // in case the previous sentence had no sentence_end
+  tts_replaying_ = tts_cache_->Replay(text, [this](Packet &&packet) { audio_output_engine_->WriteLocal(std::move(packet)); });
+  if (!tts_replaying_) {
+    tts_cache_->BeginRecording(text);
+    return;
+  }
+
+  // The server may stop streaming this sentence, its audio is dropped until sentence_end either way.
+  CLOGI("playing from the cache, hits: %" PRIu32 ", misses: %" PRIu32, tts_cache_->hit_count(), tts_cache_->miss_count());
+  char text_hash[9];
+  snprintf(text_hash, sizeof(text_hash), "%08" PRIx32, TtsCache::Hash(text));
+  auto root_json_obj = cjson_util::MakeUnique();
+  cJSON_AddStringToObject(root_json_obj.get(), "session_id", session_id_.c_str());
+  cJSON_AddStringToObject(root_json_obj.get(), "type", "tts");
+  cJSON_AddStringToObject(root_json_obj.get(), "state", "cache_hit");
+  cJSON_AddStringToObject(root_json_obj.get(), "text_hash", text_hash);
+  SendTextInternal(cjson_util::ToString(root_json_obj));
+}
+
 void EngineImpl::OnWebSocketConnected() {
   CLOGI();
   if (state_ == State::kWebsocketConnecting) {
@@ -455,6 +586,10 @@ void EngineImpl::OnWebSocketConnected() {
   auto const features_obj = cJSON_CreateObject();
   // mcp:true
   cJSON_AddBoolToObject(features_obj, "mcp", true);
+  // tts_cache:true, sentences announced with sentence_start may be played from the device's cache, see ReplayOrRecordSentence()
+  if (tts_cache_) {
+    cJSON_AddBoolToObject(features_obj, "tts_cache", true);
+  }
   cJSON_AddItemToObject(root_json_obj.get(), "features", features_obj);
 
   auto const audio_params_obj = cJSON_CreateObject();
@@ -555,13 +690,11 @@ void EngineImpl::OnMcpJsonObj(cJSON *root_json_obj) {
 
 void EngineImpl::OnWebSocketDisconnected() {
   CLOGI();
-  audio_input_engine_.reset();
-  audio_output_engine_.reset();
-  esp_websocket_client_close(web_socket_client_, pdMS_TO_TICKS(5000));
-
 #ifdef ARDUINO_ESP32S3_DEV
-  wake_net_->Start();
+  wake_net_->Resume();
 #endif
+  PauseAudioEngines();
+  esp_websocket_client_close(web_socket_client_, pdMS_TO_TICKS(5000));
   ChangeState(State::kStandby);
 }
 
@@ -680,18 +813,52 @@ void EngineImpl::StartListening() {
   cJSON_AddStringToObject(root_json_obj.get(), "mode", "auto");
   SendTextInternal(cjson_util::ToString(root_json_obj));
 
-  audio_output_engine_.reset();
+  if (state_ == State::kWebsocketConnectedWithWakeup) {
+    // Queued ahead of the pre-roll audio below.
+    auto message_json_obj = cjson_util::MakeUnique();
+    cJSON_AddStringToObject(message_json_obj.get(), "session_id", session_id_.c_str());
+    cJSON_AddStringToObject(message_json_obj.get(), "type", "listen");
+    cJSON_AddStringToObject(message_json_obj.get(), "state", "detect");
+    cJSON_AddStringToObject(message_json_obj.get(), "text", "你好小智");
+    SendTextInternal(cjson_util::ToString(message_json_obj));
+  }
+
+  const auto start_time = esp_timer_get_time();
+  if (audio_output_engine_) {
+    audio_output_engine_->Pause();
+  }
+  if (!audio_input_engine_) {
+    CreateAudioInputEngine();
+  }
 #ifdef ARDUINO_ESP32S3_DEV
-  wake_net_->Stop();
+  // Speech that followed the wake word while the connection was being set up goes out first. Wake net stays subscribed
+  // until the uplink is, so the pre-roll runs right up to the uplink's first capture block.
+  wake_net_->Suspend();
+  if (state_ == State::kWebsocketConnectedWithWakeup) {
+    audio_input_engine_->Resume([this](const uint32_t first_sequence) { return wake_net_->TakePreRoll(first_sequence); });
+  } else {
+    audio_input_engine_->Resume(nullptr);
+  }
+  wake_net_->Pause();
+#else
+  audio_input_engine_->Resume(nullptr);
 #endif
+  OnTurnSwitched(ChatState::kListening, esp_timer_get_time() - start_time);
+  ChangeState(State::kListening);
+}
+
+void EngineImpl::CreateAudioInputEngine() {
+  // Lives until the engine is destroyed, the bitrate adapted in one turn carries over to the next.
+  auto bitrate_controller = std::make_shared<OpusBitrateController>(UplinkBitrateConfig(audio_frame_duration_));
   audio_input_engine_ = std::make_shared<AudioInputEngine>(
-      audio_input_device_,
-      [this](FlexArray<uint8_t> &&data) mutable {
+      capture_hub_,
+      [this, bitrate_controller](Packet &&data) mutable {
         if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0 && network_task_queue_.size() > 5) {
+          bitrate_controller->ReportDrop();
           return;
         }
 
-        network_task_queue_.Enqueue([this, data = std::move(data)]() mutable {
+        network_task_queue_.Enqueue([this, bitrate_controller, data = std::move(data)]() mutable {
           if (esp_websocket_client_is_connected(web_socket_client_)) {
             const auto start_time = esp_timer_get_time();
             if (data.size() !=
@@ -703,11 +870,29 @@ void EngineImpl::StartListening() {
             if (elapsed_time > 100 * 1000) {
               CLOGW("network latency high: %lld ms, data size: %zu bytes, poor network condition detected", elapsed_time / 1000, data.size());
             }
+            bitrate_controller->ReportSend(elapsed_time, network_task_queue_.size());
           }
         });
       },
-      audio_frame_duration_);
-  ChangeState(State::kListening);
+      audio_frame_duration_,
+      UplinkConfig(silence_suppression_),
+      bitrate_controller);
+}
+
+void EngineImpl::PauseAudioEngines() {
+  if (audio_input_engine_) {
+    audio_input_engine_->Pause();
+  }
+  if (audio_output_engine_) {
+    audio_output_engine_->Pause();
+  }
+}
+
+void EngineImpl::OnTurnSwitched(const ChatState new_state, const int64_t duration_us) {
+  CLOGI("turn switch to %u took %lld us", new_state, duration_us);
+  if (observer_) {
+    observer_->PushEvent(TurnSwitchEvent{new_state, duration_us});
+  }
 }
 
 void EngineImpl::AbortSpeaking() {
@@ -720,6 +905,13 @@ void EngineImpl::AbortSpeaking() {
   cJSON_AddStringToObject(root_json_obj.get(), "session_id", session_id_.c_str());
   cJSON_AddStringToObject(root_json_obj.get(), "type", "abort");
   SendTextInternal(cjson_util::ToString(root_json_obj));
+  if (tts_cache_) {
+    tts_cache_->CancelRecording();
+  }
+  tts_replaying_ = false;
+  if (audio_output_engine_) {
+    audio_output_engine_->Abort();  // stop locally right away instead of waiting for the server to end the turn
+  }
 }
 
 void EngineImpl::AbortSpeaking(const std::string &reason) {
@@ -733,6 +925,13 @@ void EngineImpl::AbortSpeaking(const std::string &reason) {
   cJSON_AddStringToObject(root_json_obj.get(), "type", "abort");
   cJSON_AddStringToObject(root_json_obj.get(), "reason", reason.c_str());
   SendTextInternal(cjson_util::ToString(root_json_obj));
+  if (tts_cache_) {
+    tts_cache_->CancelRecording();
+  }
+  tts_replaying_ = false;
+  if (audio_output_engine_) {
+    audio_output_engine_->Abort();
+  }
 }
 
 bool EngineImpl::ConnectWebSocket() {
@@ -748,11 +947,10 @@ bool EngineImpl::ConnectWebSocket() {
 }
 
 void EngineImpl::DisconnectWebSocket() {
-  audio_input_engine_.reset();
-  audio_output_engine_.reset();
 #ifdef ARDUINO_ESP32S3_DEV
-  wake_net_->Start();
+  wake_net_->Resume();
 #endif
+  PauseAudioEngines();
   esp_websocket_client_close(web_socket_client_, pdMS_TO_TICKS(5000));
 }
 
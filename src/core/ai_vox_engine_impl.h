@@ -24,10 +24,14 @@
 #include "core/ai_vox_mcp_tool_manager.h"
 #include "espressif_esp_websocket_client/esp_websocket_client.h"
 #include "flex_array/flex_array.h"
+#include "flex_array/packet.h"
+#include "flex_array/shared_bytes.h"
 
 struct button_dev_t;
+class AudioCaptureHub;
 class AudioInputEngine;
 class AudioOutputEngine;
+class TtsCache;
 class WakeNet;
 class Config;
 namespace ai_vox {
@@ -40,6 +44,10 @@ class EngineImpl : public Engine {
   void SetObserver(std::shared_ptr<Observer> observer) override;
   void SetOtaUrl(const std::string url) override;
   void ConfigWebsocket(const std::string url, const std::map<std::string, std::string> headers) override;
+  void SetAudioFrameDuration(const uint32_t frame_duration) override;
+  void SetTtsCacheSize(const size_t size) override;
+  void SetSilenceSuppression(const SilenceSuppressionConfig &config) override;
+  void SetSpeechSpeed(const uint32_t speed) override;
   void AddMcpTool(std::string name, std::string description, std::map<std::string, ParamSchemaVariant> attributes) override;
   void Start(std::shared_ptr<AudioInputDevice> audio_input_device, std::shared_ptr<AudioOutputDevice> audio_output_device) override;
   void Advance() override;
@@ -70,8 +78,8 @@ class EngineImpl : public Engine {
   static void OnWebsocketEvent(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
 
   void OnWebsocketEvent(esp_event_base_t base, int32_t event_id, void *event_data);
-  void OnAudioFrame(FlexArray<uint8_t> &&data);
-  void OnJsonData(FlexArray<uint8_t> &&data);
+  void OnAudioFrame(Packet &&data);
+  void OnJsonData(const SharedBytes &data);
   void OnMcpJsonObj(cJSON *json_obj);
   void OnWebSocketConnected();
   void OnWebSocketDisconnected();
@@ -82,6 +90,10 @@ class EngineImpl : public Engine {
 
   void LoadProtocol();
   void StartListening();
+  void CreateAudioInputEngine();
+  void PauseAudioEngines();
+  void OnTurnSwitched(const ChatState new_state, const int64_t duration_us);
+  void ReplayOrRecordSentence(const std::string &text);
   void AbortSpeaking();
   void AbortSpeaking(const std::string &reason);
   bool ConnectWebSocket();
@@ -99,6 +111,7 @@ class EngineImpl : public Engine {
   esp_websocket_client_handle_t web_socket_client_ = nullptr;
   std::string uuid_;
   std::string session_id_;
+  std::shared_ptr<AudioCaptureHub> capture_hub_;
   std::shared_ptr<AudioInputEngine> audio_input_engine_;
   std::shared_ptr<AudioOutputEngine> audio_output_engine_;
   std::string ota_url_;
@@ -111,7 +124,12 @@ class EngineImpl : public Engine {
   ActiveTaskQueue task_queue_;
   ActiveTaskQueue network_task_queue_;
   mcp::ToolManager mcp_tool_manager_;
-  const uint32_t audio_frame_duration_ = 60;
+  uint32_t audio_frame_duration_ = 60;
+  size_t tts_cache_size_ = 0;
+  SilenceSuppressionConfig silence_suppression_;
+  std::unique_ptr<TtsCache> tts_cache_;
+  bool tts_replaying_ = false;  // the current sentence plays from the cache, the server's audio for it is dropped
+  uint32_t speech_speed_ = 100;
 };
 }  // namespace ai_vox
 
@@ -0,0 +1,242 @@
+#include "audio_capture_hub.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "components/buffer_pool/buffer_pool.h"
+#include "resampler.h"
+
+#ifndef CLOGGER_SEVERITY
+#define CLOGGER_SEVERITY CLOGGER_SEVERITY_WARN
+#endif
+
+#include "clogger/clogger.h"
+
+namespace {
+constexpr uint32_t kStreamBufferBlocks = 4;
+constexpr TickType_t kStreamReceiveTimeout = pdMS_TO_TICKS(AudioCaptureHub::kBlockDuration * 4);
+}  // namespace
+
+AudioBlock *AudioBlock::Create(const size_t samples) {
+  static_assert(sizeof(AudioBlock) % alignof(int16_t) == 0);
+  auto *memory = BufferPool::GetInstance().Allocate(sizeof(AudioBlock) + samples * sizeof(int16_t));
+  assert(memory != nullptr);
+  return new (memory) AudioBlock(samples);
+}
+
+void AudioBlock::Release() {
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    this->~AudioBlock();
+    BufferPool::GetInstance().Free(this);
+  }
+}
+
+AudioCaptureHub::Subscriber::Subscriber(const size_t queue_blocks) : queue_(queue_blocks), ready_sem_(xSemaphoreCreateBinary()) {
+  assert(ready_sem_ != nullptr);
+}
+
+AudioCaptureHub::Subscriber::~Subscriber() {
+  Clear();
+  vSemaphoreDelete(ready_sem_);
+}
+
+AudioBlockRef AudioCaptureHub::Subscriber::Pop(const TickType_t timeout) {
+  if (queue_.size() == 0 && xSemaphoreTake(ready_sem_, timeout) != pdTRUE) {
+    // A real timeout, as opposed to a wake-up by Interrupt() or by a block that has already been popped.
+    if (attached_.load(std::memory_order_relaxed)) {
+      underrun_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return AudioBlockRef();
+  }
+
+  AudioBlock *block = nullptr;
+  if (queue_.size() > 0) {
+    queue_.Read(&block, 1);
+  }
+  return AudioBlockRef(block);
+}
+
+void AudioCaptureHub::Subscriber::Clear() {
+  AudioBlock *block = nullptr;
+  while (queue_.size() > 0 && queue_.Read(&block, 1)) {
+    block->Release();
+  }
+}
+
+void AudioCaptureHub::Subscriber::Interrupt() {
+  xSemaphoreGive(ready_sem_);
+}
+
+void AudioCaptureHub::Subscriber::Push(AudioBlock *block) {
+  block->AddRef();
+  if (queue_.Write(&block, 1) != 1) {
+    block->Release();
+    return;
+  }
+
+  const auto lag = queue_.size();
+  if (lag > max_lag_) {
+    max_lag_ = lag;
+  }
+  xSemaphoreGive(ready_sem_);
+}
+
+AudioCaptureHub::AudioCaptureHub(std::shared_ptr<ai_vox::AudioInputDevice> audio_input_device)
+    : audio_input_device_(std::move(audio_input_device)) {
+  capture_task_queue_ = new ActiveTaskQueue("AudioCapture", 6 << 10, tskIDLE_PRIORITY + 2);
+}
+
+AudioCaptureHub::~AudioCaptureHub() {
+  bool open = false;
+  {
+    std::lock_guard lock(mutex_);
+    open = !subscribers_.empty();
+    for (auto *subscriber : subscribers_) {
+      subscriber->attached_.store(false, std::memory_order_relaxed);
+    }
+    subscribers_.clear();
+  }
+  if (open) {
+    Close();
+  }
+  delete capture_task_queue_;
+}
+
+void AudioCaptureHub::Attach(Subscriber *subscriber) {
+  bool first = false;
+  {
+    std::lock_guard lock(mutex_);
+    if (std::find(subscribers_.begin(), subscribers_.end(), subscriber) != subscribers_.end()) {
+      return;
+    }
+    first = subscribers_.empty();
+    subscribers_.push_back(subscriber);
+    subscriber->attached_.store(true, std::memory_order_relaxed);
+    subscriber->first_sequence_.store(next_sequence_, std::memory_order_relaxed);
+  }
+
+  if (first) {
+    Open();
+  }
+}
+
+void AudioCaptureHub::Detach(Subscriber *subscriber) {
+  bool last = false;
+  {
+    std::lock_guard lock(mutex_);
+    auto it = std::find(subscribers_.begin(), subscribers_.end(), subscriber);
+    if (it == subscribers_.end()) {
+      return;
+    }
+    subscribers_.erase(it);
+    subscriber->attached_.store(false, std::memory_order_relaxed);
+    last = subscribers_.empty();
+  }
+
+  if (last) {
+    Close();
+  }
+}
+
+void AudioCaptureHub::Open() {
+  CLOGI();
+  audio_input_device_->OpenInput(kSampleRate);
+  if (audio_input_device_->input_sample_rate() != kSampleRate && !resampler_) {
+    resampler_ = Resampler::Create(audio_input_device_->input_sample_rate(), kSampleRate);
+  } else if (resampler_) {
+    resampler_->Reset();
+  }
+
+  const uint32_t samples = audio_input_device_->input_sample_rate() / 1000 * kBlockDuration;
+  const size_t block_bytes = samples * sizeof(int16_t);
+  stream_ = xStreamBufferCreate(block_bytes * kStreamBufferBlocks, block_bytes);
+  if (stream_ != nullptr && !audio_input_device_->StartStream(stream_)) {
+    vStreamBufferDelete(stream_);
+    stream_ = nullptr;
+  }
+
+  const auto run = run_.load();
+  capture_task_queue_->Enqueue([this, samples, run]() { CaptureData(samples, run); });
+  CLOGI("OK, %s", stream_ != nullptr ? "interrupt driven" : "polling");
+}
+
+void AudioCaptureHub::Close() {
+  CLOGI();
+  ++run_;
+  if (stream_ != nullptr) {
+    audio_input_device_->StopStream();
+  }
+  capture_task_queue_->Sync();
+  audio_input_device_->CloseInput();
+  if (stream_ != nullptr) {
+    vStreamBufferDelete(stream_);
+    stream_ = nullptr;
+  }
+  CLOGI("OK");
+}
+
+void AudioCaptureHub::CaptureData(const uint32_t samples, const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
+
+  AudioBlock *block = nullptr;
+  if (resampler_) {
+    FlexArray<int16_t> pcm(samples);
+    if (ReadInput(pcm.data(), pcm.size(), run)) {
+      // The block is sized to exactly what the resampler writes.
+      block = AudioBlock::Create(resampler_->output_size(samples));
+      resampler_->Resample(pcm.data(), samples, block->data(), block->size());
+    }
+  } else {
+    block = AudioBlock::Create(samples);
+    if (!ReadInput(block->data(), samples, run)) {
+      block->Release();
+      block = nullptr;
+    }
+  }
+
+  if (block == nullptr) {
+    if (run == run_) {
+      capture_task_queue_->Enqueue([this, samples, run]() { CaptureData(samples, run); });
+    }
+    return;
+  }
+
+  {
+    std::lock_guard lock(mutex_);
+    block->sequence_ = next_sequence_++;
+    for (auto *subscriber : subscribers_) {
+      subscriber->Push(block);
+    }
+  }
+  block->Release();
+
+  capture_task_queue_->Enqueue([this, samples, run]() { CaptureData(samples, run); });
+}
+
+bool AudioCaptureHub::ReadInput(int16_t *pcm, const uint32_t samples, const uint32_t run) {
+  if (stream_ == nullptr) {
+    audio_input_device_->Read(pcm, samples);
+    return true;
+  }
+
+  const size_t bytes = samples * sizeof(int16_t);
+  size_t received = 0;
+  while (received < bytes && run == run_) {
+    const auto ret = xStreamBufferReceive(stream_, reinterpret_cast<uint8_t *>(pcm) + received, bytes - received, kStreamReceiveTimeout);
+    if (ret == 0) {
+      break;
+    }
+    received += ret;
+  }
+
+  if (received < bytes) {
+    if (run == run_) {
+      CLOGW("incomplete block, %zu of %zu bytes received", received, bytes);
+    }
+    return false;
+  }
+  return true;
+}
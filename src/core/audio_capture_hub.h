@@ -0,0 +1,212 @@
+#pragma once
+
+#ifndef _AUDIO_CAPTURE_HUB_H_
+#define _AUDIO_CAPTURE_HUB_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "audio_device/audio_input_device.h"
+#include "components/ring_buffer/spsc_ring_buffer.h"
+#include "components/task_queue/active_task_queue.h"
+#include "flex_array/flex_array.h"
+
+class Resampler;
+
+/**
+ * A block of captured 16 kHz mono PCM shared by every subscriber that received it. Blocks are immutable once published
+ * and freed back to the buffer pool when the last reference is released.
+ */
+class AudioBlock {
+ public:
+  static AudioBlock *Create(const size_t samples);
+
+  void AddRef() {
+    refs_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void Release();
+
+  const int16_t *data() const {
+    return reinterpret_cast<const int16_t *>(this + 1);
+  }
+
+  int16_t *data() {
+    return reinterpret_cast<int16_t *>(this + 1);
+  }
+
+  size_t size() const {
+    return samples_;
+  }
+
+  // Capture order, consecutive blocks have consecutive numbers. Wraps around.
+  uint32_t sequence() const {
+    return sequence_;
+  }
+
+ private:
+  friend class AudioCaptureHub;
+  explicit AudioBlock(const size_t samples) : samples_(samples) {
+  }
+  ~AudioBlock() = default;
+  AudioBlock(const AudioBlock &) = delete;
+  AudioBlock &operator=(const AudioBlock &) = delete;
+
+  std::atomic<uint32_t> refs_ = 1;
+  const size_t samples_ = 0;
+  uint32_t sequence_ = 0;
+};
+
+// Owning handle to one reference of an AudioBlock.
+class AudioBlockRef {
+ public:
+  AudioBlockRef() = default;
+
+  // Adopts a reference the caller already holds.
+  explicit AudioBlockRef(AudioBlock *block) : block_(block) {
+  }
+
+  AudioBlockRef(const AudioBlockRef &other) : block_(other.block_) {
+    if (block_ != nullptr) {
+      block_->AddRef();
+    }
+  }
+
+  AudioBlockRef(AudioBlockRef &&other) noexcept : block_(other.block_) {
+    other.block_ = nullptr;
+  }
+
+  AudioBlockRef &operator=(AudioBlockRef other) noexcept {
+    std::swap(block_, other.block_);
+    return *this;
+  }
+
+  ~AudioBlockRef() {
+    if (block_ != nullptr) {
+      block_->Release();
+    }
+  }
+
+  explicit operator bool() const {
+    return block_ != nullptr;
+  }
+
+  const int16_t *data() const {
+    return block_->data();
+  }
+
+  size_t size() const {
+    return block_->size();
+  }
+
+  uint32_t sequence() const {
+    return block_->sequence();
+  }
+
+ private:
+  AudioBlock *block_ = nullptr;
+};
+
+/**
+ * Owns the input device and a single capture task, and fans every captured block out to the attached subscribers
+ * without copying. The device is open while at least one subscriber is attached.
+ *
+ * Each subscriber has its own bounded queue, a slow subscriber only loses its own blocks and never holds up capture
+ * or the other subscribers.
+ *
+ * Devices that support AudioInputDevice::StartStream() push samples from their receive interrupt into a stream buffer
+ * and the capture task sleeps until a whole block is there, others are polled with Read().
+ */
+class AudioCaptureHub {
+ public:
+  static constexpr uint32_t kSampleRate = 16000;  // Hz
+  static constexpr uint32_t kBlockDuration = 20;  // ms
+  static constexpr size_t kBlockSamples = kSampleRate / 1000 * kBlockDuration;
+
+  class Subscriber {
+   public:
+    explicit Subscriber(const size_t queue_blocks);
+    ~Subscriber();
+
+    // Consumer side. Waits up to |timeout| for the next block, an empty handle means the wait timed out or was
+    // interrupted.
+    AudioBlockRef Pop(const TickType_t timeout);
+
+    // Consumer side, or while detached. Releases every queued block.
+    void Clear();
+
+    // Wakes a consumer blocked in Pop().
+    void Interrupt();
+
+    // Sequence number of the first block pushed since the last Attach(). Another subscriber's audio up to, not including,
+    // this block continues into this subscriber's without a gap or an overlap.
+    uint32_t first_sequence() const {
+      return first_sequence_.load(std::memory_order_relaxed);
+    }
+
+    // Blocks currently queued, i.e. how far the consumer is behind capture.
+    size_t lag() const {
+      return queue_.size();
+    }
+
+    size_t max_lag() const {
+      return max_lag_;
+    }
+
+    // Blocks dropped because the queue was full.
+    uint32_t overrun_count() const {
+      return queue_.overrun_count();
+    }
+
+    // Pop() calls that timed out while attached, wake-ups by Interrupt() are not counted.
+    uint32_t underrun_count() const {
+      return underrun_count_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    friend class AudioCaptureHub;
+    Subscriber(const Subscriber &) = delete;
+    Subscriber &operator=(const Subscriber &) = delete;
+
+    void Push(AudioBlock *block);
+
+    SpscRingBuffer<AudioBlock *> queue_;
+    SemaphoreHandle_t ready_sem_ = nullptr;
+    std::atomic<size_t> max_lag_ = 0;
+    std::atomic<uint32_t> underrun_count_ = 0;
+    std::atomic<bool> attached_ = false;
+    std::atomic<uint32_t> first_sequence_ = 0;
+  };
+
+  explicit AudioCaptureHub(std::shared_ptr<ai_vox::AudioInputDevice> audio_input_device);
+  ~AudioCaptureHub();
+
+  void Attach(Subscriber *subscriber);
+  void Detach(Subscriber *subscriber);
+
+ private:
+  AudioCaptureHub(const AudioCaptureHub &) = delete;
+  AudioCaptureHub &operator=(const AudioCaptureHub &) = delete;
+
+  void Open();
+  void Close();
+  void CaptureData(const uint32_t samples, const uint32_t run);
+  bool ReadInput(int16_t *pcm, const uint32_t samples, const uint32_t run);
+
+  std::shared_ptr<ai_vox::AudioInputDevice> audio_input_device_;
+  std::unique_ptr<Resampler> resampler_;
+  StreamBufferHandle_t stream_ = nullptr;  // set while the device pushes samples
+  std::mutex mutex_;
+  std::vector<Subscriber *> subscribers_;
+  uint32_t next_sequence_ = 0;  // guarded by |mutex_|, so a subscriber attaches exactly between two blocks
+  std::atomic<uint32_t> run_ = 0;
+  ActiveTaskQueue *capture_task_queue_ = nullptr;
+};
+
+#endif
@@ -1,7 +1,11 @@
 #include "audio_input_engine.h"
 
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstring>
+
 #include "libopus/opus.h"
-#include "silk_resampler.h"
 
 #ifndef CLOGGER_SEVERITY
 #define CLOGGER_SEVERITY CLOGGER_SEVERITY_WARN
@@ -11,17 +15,81 @@
 
 namespace {
 constexpr size_t kMaxOpusPacketSize = 1500;
-constexpr uint32_t kFrameDuration = 20;                          // ms
-constexpr uint32_t kDefaultSampleRate = 16000;                   // Hz
-constexpr uint32_t kDefaultChannels = 1;                         // Mono
-constexpr size_t kMaxFrameSize = 16000 / 1000 * kFrameDuration;  // 16000 Hz * 20 ms
+constexpr uint32_t kDefaultSampleRate = AudioCaptureHub::kSampleRate;
+constexpr uint32_t kDefaultChannels = 1;  // Mono
+constexpr uint32_t kMaxPacketDuration = 120;                     // ms, the most audio a single Opus packet can carry
+constexpr uint32_t kQueueFrames = 4;                             // encoder jitter absorbed by the subscriber queue
+constexpr int32_t kMaxComplexityWithoutPsram = 2;                // keeps the encoder within the smaller task stack
+
+// From opus_private.h, which cannot be included without the libopus sources.
+constexpr int kOpusSetForceModeRequest = 11002;
+constexpr int kModeSilkOnly = 1000;
+constexpr int kModeHybrid = 1001;
+constexpr int kModeCeltOnly = 1002;
+
+uint32_t OpusFrameDuration(const uint32_t frame_duration, const AudioInputEngine::Config &config) {
+  if (config.opus_frame_duration != 0) {
+    return config.opus_frame_duration;
+  }
+  for (const uint32_t duration : {60, 40, 20, 10}) {
+    if (frame_duration % duration == 0) {
+      return duration;
+    }
+  }
+  return 0;
+}
+
+// The coding mode of a packet from the configuration number in its TOC byte, RFC 6716 section 3.1.
+int ModeOf(const uint8_t toc) {
+  const auto configuration = toc >> 3;
+  return configuration < 12 ? kModeSilkOnly : configuration < 16 ? kModeHybrid : kModeCeltOnly;
+}
+
+// Live capture queues up while a pre-roll is encoded. Encoding runs faster than real time, so it falls behind by less
+// than the pre-roll duration.
+size_t SubscriberQueueBlocks(const uint32_t frame_duration, const AudioInputEngine::Config &config) {
+  constexpr auto kBlockDuration = AudioCaptureHub::kBlockDuration;
+  return (frame_duration + kBlockDuration - 1) / kBlockDuration * kQueueFrames + (config.max_pre_roll + kBlockDuration - 1) / kBlockDuration;
+}
+
+OpusComplexityController::Config ComplexityConfig(const AudioInputEngine::Config &config) {
+  auto complexity = config.complexity;
+  if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0) {
+    complexity.max_complexity = std::min(complexity.max_complexity, kMaxComplexityWithoutPsram);
+    complexity.initial_complexity = complexity.min_complexity;
+  }
+  return complexity;
+}
 }  // namespace
 
-AudioInputEngine::AudioInputEngine(std::shared_ptr<ai_vox::AudioInputDevice> audio_input_device,
+AudioInputEngine::AudioInputEngine(std::shared_ptr<AudioCaptureHub> capture_hub,
                                    AudioInputEngine::DataHandler &&handler,
-                                   const uint32_t frame_duration)
-    : handler_(std::move(handler)), audio_input_device_(std::move(audio_input_device)) {
+                                   const uint32_t frame_duration,
+                                   const Config &config,
+                                   std::shared_ptr<OpusBitrateController> bitrate_controller)
+    : handler_(std::move(handler)),
+      capture_hub_(std::move(capture_hub)),
+      frame_duration_(frame_duration),
+      config_(config),
+      keep_alive_frames_(std::max<uint32_t>(config.keep_alive_interval / frame_duration, 1)),
+      frames_per_packet_(OpusFrameDuration(frame_duration, config) == 0 ? 0 : frame_duration / OpusFrameDuration(frame_duration, config)),
+      opus_frames_(kMaxOpusPacketSize),
+      packet_buffer_(kMaxOpusPacketSize),
+      bandwidth_(OPUS_AUTO),
+      complexity_controller_(ComplexityConfig(config), frame_duration),
+      subscriber_(SubscriberQueueBlocks(frame_duration, config)),
+      pcm_frame_(kDefaultSampleRate / 1000 * frame_duration),
+      vad_(config.vad, frame_duration),
+      lookback_frame_(kDefaultSampleRate / 1000 * frame_duration) {
   CLOGI();
+  const auto opus_frame_duration = OpusFrameDuration(frame_duration, config);
+  if ((opus_frame_duration != 10 && opus_frame_duration != 20 && opus_frame_duration != 40 && opus_frame_duration != 60) ||
+      frame_duration % opus_frame_duration != 0 || frame_duration > kMaxPacketDuration) {
+    CLOG("unsupported packetization: %" PRIu32 " ms frames in %" PRIu32 " ms packets", opus_frame_duration, frame_duration);
+    abort();
+    return;
+  }
+
   int error = 0;
   opus_encoder_ = opus_encoder_create(kDefaultSampleRate, kDefaultChannels, OPUS_APPLICATION_VOIP, &error);
   assert(opus_encoder_ != nullptr);
@@ -31,75 +99,240 @@ AudioInputEngine::AudioInputEngine(std::shared_ptr<ai_vox::AudioInputDevice> aud
     return;
   }
 
+  repacketizer_ = opus_repacketizer_create();
+  assert(repacketizer_ != nullptr);
+
   uint32_t stack_size = 32 << 10;
   opus_encoder_ctl(opus_encoder_, OPUS_SET_DTX(0));
   if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0) {
-    opus_encoder_ctl(opus_encoder_, OPUS_SET_COMPLEXITY(0));
-    opus_encoder_ctl(opus_encoder_, OPUS_SET_BITRATE(8000));
+    opus_encoder_ctl(opus_encoder_, OPUS_SET_BITRATE(8000));  // overridden by the bitrate controller, if any
     stack_size = 20 << 10;
-  } else {
-    opus_encoder_ctl(opus_encoder_, OPUS_SET_COMPLEXITY(5));
   }
-  CLOGI();
+  ApplyComplexity(complexity_controller_.complexity());
+  bitrate_controller_ = std::move(bitrate_controller);
+  ApplyBitrate();
+
+  encode_task_queue_ = new ActiveTaskQueue("AudioInput", stack_size, tskIDLE_PRIORITY + 1);
+  CLOGI("OK");
+}
 
-  audio_input_device_->OpenInput(kDefaultSampleRate);
+AudioInputEngine::~AudioInputEngine() {
   CLOGI();
+  Pause();
+  delete encode_task_queue_;
+  opus_encoder_destroy(opus_encoder_);
+  opus_repacketizer_destroy(repacketizer_);
+  CLOG("OK, overrun: %" PRIu32 " blocks, underrun: %" PRIu32 ", max lag: %zu blocks, frames encoded: %" PRIu32 ", suppressed: %" PRIu32
+       ", split packets: %" PRIu32,
+       subscriber_.overrun_count(),
+       subscriber_.underrun_count(),
+       subscriber_.max_lag(),
+       frames_encoded_.load(),
+       frames_suppressed_.load(),
+       split_packet_count_.load());
 
-  if (audio_input_device_->input_sample_rate() != kDefaultSampleRate) {
-    resampler_ = std::make_unique<SilkResampler>(audio_input_device_->input_sample_rate(), kDefaultSampleRate);
+  const auto histogram = complexity_controller_.histogram();
+  for (size_t i = 0; i < histogram.size(); i++) {
+    if (histogram[i] > 0) {
+      CLOG("encode time %zu%%%s of frame: %" PRIu32 " frames", i * 10, i + 1 == histogram.size() ? " or more" : "", histogram[i]);
+    }
   }
+}
+
+void AudioInputEngine::Resume(PreRollSource &&pre_roll) {
   CLOGI();
-  task_queue_ = new ActiveTaskQueue("AudioInput", stack_size, tskIDLE_PRIORITY + 1);
-  task_queue_->Enqueue([this, samples = audio_input_device_->input_sample_rate() / 1000 * frame_duration]() { PullData(samples); });
+  if (!paused_) {
+    return;
+  }
+
+  // The encode task is idle here, so the per-turn state can be reset without locking. The encoder keeps its settings.
+  opus_encoder_ctl(opus_encoder_, OPUS_RESET_STATE);
+  vad_.Reset();
+  has_lookback_frame_ = false;
+  silent_frames_ = 0;
+  pcm_frame_fill_ = 0;
+  subscriber_.Clear();
+  paused_ = false;
+
+  // Subscribed first, so the pre-roll can be cut exactly where live capture starts.
+  capture_hub_->Attach(&subscriber_);
+  auto pre_roll_pcm = pre_roll ? pre_roll(subscriber_.first_sequence()) : FlexArray<int16_t>(0);
+
+  const auto run = run_.load();
+  if (pre_roll_pcm.size() >= pcm_frame_.size()) {
+    encode_task_queue_->Enqueue([this, pre_roll_pcm = std::move(pre_roll_pcm)]() { EncodePreRoll(pre_roll_pcm); });
+  }
+  encode_task_queue_->Enqueue([this, run]() { EncodeData(run); });
   CLOGI("OK");
 }
 
-AudioInputEngine::~AudioInputEngine() {
+void AudioInputEngine::Pause() {
   CLOGI();
-  delete task_queue_;
-  // delete reinterpret_cast<silk_resampler_state_struct *>(silk_resampler_);
-  audio_input_device_->CloseInput();
-  opus_encoder_destroy(opus_encoder_);
-  CLOG("OK");
-}
-
-FlexArray<int16_t> AudioInputEngine::ReadPcm(const uint32_t samples) {
-  FlexArray<int16_t> pcm(samples);
-  audio_input_device_->Read(pcm.data(), pcm.size());
-  if (resampler_) {
-    return resampler_->Resample(std::move(pcm));
-  } else {
-    return pcm;
-  }
-  // return resampler_ ? resampler_->Resample(std::move(pcm)) : pcm;
-}
-
-// FlexArray<int16_t> AudioInputEngine::Resample(FlexArray<int16_t> &&input_pcm) {
-//   if (silk_resampler_ == nullptr) {
-//     return input_pcm;
-//   }
-
-//   FlexArray<int16_t> resampled_pcm(input_pcm.size() * kDefaultSampleRate / audio_input_device_->input_sample_rate());
-//   const auto ret =
-//       silk_resampler(reinterpret_cast<silk_resampler_state_struct *>(silk_resampler_), resampled_pcm.data(), input_pcm.data(), input_pcm.size());
-//   if (ret != 0) {
-//     CLOGE("silk_resampler_process failed with: %d", ret);
-//     abort();
-//   }
-//   return resampled_pcm;
-// }
-
-void AudioInputEngine::PullData(const uint32_t samples) {
-  auto pcm = ReadPcm(samples);
-  FlexArray<uint8_t> data(kMaxOpusPacketSize);
-  const auto ret = opus_encode(opus_encoder_, pcm.data(), pcm.size(), data.data(), data.size());
-  if (ret > 0) {
-    data.Resize(ret);
-    handler_(std::move(data));
-  } else {
-    CLOGE("opus_encode failed with: %d", ret);
+  if (paused_) {
+    return;
+  }
+
+  paused_ = true;
+  ++run_;
+  subscriber_.Interrupt();
+  encode_task_queue_->Sync();
+  capture_hub_->Detach(&subscriber_);
+  subscriber_.Clear();
+  CLOGI("OK");
+}
+
+void AudioInputEngine::EncodeData(const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
+
+  // Pop() counts an underrun when capture starved the encoder for more than two frames.
+  const auto block = subscriber_.Pop(pdMS_TO_TICKS(frame_duration_ * 2));
+  if (block) {
+    for (size_t offset = 0; offset < block.size();) {
+      const auto count = std::min(block.size() - offset, pcm_frame_.size() - pcm_frame_fill_);
+      memcpy(pcm_frame_.data() + pcm_frame_fill_, block.data() + offset, count * sizeof(int16_t));
+      pcm_frame_fill_ += count;
+      offset += count;
+      if (pcm_frame_fill_ == pcm_frame_.size()) {
+        pcm_frame_fill_ = 0;
+        ProcessFrame(pcm_frame_.data(), pcm_frame_.size());
+      }
+    }
+  }
+
+  encode_task_queue_->Enqueue([this, run]() { EncodeData(run); });
+}
+
+void AudioInputEngine::EncodePreRoll(const FlexArray<int16_t> &pre_roll) {
+  // Runs ahead of live capture and faster than real time, the oldest samples are dropped to leave whole frames.
+  CLOGI("pre-roll: %zu samples", pre_roll.size());
+  for (size_t offset = pre_roll.size() % pcm_frame_.size(); offset < pre_roll.size(); offset += pcm_frame_.size()) {
+    ProcessFrame(pre_roll.data() + offset, pcm_frame_.size());
+  }
+}
+
+void AudioInputEngine::ProcessFrame(const int16_t *pcm, const uint32_t samples) {
+  if (!config_.silence_suppression || vad_.Process(pcm, samples)) {
+    if (has_lookback_frame_) {
+      // Also send the silent frame right before the onset, so soft word beginnings are not clipped.
+      Encode(lookback_frame_.data(), lookback_frame_.size());
+      has_lookback_frame_ = false;
+    }
+    silent_frames_ = 0;
+    Encode(pcm, samples);
+    return;
+  }
+
+  if (silent_frames_++ % keep_alive_frames_ == 0) {
+    has_lookback_frame_ = false;
+    Encode(pcm, samples);
+    return;
+  }
+
+  memcpy(lookback_frame_.data(), pcm, samples * sizeof(int16_t));
+  has_lookback_frame_ = true;
+  ++frames_suppressed_;
+}
+
+void AudioInputEngine::Encode(const int16_t *pcm, const uint32_t samples) {
+  ApplyBitrate();
+  const auto frame_samples = samples / frames_per_packet_;
+  uint32_t encode_time_us = 0;
+  size_t offset = 0;
+  for (uint32_t i = 0; i < frames_per_packet_; i++) {
+    auto *frame = opus_frames_.data() + offset;
+    // Not the cycle counter: that is per core and the task is not pinned to one.
+    const auto start_time = esp_timer_get_time();
+    const auto ret = opus_encode(opus_encoder_, pcm + i * frame_samples, frame_samples, frame, opus_frames_.size() - offset);
+    encode_time_us += static_cast<uint32_t>(esp_timer_get_time() - start_time);
+    if (ret <= 0) {
+      CLOGE("opus_encode failed with: %d", ret);
+      abort();
+    }
+
+    if (frames_per_packet_ == 1) {
+      SendPacket(frame, ret);
+      break;
+    }
+
+    if (i == 0) {
+      LockPacketMode(frame);
+    }
+
+    if (opus_repacketizer_cat(repacketizer_, frame, ret) != OPUS_OK) {
+      // Frames with different TOC bytes can't share a packet. Not expected with the mode and bandwidth locked, but a
+      // short packet is better than a lost frame.
+      CLOGW("frame %" PRIu32 " does not match the packet's TOC, splitting the packet", i);
+      ++split_packet_count_;
+      FlushPacket();
+      opus_repacketizer_cat(repacketizer_, frame, ret);
+    }
+    offset += ret;
+  }
+
+  if (frames_per_packet_ > 1) {
+    FlushPacket();
+    UnlockPacketMode();
+  }
+  ++frames_encoded_;
+  ApplyComplexity(complexity_controller_.Report(encode_time_us));
+}
+
+void AudioInputEngine::FlushPacket() {
+  if (opus_repacketizer_get_nb_frames(repacketizer_) == 0) {
+    return;
+  }
+
+  const auto ret = opus_repacketizer_out(repacketizer_, packet_buffer_.data(), packet_buffer_.size());
+  opus_repacketizer_init(repacketizer_);
+  if (ret <= 0) {
+    CLOGE("opus_repacketizer_out failed with: %d", ret);
     abort();
   }
+  SendPacket(packet_buffer_.data(), ret);
+}
 
-  task_queue_->Enqueue([this, samples]() { PullData(samples); });
-}
\ No newline at end of file
+void AudioInputEngine::SendPacket(const uint8_t *data, const size_t size) {
+  Packet packet(size);
+  std::memcpy(packet.data(), data, size);
+  handler_(std::move(packet));
+}
+
+// The encoder may pick another mode or bandwidth for any frame, which would leave the rest of the packet unable to share
+// its TOC byte. The first frame's choice is held for the rest of the packet instead.
+void AudioInputEngine::LockPacketMode(const uint8_t *first_frame) {
+  opus_encoder_ctl(opus_encoder_, kOpusSetForceModeRequest, ModeOf(first_frame[0]));
+  opus_encoder_ctl(opus_encoder_, OPUS_SET_BANDWIDTH(opus_packet_get_bandwidth(first_frame)));
+}
+
+void AudioInputEngine::UnlockPacketMode() {
+  opus_encoder_ctl(opus_encoder_, kOpusSetForceModeRequest, OPUS_AUTO);
+  opus_encoder_ctl(opus_encoder_, OPUS_SET_BANDWIDTH(bandwidth_));
+}
+
+void AudioInputEngine::ApplyBitrate() {
+  if (!bitrate_controller_ || bitrate_controller_->revision() == bitrate_revision_) {
+    return;
+  }
+
+  bitrate_revision_ = bitrate_controller_->revision();
+  opus_encoder_ctl(opus_encoder_, OPUS_SET_BITRATE(bitrate_controller_->bitrate()));
+  bandwidth_ = bitrate_controller_->bandwidth();
+  opus_encoder_ctl(opus_encoder_, OPUS_SET_BANDWIDTH(bandwidth_));
+  opus_encoder_ctl(opus_encoder_, OPUS_SET_PACKET_LOSS_PERC(bitrate_controller_->packet_loss_perc()));
+  CLOGI("bitrate: %" PRId32 " bps, bandwidth: %" PRId32 ", packet loss: %" PRId32 "%%",
+        bitrate_controller_->bitrate(),
+        bitrate_controller_->bandwidth(),
+        bitrate_controller_->packet_loss_perc());
+}
+
+void AudioInputEngine::ApplyComplexity(const int32_t complexity) {
+  if (complexity == complexity_) {
+    return;
+  }
+
+  complexity_ = complexity;
+  opus_encoder_ctl(opus_encoder_, OPUS_SET_COMPLEXITY(complexity));
+  CLOGI("complexity: %" PRId32, complexity);
+}
@@ -3,36 +3,119 @@
 #ifndef _AUDIO_INPUT_ENGINE_H_
 #define _AUDIO_INPUT_ENGINE_H_
 
+#include <atomic>
 #include <functional>
 #include <memory>
 
-#include "audio_device//audio_input_device.h"
+#include "audio_capture_hub.h"
 #include "components/task_queue/active_task_queue.h"
 #include "flex_array/flex_array.h"
+#include "flex_array/packet.h"
+#include "opus_bitrate_controller.h"
+#include "opus_complexity_controller.h"
+#include "voice_activity_detector.h"
 
 struct OpusDecoder;
-class SilkResampler;
+struct OpusRepacketizer;
 class AudioInputEngine {
  public:
-  using DataHandler = std::function<void(FlexArray<uint8_t> &&)>;
+  using DataHandler = std::function<void(Packet &&)>;
+  // Returns the audio captured before block |first_sequence|, the first one the engine receives from the capture hub.
+  using PreRollSource = std::function<FlexArray<int16_t>(const uint32_t first_sequence)>;
 
-  explicit AudioInputEngine(std::shared_ptr<ai_vox::AudioInputDevice> audio_input_device,
+  struct Config {
+    bool silence_suppression = true;     // skip encoding frames the voice activity detector classifies as silence
+    VoiceActivityDetector::Config vad;
+    uint32_t keep_alive_interval = 500;  // ms, a frame is still encoded this often during silence
+    OpusComplexityController::Config complexity;
+    // ms, frame_duration / opus_frame_duration frames are repacketized into each packet. 0 picks the longest Opus frame
+    // that divides frame_duration, so packets of up to 60 ms are a single frame and need no repacketizing.
+    uint32_t opus_frame_duration = 0;
+    uint32_t max_pre_roll = 0;           // ms, the longest pre-roll Resume() may be handed
+  };
+
+  explicit AudioInputEngine(std::shared_ptr<AudioCaptureHub> capture_hub,
                             AudioInputEngine::DataHandler &&handler,
-                            const uint32_t frame_duration);
+                            const uint32_t frame_duration,
+                            const Config &config,
+                            std::shared_ptr<OpusBitrateController> bitrate_controller);
   ~AudioInputEngine();
 
+  // The engine is created paused. Resume() subscribes to the capture hub and starts a new turn. If |pre_roll| is set, it
+  // is called once subscribed and what it returns is encoded ahead of live capture. Pause() stops encoding and
+  // unsubscribes but keeps the encoder and task stack allocated.
+  void Resume(PreRollSource &&pre_roll);
+  void Pause();
+
+  uint32_t frames_encoded() const {
+    return frames_encoded_;
+  }
+
+  uint32_t frames_suppressed() const {
+    return frames_suppressed_;
+  }
+
+  // Packets that had to be split because a frame came out with a different mode or bandwidth than the first one.
+  uint32_t split_packet_count() const {
+    return split_packet_count_;
+  }
+
+  std::array<uint32_t, OpusComplexityController::kHistogramBuckets> encode_time_histogram() const {
+    return complexity_controller_.histogram();
+  }
+
+  // In capture blocks.
+  uint32_t overrun_count() const {
+    return subscriber_.overrun_count();
+  }
+
+  uint32_t underrun_count() const {
+    return subscriber_.underrun_count();
+  }
+
  private:
   AudioInputEngine(const AudioInputEngine &) = delete;
   AudioInputEngine &operator=(const AudioInputEngine &) = delete;
 
-  FlexArray<int16_t> ReadPcm(const uint32_t samples);
-  void PullData(const uint32_t samples);
+  void EncodeData(const uint32_t run);
+  void EncodePreRoll(const FlexArray<int16_t> &pre_roll);
+  void ProcessFrame(const int16_t *pcm, const uint32_t samples);
+  void Encode(const int16_t *pcm, const uint32_t samples);
+  void FlushPacket();
+  void SendPacket(const uint8_t *data, const size_t size);
+  void LockPacketMode(const uint8_t *first_frame);
+  void UnlockPacketMode();
+  void ApplyBitrate();
+  void ApplyComplexity(const int32_t complexity);
 
   const DataHandler handler_;
-  std::shared_ptr<ai_vox::AudioInputDevice> audio_input_device_;
+  std::shared_ptr<AudioCaptureHub> capture_hub_;
+  const uint32_t frame_duration_ = 0;
+  const Config config_;
+  const uint32_t keep_alive_frames_ = 0;
+  const uint32_t frames_per_packet_ = 0;
   struct OpusEncoder *opus_encoder_ = nullptr;
-  std::unique_ptr<SilkResampler> resampler_;
-  ActiveTaskQueue *task_queue_ = nullptr;
+  OpusRepacketizer *repacketizer_ = nullptr;
+  FlexArray<uint8_t> opus_frames_;
+  FlexArray<uint8_t> packet_buffer_;  // repacketizer output, copied into a Packet of the right size
+  std::shared_ptr<OpusBitrateController> bitrate_controller_;
+  uint32_t bitrate_revision_ = 0;
+  int32_t bandwidth_ = 0;  // OPUS_AUTO, or what the bitrate controller asks for
+  OpusComplexityController complexity_controller_;
+  int32_t complexity_ = -1;
+  AudioCaptureHub::Subscriber subscriber_;
+  FlexArray<int16_t> pcm_frame_;
+  size_t pcm_frame_fill_ = 0;
+  VoiceActivityDetector vad_;
+  FlexArray<int16_t> lookback_frame_;
+  bool has_lookback_frame_ = false;
+  uint32_t silent_frames_ = 0;
+  std::atomic<uint32_t> frames_encoded_ = 0;
+  std::atomic<uint32_t> frames_suppressed_ = 0;
+  std::atomic<uint32_t> split_packet_count_ = 0;
+  bool paused_ = true;
+  std::atomic<uint32_t> run_ = 0;  // bumped on every Pause(), loops of an earlier run stop re-enqueuing themselves
+  ActiveTaskQueue *encode_task_queue_ = nullptr;
 };
 
 #endif
\ No newline at end of file
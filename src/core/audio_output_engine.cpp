@@ -1,8 +1,13 @@
 #include "audio_output_engine.h"
 
+#include <esp_timer.h>
+
+#include <algorithm>
+
 #include "flex_array/flex_array.h"
 #include "libopus/opus.h"
-#include "silk_resampler.h"
+#include "resampler.h"
+#include "time_stretcher.h"
 
 #ifndef CLOGGER_SEVERITY
 #define CLOGGER_SEVERITY CLOGGER_SEVERITY_WARN
@@ -14,56 +19,362 @@ constexpr uint32_t kDefaultSampleRate = 24000;
 constexpr uint32_t kDefaultChannels = 1;
 constexpr uint32_t kDefaultDurationMs = 20;  // Duration in milliseconds
 constexpr uint32_t kDefaultFrameSize = kDefaultSampleRate / 1000 * kDefaultChannels * kDefaultDurationMs;
+constexpr uint32_t kOpusSampleRates[] = {8000, 12000, 16000, 24000, 48000};
+constexpr uint32_t kWriteChunkDuration = 10;  // ms, how often playback checks for an abort
+constexpr uint32_t kFadeOutDuration = 5;      // ms
+constexpr uint32_t kPcmRingFrames = 2;        // decoded frames the playback stage can run ahead on
+constexpr uint32_t kDrainTimeout = 500;       // ms
+constexpr uint32_t kCatchUpMargin = 2;        // frames above the target depth before catching up starts
+
+template <typename T>
+void UpdateMax(std::atomic<T>& max, const T value) {
+  if (value > max.load(std::memory_order_relaxed)) {
+    max.store(value, std::memory_order_relaxed);
+  }
+}
 }  // namespace
 
-AudioOutputEngine::AudioOutputEngine(std::shared_ptr<ai_vox::AudioOutputDevice> audio_output_device, const uint32_t frame_duration)
-    : audio_output_device_(std::move(audio_output_device)), samples_(kDefaultSampleRate / 1000 * kDefaultChannels * frame_duration) {
+AudioOutputEngine::AudioOutputEngine(std::shared_ptr<ai_vox::AudioOutputDevice> audio_output_device,
+                                     const uint32_t frame_duration,
+                                     const Config& config)
+    : audio_output_device_(std::move(audio_output_device)),
+      frame_duration_(frame_duration),
+      catch_up_speed_(std::clamp(config.catch_up_speed, TimeStretcher::kMinSpeed, TimeStretcher::kMaxSpeed)),
+      decoder_sample_rate_(kDefaultSampleRate),
+      samples_(kDefaultSampleRate / 1000 * kDefaultChannels * frame_duration),
+      jitter_buffer_(config.jitter_buffer),
+      data_sem_(xSemaphoreCreateBinary()),
+      chunk_(0, MemoryPlacement::kInternal) {
   CLOGI();
+  assert(data_sem_ != nullptr);
   int error = -1;
   opus_decoder_ = opus_decoder_create(kDefaultSampleRate, kDefaultChannels, &error);
   assert(opus_decoder_ != nullptr);
-  audio_output_device_->OpenOutput(kDefaultSampleRate);
-
-  if (audio_output_device_->output_sample_rate() != kDefaultSampleRate) {
-    CLOGD("init resampler for %" PRIu32 " -> %" PRIu32, kDefaultSampleRate, audio_output_device_->output_sample_rate());
-    resampler_ = std::make_unique<SilkResampler>(kDefaultSampleRate, audio_output_device_->output_sample_rate());
-  }
 
   uint32_t stack_size = 9 << 10;
-  task_queue_ = new ActiveTaskQueue("AudioOutput", stack_size, tskIDLE_PRIORITY + 1);
+  decode_task_queue_ = new ActiveTaskQueue("AudioDecode", stack_size, tskIDLE_PRIORITY + 1, false, config.decode_core);
+  playback_task_queue_ = new ActiveTaskQueue("AudioOutput", 4 << 10, tskIDLE_PRIORITY + 2, false, config.playback_core);
   CLOGI("OK");
 }
 
 AudioOutputEngine::~AudioOutputEngine() {
   CLOGI();
-  delete task_queue_;
-  audio_output_device_->CloseOutput();
+  Pause();
+  delete decode_task_queue_;
+  delete playback_task_queue_;
   opus_decoder_destroy(opus_decoder_);
+  if (pcm_ring_ != nullptr) {
+    vStreamBufferDelete(pcm_ring_);
+  }
+  vSemaphoreDelete(data_sem_);
+  CLOGI("OK");
+}
+
+void AudioOutputEngine::Resume() {
+  CLOGI();
+  if (!paused_) {
+    return;
+  }
+
+  audio_output_device_->OpenOutput(kDefaultSampleRate);
+  const auto device_sample_rate = audio_output_device_->output_sample_rate();
+  // Opus decodes natively to any of its rates, the resampler is only needed for the others.
+  const bool native = std::find(std::begin(kOpusSampleRates), std::end(kOpusSampleRates), device_sample_rate) != std::end(kOpusSampleRates);
+  const auto decoder_sample_rate = native ? device_sample_rate : kDefaultSampleRate;
+  if (decoder_sample_rate != decoder_sample_rate_) {
+    CLOGD("decode at %" PRIu32 " Hz", decoder_sample_rate);
+    const auto ret = opus_decoder_init(opus_decoder_, decoder_sample_rate, kDefaultChannels);
+    if (ret != OPUS_OK) {
+      CLOGE("opus_decoder_init failed: %d", ret);
+      abort();
+    }
+    decoder_sample_rate_ = decoder_sample_rate;
+    samples_ = decoder_sample_rate / 1000 * kDefaultChannels * frame_duration_;
+  }
+
+  if (native) {
+    resampler_.reset();
+  } else if (!resampler_ || resampler_->output_sample_rate() != device_sample_rate) {
+    CLOGD("init resampler for %" PRIu32 " -> %" PRIu32, kDefaultSampleRate, device_sample_rate);
+    resampler_ = Resampler::Create(kDefaultSampleRate, device_sample_rate);
+  }
+
+  const size_t pcm_ring_bytes = device_sample_rate / 1000 * frame_duration_ * kPcmRingFrames * sizeof(int16_t);
+  if (pcm_ring_bytes != pcm_ring_bytes_) {
+    if (pcm_ring_ != nullptr) {
+      vStreamBufferDelete(pcm_ring_);
+    }
+    pcm_ring_ = xStreamBufferCreate(pcm_ring_bytes, device_sample_rate / 1000 * kWriteChunkDuration * sizeof(int16_t));
+    assert(pcm_ring_ != nullptr);
+    pcm_ring_bytes_ = pcm_ring_bytes;
+    chunk_.Resize(device_sample_rate / 1000 * kWriteChunkDuration);
+  }
+
+  if (!time_stretcher_ || time_stretcher_->sample_rate() != device_sample_rate) {
+    time_stretcher_ = std::make_unique<TimeStretcher>(device_sample_rate);
+  }
+
+  // Nothing is decoding while paused, the previous turn's state must not leak into this one.
+  opus_decoder_ctl(opus_decoder_, OPUS_RESET_STATE);
+  if (resampler_) {
+    resampler_->Reset();
+  }
+  jitter_buffer_.Clear();
+  xStreamBufferReset(pcm_ring_);
+  time_stretcher_->Reset();
+  catching_up_ = false;
+  end_pending_ = false;
+  playing_ = false;
+  abort_requested_ = false;
+  decode_aborted_ = false;
+  decoder_flushed_ = false;
+  flushing_ = false;
+  discarding_ = false;
+  last_sample_ = 0;
+  paused_ = false;
+  const auto run = run_.load();
+  decode_task_queue_->Enqueue([this, run]() { Decode(run); });
+  playback_task_queue_->Enqueue([this, run]() { Playback(run); });
   CLOGI("OK");
 }
 
-void AudioOutputEngine::Write(FlexArray<uint8_t>&& data) {
-  task_queue_->Enqueue([this, data = std::move(data)]() mutable { ProcessData(std::move(data)); });
+void AudioOutputEngine::Pause() {
+  CLOGI();
+  if (paused_) {
+    return;
+  }
+
+  paused_ = true;
+  ++run_;
+  xSemaphoreGive(data_sem_);
+  decode_task_queue_->Sync();
+  playback_task_queue_->Sync();
+  jitter_buffer_.Clear();
+  {
+    std::lock_guard lock(mutex_);
+    data_end_callback_ = nullptr;
+  }
+  audio_output_device_->CloseOutput();
+  CLOGI("underruns: %" PRIu32 ", late: %" PRIu32 ", dropped: %" PRIu32 ", concealed: %" PRIu32 ", target depth: %" PRIu32
+        " ms, discarded after abort: %" PRIu32,
+        jitter_buffer_.underrun_count(),
+        jitter_buffer_.late_count(),
+        jitter_buffer_.dropped_count(),
+        jitter_buffer_.concealed_count(),
+        jitter_buffer_.target_depth(),
+        discarded_count_.load());
+  CLOGI("decode avg: %" PRIu32 " us, max: %" PRIu32 " us per %" PRIu32 " ms frame, write max: %" PRIu32 " us, starved: %" PRIu32
+        ", caught up: %" PRIu32 " frames",
+        decode_time_avg_us(),
+        decode_time_max_us(),
+        frame_duration_,
+        write_time_max_us(),
+        starved_count(),
+        catch_up_count());
+}
+
+void AudioOutputEngine::Write(Packet&& data) {
+  if (paused_) {
+    return;
+  }
+
+  if (discarding_) {
+    ++discarded_count_;
+    return;
+  }
+
+  jitter_buffer_.Push(std::move(data), esp_timer_get_time());
+  xSemaphoreGive(data_sem_);
+}
+
+void AudioOutputEngine::WriteLocal(Packet&& data) {
+  if (paused_) {
+    return;
+  }
+
+  if (discarding_) {
+    ++discarded_count_;
+    return;
+  }
+
+  jitter_buffer_.PushLocal(std::move(data));
+  xSemaphoreGive(data_sem_);
 }
 
 void AudioOutputEngine::NotifyDataEnd(std::function<void()>&& callback) {
-  task_queue_->Enqueue(std::move(callback));
+  {
+    std::lock_guard lock(mutex_);
+    data_end_callback_ = std::move(callback);
+  }
+  jitter_buffer_.MarkEnd();
+  xSemaphoreGive(data_sem_);
 }
 
-void AudioOutputEngine::ProcessData(FlexArray<uint8_t>&& data) {
-  auto pcm = FlexArray<int16_t>(samples_);
+void AudioOutputEngine::set_speed(const uint32_t speed) {
+  speed_ = std::clamp(speed, TimeStretcher::kMinSpeed, TimeStretcher::kMaxSpeed);
+}
 
-  const auto ret = opus_decode(opus_decoder_, data.data(), data.size(), pcm.data(), pcm.size(), 0);
-  if (ret >= 0) {
-    WritePcm(std::move(pcm));
+void AudioOutputEngine::Abort() {
+  if (paused_ || discarding_) {
+    return;
   }
+
+  CLOGI();
+  abort_time_us_ = esp_timer_get_time();
+  discarding_ = true;
+  decode_aborted_ = true;
+  abort_requested_ = true;
+  xSemaphoreGive(data_sem_);
 }
 
-void AudioOutputEngine::WritePcm(FlexArray<int16_t>&& pcm) {
-  if (resampler_) {
-    auto resampled_pcm = resampler_->Resample(std::move(pcm));
-    audio_output_device_->Write(resampled_pcm.data(), resampled_pcm.size());
-  } else {
-    audio_output_device_->Write(pcm.data(), pcm.size());
+void AudioOutputEngine::Decode(const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
+
+  if (decode_aborted_.exchange(false)) {
+    jitter_buffer_.Flush();
+    opus_decoder_ctl(opus_decoder_, OPUS_RESET_STATE);
+    time_stretcher_->Reset();
+    catching_up_ = false;
+    decoder_flushed_ = true;
+  }
+
+  std::optional<Packet> packet;
+  const auto action = jitter_buffer_.Pop(&packet);
+  switch (action) {
+    case JitterBuffer::Action::kPlay:
+    case JitterBuffer::Action::kConceal: {
+      const auto start_time = esp_timer_get_time();
+      auto pcm = FlexArray<int16_t>(samples_);
+      // A null packet makes the decoder conceal the missing frame.
+      const auto ret = action == JitterBuffer::Action::kPlay
+                           ? opus_decode(opus_decoder_, packet->data(), packet->size(), pcm.data(), pcm.size(), 0)
+                           : opus_decode(opus_decoder_, nullptr, 0, pcm.data(), pcm.size(), 0);
+      if (ret <= 0) {
+        break;
+      }
+
+      pcm.Resize(ret);
+      auto resampled_pcm = resampler_ ? resampler_->Resample(std::move(pcm)) : std::move(pcm);
+      // Catch up with hysteresis: from a couple of frames above the target depth until back down to it.
+      const auto depth = jitter_buffer_.depth();
+      const auto target_depth = jitter_buffer_.target_depth();
+      if (catch_up_speed_ != 100) {
+        catching_up_ = catching_up_ ? depth > target_depth : depth > target_depth + frame_duration_ * kCatchUpMargin;
+      }
+      if (catching_up_) {
+        ++catch_up_count_;
+      }
+      const auto speed = catching_up_ ? speed_ * catch_up_speed_ / 100 : speed_.load();
+      auto output_pcm = time_stretcher_->Process(std::move(resampled_pcm), speed);
+      const auto decode_time = static_cast<uint32_t>(esp_timer_get_time() - start_time);
+      ++decoded_frames_;
+      decode_time_total_us_ += decode_time;
+      UpdateMax(decode_time_max_us_, decode_time);
+      SendPcm(std::move(output_pcm), run);
+      break;
+    }
+    case JitterBuffer::Action::kWait: {
+      xSemaphoreTake(data_sem_, pdMS_TO_TICKS(frame_duration_));
+      break;
+    }
+    case JitterBuffer::Action::kDrained: {
+      SendPcm(time_stretcher_->Flush(), run);
+      end_pending_ = true;
+      break;
+    }
   }
-}
\ No newline at end of file
+
+  decode_task_queue_->Enqueue([this, run]() { Decode(run); });
+}
+
+// Blocks while the ring is full, i.e. while the playback stage is a full ring ahead.
+void AudioOutputEngine::SendPcm(FlexArray<int16_t>&& pcm, const uint32_t run) {
+  const auto data = reinterpret_cast<const uint8_t*>(pcm.data());
+  const size_t bytes = pcm.size() * sizeof(int16_t);
+  size_t sent = 0;
+  while (sent < bytes && run == run_ && !decode_aborted_) {
+    sent += xStreamBufferSend(pcm_ring_, data + sent, bytes - sent, pdMS_TO_TICKS(frame_duration_));
+  }
+}
+
+void AudioOutputEngine::Playback(const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
+
+  const size_t chunk_bytes = chunk_.size() * sizeof(int16_t);
+  if (abort_requested_.exchange(false)) {
+    FadeOut();
+    flushing_ = true;
+    // Silence is only reached once the device has clocked out the fade-out and whatever its DMA buffers held before.
+    if (!audio_output_device_->WaitForDrained(kDrainTimeout)) {
+      CLOGD("the device did not report the drain");
+    }
+    last_abort_latency_us_ = esp_timer_get_time() - abort_time_us_;
+    CLOGI("abort to silence: %" PRId64 " us, frame duration: %" PRIu32 " ms", last_abort_latency_us_.load(), frame_duration_);
+  }
+
+  if (flushing_) {
+    // PCM of the aborted turn keeps coming until the decode stage has seen the abort.
+    const bool decoder_flushed = decoder_flushed_;
+    if (xStreamBufferReceive(pcm_ring_, chunk_.data(), chunk_bytes, decoder_flushed ? 0 : pdMS_TO_TICKS(kWriteChunkDuration)) == 0 &&
+        decoder_flushed) {
+      decoder_flushed_ = false;
+      flushing_ = false;
+      playing_ = false;
+    }
+    playback_task_queue_->Enqueue([this, run]() { Playback(run); });
+    return;
+  }
+
+  const auto received = xStreamBufferReceive(pcm_ring_, chunk_.data(), chunk_bytes, pdMS_TO_TICKS(kWriteChunkDuration));
+  if (received > 0) {
+    const auto samples = received / sizeof(int16_t);
+    const auto start_time = esp_timer_get_time();
+    audio_output_device_->Write(chunk_.data(), samples);
+    UpdateMax(write_time_max_us_, static_cast<uint32_t>(esp_timer_get_time() - start_time));
+    last_sample_ = chunk_.data()[samples - 1];
+    playing_ = true;
+  } else if (end_pending_) {
+    // The decode stage sets the flag after its last send, an empty ring now means the turn has been handed to the device.
+    // Only report the end once the device has clocked it out too, or the microphone would pick up the tail.
+    end_pending_ = false;
+    playing_ = false;
+    const auto drain_start_time = esp_timer_get_time();
+    if (!audio_output_device_->WaitForDrained(kDrainTimeout)) {
+      CLOGD("the device did not report the drain");
+    }
+    last_drain_wait_us_ = esp_timer_get_time() - drain_start_time;
+    CLOGI("drained after %" PRId64 " us", last_drain_wait_us_.load());
+    std::function<void()> callback;
+    {
+      std::lock_guard lock(mutex_);
+      callback = std::move(data_end_callback_);
+      data_end_callback_ = nullptr;
+    }
+    if (callback) {
+      callback();
+    }
+  } else if (playing_) {
+    ++starved_count_;
+  }
+
+  playback_task_queue_->Enqueue([this, run]() { Playback(run); });
+}
+
+// Ramps the audio that would have played next down to silence, or holds the last sample if none is ready, so the cut
+// does not click.
+void AudioOutputEngine::FadeOut() {
+  const size_t fade_samples = std::min<size_t>(audio_output_device_->output_sample_rate() / 1000 * kFadeOutDuration, chunk_.size());
+  const size_t samples = xStreamBufferReceive(pcm_ring_, chunk_.data(), fade_samples * sizeof(int16_t), 0) / sizeof(int16_t);
+  auto pcm = chunk_.data();
+  const int16_t hold = samples > 0 ? pcm[samples - 1] : last_sample_;
+  for (size_t i = 0; i < fade_samples; i++) {
+    const int32_t value = i < samples ? pcm[i] : hold;
+    pcm[i] = static_cast<int16_t>(value * static_cast<int32_t>(fade_samples - i) / static_cast<int32_t>(fade_samples));
+  }
+  audio_output_device_->Write(pcm, fade_samples);
+  last_sample_ = 0;
+}
@@ -1,34 +1,157 @@
 #pragma once
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 
 #include "audio_device/audio_output_device.h"
 #include "components/task_queue/active_task_queue.h"
 #include "flex_array/flex_array.h"
+#include "flex_array/packet.h"
+#include "jitter_buffer.h"
 
 class OpusDecoder;
-class SilkResampler;
+class Resampler;
+class TimeStretcher;
+
+/**
+ * Two-stage downlink: the decode stage takes packets from the jitter buffer, decodes and resamples them into a short
+ * ring of PCM at the device rate, and the playback stage keeps the device fed from that ring in small chunks. The
+ * playback stage runs at a higher priority and never waits on decoding while PCM is ready.
+ *
+ * The decode stage can also change the speech speed without changing its pitch, either at a fixed speed or briefly to
+ * catch up while the jitter buffer holds more than its target, e.g. after a network burst.
+ */
 class AudioOutputEngine {
  public:
-  explicit AudioOutputEngine(std::shared_ptr<ai_vox::AudioOutputDevice> audio_output_device, const uint32_t frame_duration);
+  struct Config {
+    JitterBuffer::Config jitter_buffer;
+    BaseType_t decode_core = tskNO_AFFINITY;
+    BaseType_t playback_core = tskNO_AFFINITY;
+    uint32_t catch_up_speed = 100;  // percent of the set speed while the jitter buffer is ahead of its target, 100 disables
+  };
+
+  explicit AudioOutputEngine(std::shared_ptr<ai_vox::AudioOutputDevice> audio_output_device, const uint32_t frame_duration, const Config& config);
   ~AudioOutputEngine();
 
-  void Write(FlexArray<uint8_t>&& data);
+  // The engine is created paused. Resume() opens the device for a new turn; Pause() drops whatever is still buffered,
+  // then closes the device but keeps the decoder and task stacks allocated. Data written while paused is dropped.
+  void Resume();
+  void Pause();
+
+  // Packets go through the jitter buffer, a late packet is concealed with Opus PLC instead of leaving a gap.
+  void Write(Packet&& data);
+  // For packets that are already on the device, e.g. replayed from the TTS cache. They play in order with the others but
+  // do not count as the network running ahead, so a replayed sentence plays at its normal speed.
+  void WriteLocal(Packet&& data);
+  // |callback| runs on the playback task once everything written before it has left the device, as far as the device
+  // can tell.
   void NotifyDataEnd(std::function<void()>&& callback);
 
+  // Local barge-in. Fades out within the frame being played, drops everything buffered and every packet written until
+  // the next Resume(). A pending or later NotifyDataEnd() still runs its callback.
+  void Abort();
+
+  // Speech speed in percent, from TimeStretcher::kMinSpeed to kMaxSpeed. Takes effect with the next frame.
+  void set_speed(const uint32_t speed);
+
+  uint32_t speed() const {
+    return speed_;
+  }
+
+  // Frames played faster to catch up with the jitter buffer.
+  uint32_t catch_up_count() const {
+    return catch_up_count_;
+  }
+
+  // Time from Abort() until the device has clocked out the fade-out, DMA buffers included. For devices that cannot
+  // report the drain, until the fade-out has been handed to them.
+  int64_t last_abort_latency_us() const {
+    return last_abort_latency_us_;
+  }
+
+  // Time the last turn end waited for the device to clock out its buffered audio.
+  int64_t last_drain_wait_us() const {
+    return last_drain_wait_us_;
+  }
+
+  const JitterBuffer& jitter_buffer() const {
+    return jitter_buffer_;
+  }
+
+  // Decode stage, per frame including resampling. The headroom is the frame duration minus this.
+  uint32_t decode_time_avg_us() const {
+    const auto frames = decoded_frames_.load();
+    return frames == 0 ? 0 : static_cast<uint32_t>(decode_time_total_us_.load() / frames);
+  }
+
+  uint32_t decode_time_max_us() const {
+    return decode_time_max_us_;
+  }
+
+  // Playback stage, per chunk. Most of it is spent waiting for room in the DMA buffers.
+  uint32_t write_time_max_us() const {
+    return write_time_max_us_;
+  }
+
+  // Times the playback stage found no decoded PCM while a turn was playing.
+  uint32_t starved_count() const {
+    return starved_count_;
+  }
+
  private:
   AudioOutputEngine(const AudioOutputEngine&) = delete;
   AudioOutputEngine& operator=(const AudioOutputEngine&) = delete;
 
   static void Loop(void* self);
   void Loop();
-  void ProcessData(FlexArray<uint8_t>&& data);
-  void WritePcm(FlexArray<int16_t>&& pcm);
+  void Decode(const uint32_t run);
+  void Playback(const uint32_t run);
+  void SendPcm(FlexArray<int16_t>&& pcm, const uint32_t run);
+  void FadeOut();
 
   std::shared_ptr<ai_vox::AudioOutputDevice> audio_output_device_;
   struct OpusDecoder* opus_decoder_ = nullptr;
-  std::unique_ptr<SilkResampler> resampler_;
-  ActiveTaskQueue* task_queue_ = nullptr;
-  const uint32_t samples_ = 0;
+  std::unique_ptr<Resampler> resampler_;
+  std::unique_ptr<TimeStretcher> time_stretcher_;
+  ActiveTaskQueue* decode_task_queue_ = nullptr;
+  ActiveTaskQueue* playback_task_queue_ = nullptr;
+  const uint32_t frame_duration_ = 0;
+  const uint32_t catch_up_speed_ = 100;
+  std::atomic<uint32_t> speed_ = 100;
+  bool catching_up_ = false;  // decode stage
+  uint32_t decoder_sample_rate_ = 0;
+  uint32_t samples_ = 0;  // per frame at the decoder rate
+  std::atomic<bool> paused_ = true;
+  std::atomic<uint32_t> run_ = 0;
+  JitterBuffer jitter_buffer_;
+  SemaphoreHandle_t data_sem_ = nullptr;
+  std::mutex mutex_;
+  std::function<void()> data_end_callback_;
+  StreamBufferHandle_t pcm_ring_ = nullptr;  // decoded PCM at the device rate, from the decode to the playback stage
+  size_t pcm_ring_bytes_ = 0;
+  FlexArray<int16_t> chunk_;
+  std::atomic<bool> end_pending_ = false;  // the decode stage reached the data end, the ring holds the rest of the turn
+  bool playing_ = false;
+  std::atomic<bool> abort_requested_ = false;  // for the playback stage
+  std::atomic<bool> decode_aborted_ = false;   // for the decode stage
+  std::atomic<bool> decoder_flushed_ = false;  // the decode stage has let go of the aborted turn
+  bool flushing_ = false;                      // the playback stage drops PCM of the aborted turn
+  std::atomic<bool> discarding_ = false;       // the turn was aborted, late packets are dropped
+  std::atomic<int64_t> abort_time_us_ = 0;
+  std::atomic<int64_t> last_abort_latency_us_ = 0;
+  std::atomic<int64_t> last_drain_wait_us_ = 0;
+  std::atomic<uint32_t> discarded_count_ = 0;
+  int16_t last_sample_ = 0;
+  std::atomic<uint32_t> decoded_frames_ = 0;
+  std::atomic<uint64_t> decode_time_total_us_ = 0;
+  std::atomic<uint32_t> decode_time_max_us_ = 0;
+  std::atomic<uint32_t> write_time_max_us_ = 0;
+  std::atomic<uint32_t> starved_count_ = 0;
+  std::atomic<uint32_t> catch_up_count_ = 0;
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "flex_array.h"
+
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+
+namespace {
+constexpr size_t kMinAlignment = 4;
+
+uint32_t CapsOf(const MemoryPlacement placement) {
+  switch (placement) {
+    case MemoryPlacement::kSpiram:
+      return MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    case MemoryPlacement::kDma:
+      return MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    default:
+      return MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+  }
+}
+}  // namespace
+
+void *FlexArrayAllocate(const size_t bytes, const MemoryPlacement placement, const size_t alignment, size_t *capacity) noexcept {
+  if (placement == MemoryPlacement::kPool) {
+    return BufferPool::GetInstance().Allocate(bytes, capacity);
+  }
+
+  // heap_caps_aligned_alloc() wants a power of two and returns nothing for zero bytes.
+  const size_t align = std::max(alignment, kMinAlignment);
+  const size_t size = std::max((bytes + align - 1) / align * align, align);
+  auto buffer = heap_caps_aligned_alloc(align, size, CapsOf(placement));
+  if (buffer == nullptr && placement == MemoryPlacement::kSpiram) {
+    buffer = heap_caps_aligned_alloc(align, size, CapsOf(MemoryPlacement::kInternal));
+  }
+  if (capacity != nullptr) {
+    *capacity = buffer != nullptr ? size : 0;
+  }
+  return buffer;
+}
+
+void FlexArrayFree(void *buffer, const MemoryPlacement placement) noexcept {
+  if (placement == MemoryPlacement::kPool) {
+    BufferPool::GetInstance().Free(buffer);
+  } else {
+    heap_caps_free(buffer);
+  }
+}
@@ -5,29 +5,63 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <type_traits>
 #include <utility>
 
+#include "components/buffer_pool/buffer_pool.h"
+
+// Where the elements of a FlexArray live. The pool suits the per-frame buffers that come and go, the others are for
+// long-lived buffers that have to be in a particular kind of memory.
+enum class MemoryPlacement : uint8_t {
+  kPool,      // BufferPool, from the default heap
+  kInternal,  // internal RAM, never PSRAM, for buffers touched every few ms
+  kSpiram,    // PSRAM when available, internal RAM otherwise, for large buffers touched rarely
+  kDma,       // internal RAM the DMA engines can reach, for buffers handed to I2S and SPI
+};
+
+// Heap side of FlexArray. |alignment| applies to everything but the pool, 0 means the allocator's default.
+void *FlexArrayAllocate(const size_t bytes, const MemoryPlacement placement, const size_t alignment, size_t *capacity) noexcept;
+void FlexArrayFree(void *buffer, const MemoryPlacement placement) noexcept;
+
 template <typename T>
 class FlexArray {
   static_assert(std::is_trivial_v<T>, "FlexArray supports only trivial types");
 
  public:
-  explicit FlexArray(const size_t size) noexcept : size_(size), buffer_(reinterpret_cast<T*>(std::malloc(size * sizeof(T)))) {
+  explicit FlexArray(const size_t size, const MemoryPlacement placement = MemoryPlacement::kPool, const size_t alignment = 0) noexcept
+      : size_(size), placement_(placement), alignment_(alignment) {
+    size_t capacity = 0;
+    buffer_ = reinterpret_cast<T*>(FlexArrayAllocate(size * sizeof(T), placement_, alignment_, &capacity));
+    capacity_ = capacity / sizeof(T);
   }
 
-  FlexArray(FlexArray&& other) noexcept : size_(other.size_), buffer_(other.buffer_) {
+  FlexArray(FlexArray&& other) noexcept
+      : size_(other.size_), capacity_(other.capacity_), buffer_(other.buffer_), placement_(other.placement_), alignment_(other.alignment_) {
     other.buffer_ = nullptr;
     other.size_ = 0;
+    other.capacity_ = 0;
   }
 
   ~FlexArray() {
     if (buffer_ != nullptr) {
-      std::free(buffer_);
+      FlexArrayFree(buffer_, placement_);
     }
   }
 
+  // Shrinking, or growing within the allocated block, never moves the data. Growing beyond it moves the data into a
+  // new block with the same placement.
   void Resize(const size_t size) noexcept {
-    buffer_ = reinterpret_cast<T*>(std::realloc(buffer_, size * sizeof(T)));
+    if (size > capacity_) {
+      size_t capacity = 0;
+      auto buffer = reinterpret_cast<T*>(FlexArrayAllocate(size * sizeof(T), placement_, alignment_, &capacity));
+      if (buffer_ != nullptr) {
+        std::memcpy(buffer, buffer_, size_ * sizeof(T));
+        FlexArrayFree(buffer_, placement_);
+      }
+      buffer_ = buffer;
+      capacity_ = capacity / sizeof(T);
+    }
     size_ = size;
   }
 
@@ -35,16 +69,27 @@ class FlexArray {
     return size_;
   }
 
+  size_t capacity() const noexcept {
+    return capacity_;
+  }
+
   T* data() const noexcept {
     return buffer_;
   }
 
+  MemoryPlacement placement() const noexcept {
+    return placement_;
+  }
+
  private:
   FlexArray(const FlexArray&) = delete;
   FlexArray& operator=(const FlexArray&) = delete;
 
   size_t size_ = 0;
+  size_t capacity_ = 0;
   T* buffer_ = nullptr;
+  MemoryPlacement placement_ = MemoryPlacement::kPool;
+  size_t alignment_ = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
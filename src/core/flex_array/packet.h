@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef _PACKET_H_
+#define _PACKET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "components/buffer_pool/buffer_pool.h"
+
+/**
+ * Move-only byte buffer for Opus packets, with the interface of FlexArray<uint8_t>. Payloads up to kInlineCapacity
+ * bytes, which covers nearly every voice packet, are stored inside the object, so creating one and moving it through
+ * the task queues costs no allocation of its own. Larger payloads fall back to BufferPool.
+ */
+class Packet {
+ public:
+  static constexpr size_t kInlineCapacity = 192;  // bytes, 60 ms of Opus at up to 25 kbit/s
+
+  explicit Packet(const size_t size) noexcept : size_(size) {
+    if (size > kInlineCapacity) {
+      heap_ = static_cast<uint8_t*>(BufferPool::GetInstance().Allocate(size, &capacity_));
+    }
+  }
+
+  Packet(Packet&& other) noexcept : size_(other.size_), capacity_(other.capacity_), heap_(other.heap_) {
+    if (heap_ == nullptr) {
+      std::memcpy(inline_, other.inline_, size_);
+    }
+    other.heap_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = kInlineCapacity;
+  }
+
+  ~Packet() {
+    if (heap_ != nullptr) {
+      BufferPool::GetInstance().Free(heap_);
+    }
+  }
+
+  // Shrinking, or growing within the capacity, never moves the data.
+  void Resize(const size_t size) noexcept {
+    if (size > capacity_) {
+      size_t capacity = 0;
+      auto buffer = static_cast<uint8_t*>(BufferPool::GetInstance().Allocate(size, &capacity));
+      std::memcpy(buffer, data(), size_);
+      if (heap_ != nullptr) {
+        BufferPool::GetInstance().Free(heap_);
+      }
+      heap_ = buffer;
+      capacity_ = capacity;
+    }
+    size_ = size;
+  }
+
+  size_t size() const noexcept {
+    return size_;
+  }
+
+  size_t capacity() const noexcept {
+    return capacity_;
+  }
+
+  uint8_t* data() noexcept {
+    return heap_ != nullptr ? heap_ : inline_;
+  }
+
+  const uint8_t* data() const noexcept {
+    return heap_ != nullptr ? heap_ : inline_;
+  }
+
+ private:
+  Packet(const Packet&) = delete;
+  Packet& operator=(const Packet&) = delete;
+
+  size_t size_ = 0;
+  size_t capacity_ = kInlineCapacity;
+  uint8_t* heap_ = nullptr;  // null while the payload is inline
+  uint8_t inline_[kInlineCapacity];
+};
+
+#endif
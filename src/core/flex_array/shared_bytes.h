@@ -0,0 +1,111 @@
+#pragma once
+
+#ifndef _SHARED_BYTES_H_
+#define _SHARED_BYTES_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <utility>
+
+#include "components/buffer_pool/buffer_pool.h"
+
+/**
+ * Immutable, reference-counted bytes. Copying a SharedBytes or taking a Slice() of it shares the one block, so a
+ * received frame can be handed to several consumers on several tasks without copying it again. The block, count
+ * included, is a single allocation from BufferPool and goes back there with the last reference.
+ */
+class SharedBytes {
+ public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  SharedBytes() noexcept = default;
+
+  // The only copy: |size| bytes into a new block.
+  static SharedBytes Copy(const void* data, const size_t size) noexcept {
+    auto block = static_cast<Block*>(BufferPool::GetInstance().Allocate(sizeof(Block) + size));
+    if (block == nullptr) {
+      return SharedBytes();
+    }
+    new (block) Block();
+    auto bytes = reinterpret_cast<uint8_t*>(block + 1);
+    std::memcpy(bytes, data, size);
+    return SharedBytes(block, bytes, size);
+  }
+
+  SharedBytes(const SharedBytes& other) noexcept : block_(other.block_), data_(other.data_), size_(other.size_) {
+    if (block_ != nullptr) {
+      block_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  SharedBytes(SharedBytes&& other) noexcept : block_(other.block_), data_(other.data_), size_(other.size_) {
+    other.block_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+
+  SharedBytes& operator=(SharedBytes other) noexcept {
+    std::swap(block_, other.block_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  ~SharedBytes() {
+    if (block_ != nullptr && block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      block_->~Block();
+      BufferPool::GetInstance().Free(block_);
+    }
+  }
+
+  // |size| bytes from |offset| of this slice, sharing the block. Both are clamped to this slice.
+  SharedBytes Slice(size_t offset, size_t size = npos) const noexcept {
+    offset = std::min(offset, size_);
+    size = std::min(size, size_ - offset);
+    if (block_ != nullptr) {
+      block_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return SharedBytes(block_, data_ + offset, size);
+  }
+
+  const uint8_t* data() const noexcept {
+    return data_;
+  }
+
+  size_t size() const noexcept {
+    return size_;
+  }
+
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  std::string_view view() const noexcept {
+    return std::string_view(reinterpret_cast<const char*>(data_), size_);
+  }
+
+  // References to the block, for diagnostics.
+  uint32_t use_count() const noexcept {
+    return block_ != nullptr ? block_->refs.load(std::memory_order_relaxed) : 0;
+  }
+
+ private:
+  struct alignas(alignof(std::max_align_t)) Block {
+    std::atomic<uint32_t> refs = 1;
+  };
+
+  // Adopts a reference the caller already holds.
+  SharedBytes(Block* block, const uint8_t* data, const size_t size) noexcept : block_(block), data_(data), size_(size) {
+  }
+
+  Block* block_ = nullptr;
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif
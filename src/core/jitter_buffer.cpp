@@ -0,0 +1,136 @@
+#include "jitter_buffer.h"
+
+#include <algorithm>
+
+namespace {
+constexpr int64_t kJitterGain = 16;  // RFC 3550 style smoothing
+}  // namespace
+
+JitterBuffer::JitterBuffer(const Config &config) : config_(config), target_depth_(config.start_threshold) {
+}
+
+void JitterBuffer::Push(Packet &&packet, const int64_t arrival_us) {
+  std::lock_guard lock(mutex_);
+  UpdateJitter(arrival_us);
+  if (late_frames_ > 0) {
+    // Its frame has already been concealed. Playing it as well would add a frame of latency for good, so it is dropped
+    // rather than queued. The decoder gets over the concealment within a frame or two of the next packet anyway.
+    --late_frames_;
+    ++late_count_;
+    return;
+  }
+  Append(std::move(packet), false);
+}
+
+void JitterBuffer::PushLocal(Packet &&packet) {
+  std::lock_guard lock(mutex_);
+  last_arrival_us_ = -1;  // the time the burst took to play is not jitter either
+  Append(std::move(packet), true);
+}
+
+void JitterBuffer::MarkEnd() {
+  std::lock_guard lock(mutex_);
+  end_ = true;
+  last_arrival_us_ = -1;  // the pause until the next turn is not jitter
+}
+
+JitterBuffer::Action JitterBuffer::Pop(std::optional<Packet> *packet) {
+  std::lock_guard lock(mutex_);
+  if (buffering_) {
+    if (packets_.empty()) {
+      if (end_) {
+        end_ = false;
+        return Action::kDrained;
+      }
+      return Action::kWait;
+    }
+
+    if (!end_ && packets_.size() * config_.frame_duration < target_depth_) {
+      return Action::kWait;
+    }
+    buffering_ = false;
+  }
+
+  if (!packets_.empty()) {
+    auto &entry = packets_.front();
+    packet->emplace(std::move(entry.packet));
+    if (!entry.local) {
+      --network_packets_;
+      depth_.store(network_packets_ * config_.frame_duration, std::memory_order_relaxed);
+    }
+    packets_.pop_front();
+    conceal_run_ = 0;
+    return Action::kPlay;
+  }
+
+  if (end_) {
+    end_ = false;
+    buffering_ = true;
+    conceal_run_ = 0;
+    late_frames_ = 0;  // whatever still comes of this turn is not owed to the next one
+    return Action::kDrained;
+  }
+
+  if (conceal_run_ == 0) {
+    ++underrun_count_;
+  }
+
+  if ((conceal_run_ + 1) * config_.frame_duration <= config_.max_conceal) {
+    ++conceal_run_;
+    ++late_frames_;
+    ++concealed_count_;
+    return Action::kConceal;
+  }
+
+  buffering_ = true;
+  conceal_run_ = 0;
+  return Action::kWait;
+}
+
+void JitterBuffer::Clear() {
+  std::lock_guard lock(mutex_);
+  packets_.clear();
+  network_packets_ = 0;
+  depth_.store(0, std::memory_order_relaxed);
+  buffering_ = true;
+  end_ = false;
+  conceal_run_ = 0;
+  late_frames_ = 0;
+  last_arrival_us_ = -1;
+}
+
+void JitterBuffer::Flush() {
+  std::lock_guard lock(mutex_);
+  packets_.clear();
+  network_packets_ = 0;
+  depth_.store(0, std::memory_order_relaxed);
+  buffering_ = true;
+  conceal_run_ = 0;
+  late_frames_ = 0;
+}
+
+void JitterBuffer::Append(Packet &&packet, const bool local) {
+  packets_.push_back(Entry{std::move(packet), local});
+  if (!local) {
+    ++network_packets_;
+  }
+  while (packets_.size() * config_.frame_duration > config_.max_depth) {
+    if (!packets_.front().local) {
+      --network_packets_;
+    }
+    packets_.pop_front();
+    ++dropped_count_;
+  }
+  depth_.store(network_packets_ * config_.frame_duration, std::memory_order_relaxed);
+}
+
+void JitterBuffer::UpdateJitter(const int64_t arrival_us) {
+  if (last_arrival_us_ >= 0) {
+    // Packets arriving early only build up the buffer, only the ones arriving later than a frame apart need covering.
+    const auto delay_us = std::max<int64_t>(arrival_us - last_arrival_us_ - config_.frame_duration * 1000, 0);
+    jitter_us_ += (delay_us - jitter_us_) / kJitterGain;
+    const auto target = std::clamp<int64_t>(config_.frame_duration + jitter_us_ * 2 / 1000, config_.start_threshold, config_.max_target_depth);
+    target_depth_.store(static_cast<uint32_t>(target), std::memory_order_relaxed);
+  }
+  last_arrival_us_ = arrival_us;
+}
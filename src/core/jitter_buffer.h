@@ -0,0 +1,119 @@
+#pragma once
+
+#ifndef _JITTER_BUFFER_H_
+#define _JITTER_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+#include "components/buffer_pool/buffer_pool.h"
+#include "flex_array/packet.h"
+
+/**
+ * Downlink jitter buffer. The network task pushes one Opus packet per frame as it arrives, the playout task pops one
+ * action per frame: play the next packet, conceal a missing one, wait, or report that the turn has been played out.
+ *
+ * Playout starts once the buffered duration reaches the start threshold, which adapts upwards to the observed
+ * inter-arrival jitter. When the buffer runs dry mid-turn the frame is concealed for up to |max_conceal|, after that
+ * playout stops and rebuffers. A packet arriving after its frame was concealed is dropped. The buffer has no platform
+ * dependencies, time is passed in by the caller.
+ */
+class JitterBuffer {
+ public:
+  struct Config {
+    uint32_t frame_duration = 60;     // ms per packet
+    uint32_t start_threshold = 120;   // ms buffered before playout starts, the lower bound of the adaptive target
+    uint32_t max_target_depth = 600;  // ms, upper bound of the adaptive target
+    uint32_t max_depth = 3000;        // ms, the oldest packets beyond this are dropped
+    uint32_t max_conceal = 120;       // ms of consecutive concealment before playout rebuffers
+  };
+
+  enum class Action {
+    kWait,     // not enough buffered, try again once more data arrived
+    kPlay,     // decode the returned packet
+    kConceal,  // the next packet is late, conceal one frame
+    kDrained,  // MarkEnd() was called and everything before it has been played
+  };
+
+  explicit JitterBuffer(const Config &config);
+
+  // Network task.
+  void Push(Packet &&packet, const int64_t arrival_us);
+  // A packet that did not come over the network, e.g. replayed from a cache all at once. It neither feeds the jitter
+  // estimate nor counts towards depth(), so a burst of them is not taken for the network running ahead.
+  void PushLocal(Packet &&packet);
+  // Network task. No more packets this turn, what is buffered plays out without waiting for the threshold.
+  void MarkEnd();
+
+  // Playout task. |packet| is set for Action::kPlay only.
+  Action Pop(std::optional<Packet> *packet);
+
+  // Drops everything buffered and starts over with the next turn, the jitter estimate is kept.
+  void Clear();
+
+  // Drops everything buffered but keeps a pending end marker, for cutting a turn short locally.
+  void Flush();
+
+  // ms currently required before playout starts.
+  uint32_t target_depth() const {
+    return target_depth_.load(std::memory_order_relaxed);
+  }
+
+  // ms currently buffered from the network.
+  uint32_t depth() const {
+    return depth_.load(std::memory_order_relaxed);
+  }
+
+  // Times playout ran dry mid-turn.
+  uint32_t underrun_count() const {
+    return underrun_count_.load(std::memory_order_relaxed);
+  }
+
+  // Packets that arrived after their frame had been concealed, they are dropped.
+  uint32_t late_count() const {
+    return late_count_.load(std::memory_order_relaxed);
+  }
+
+  // Packets dropped because the buffer exceeded |max_depth|.
+  uint32_t dropped_count() const {
+    return dropped_count_.load(std::memory_order_relaxed);
+  }
+
+  uint32_t concealed_count() const {
+    return concealed_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  JitterBuffer(const JitterBuffer &) = delete;
+  JitterBuffer &operator=(const JitterBuffer &) = delete;
+
+  struct Entry {
+    Packet packet;
+    bool local = false;
+  };
+
+  void UpdateJitter(const int64_t arrival_us);
+  void Append(Packet &&packet, const bool local);
+
+  const Config config_;
+  std::mutex mutex_;
+  std::deque<Entry, BufferPoolAllocator<Entry>> packets_;  // the deque nodes come from the pool like the packets
+  size_t network_packets_ = 0;
+  bool buffering_ = true;
+  bool end_ = false;
+  uint32_t conceal_run_ = 0;  // frames concealed since the last packet played
+  uint32_t late_frames_ = 0;  // concealed frames whose packets have not arrived yet
+  int64_t last_arrival_us_ = -1;
+  int64_t jitter_us_ = 0;
+  std::atomic<uint32_t> target_depth_ = 0;
+  std::atomic<uint32_t> depth_ = 0;
+  std::atomic<uint32_t> underrun_count_ = 0;
+  std::atomic<uint32_t> late_count_ = 0;
+  std::atomic<uint32_t> dropped_count_ = 0;
+  std::atomic<uint32_t> concealed_count_ = 0;
+};
+
+#endif
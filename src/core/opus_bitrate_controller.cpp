@@ -0,0 +1,66 @@
+#include "opus_bitrate_controller.h"
+
+#include <algorithm>
+
+#include "libopus/opus_defines.h"
+
+namespace {
+constexpr uint32_t kLossSmoothingShift = 5;  // loss estimate averages over ~32 packets
+
+int32_t BandwidthForBitrate(const int32_t bitrate) {
+  if (bitrate >= 16000) {
+    return OPUS_BANDWIDTH_WIDEBAND;
+  } else if (bitrate >= 10000) {
+    return OPUS_BANDWIDTH_MEDIUMBAND;
+  }
+  return OPUS_BANDWIDTH_NARROWBAND;
+}
+}  // namespace
+
+OpusBitrateController::OpusBitrateController(const Config &config) : config_(config), sends_since_decrease_(config.decrease_holdoff) {
+  Publish(std::clamp(config_.initial_bitrate, config_.min_bitrate, config_.max_bitrate), 0);
+}
+
+void OpusBitrateController::ReportSend(const uint32_t send_time_us, const size_t queue_depth) {
+  std::lock_guard lock(mutex_);
+  loss_q16_ -= loss_q16_ >> kLossSmoothingShift;
+  ++sends_since_decrease_;
+
+  if (send_time_us > config_.frame_duration * 1000 || queue_depth >= config_.congested_queue_depth) {
+    OnCongestion();
+    return;
+  }
+
+  if (++healthy_sends_ >= config_.increase_interval) {
+    healthy_sends_ = 0;
+    Publish(std::min(bitrate() + config_.increase_step, config_.max_bitrate), (loss_q16_ * 100) >> 16);
+  }
+}
+
+void OpusBitrateController::ReportDrop() {
+  std::lock_guard lock(mutex_);
+  loss_q16_ += ((1u << 16) - loss_q16_) >> kLossSmoothingShift;
+  OnCongestion();
+}
+
+void OpusBitrateController::OnCongestion() {
+  healthy_sends_ = 0;
+  auto bitrate = this->bitrate();
+  if (sends_since_decrease_ >= config_.decrease_holdoff) {
+    sends_since_decrease_ = 0;
+    bitrate = std::max(bitrate * 3 / 4, config_.min_bitrate);
+  }
+  Publish(bitrate, (loss_q16_ * 100) >> 16);
+}
+
+void OpusBitrateController::Publish(const int32_t bitrate, const int32_t packet_loss_perc) {
+  const auto loss = std::min(packet_loss_perc, config_.max_packet_loss_perc);
+  if (bitrate == this->bitrate() && loss == this->packet_loss_perc()) {
+    return;
+  }
+
+  bitrate_.store(bitrate, std::memory_order_relaxed);
+  bandwidth_.store(BandwidthForBitrate(bitrate), std::memory_order_relaxed);
+  packet_loss_perc_.store(loss, std::memory_order_relaxed);
+  revision_.fetch_add(1, std::memory_order_release);
+}
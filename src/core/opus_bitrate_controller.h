@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef _OPUS_BITRATE_CONTROLLER_H_
+#define _OPUS_BITRATE_CONTROLLER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Closed-loop uplink bitrate control. The network task reports how long each packet took to send and how deep the send
+ * queue is, the encoder task picks up the resulting bitrate, bandwidth and expected loss before encoding.
+ *
+ * Congestion cuts the bitrate multiplicatively, a run of healthy sends raises it again in small steps. Packets dropped
+ * in front of the network queue, which the encoder task reports, raise the expected packet loss so the encoder spends
+ * bits on robustness instead.
+ * The controller has no platform dependencies and can be driven from a host-side simulated sink.
+ */
+class OpusBitrateController {
+ public:
+  struct Config {
+    uint32_t frame_duration = 60;          // ms, send slower than this is congestion
+    int32_t min_bitrate = 8000;            // bps
+    int32_t max_bitrate = 32000;           // bps
+    int32_t initial_bitrate = 24000;       // bps
+    int32_t increase_step = 2000;          // bps
+    uint32_t increase_interval = 50;       // healthy sends before stepping up
+    uint32_t decrease_holdoff = 5;         // sends to wait after a cut, so the queue can drain
+    size_t congested_queue_depth = 3;      // queued packets that count as congestion
+    int32_t max_packet_loss_perc = 20;
+  };
+
+  explicit OpusBitrateController(const Config &config);
+
+  // Network task: one call per packet sent.
+  void ReportSend(const uint32_t send_time_us, const size_t queue_depth);
+  // Encoder task: one call per packet dropped because the send queue was full. May run concurrently with ReportSend().
+  void ReportDrop();
+
+  // Encoder task: re-apply the settings below whenever the revision changes.
+  uint32_t revision() const {
+    return revision_.load(std::memory_order_acquire);
+  }
+
+  int32_t bitrate() const {
+    return bitrate_.load(std::memory_order_relaxed);
+  }
+
+  int32_t bandwidth() const {
+    return bandwidth_.load(std::memory_order_relaxed);
+  }
+
+  int32_t packet_loss_perc() const {
+    return packet_loss_perc_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  OpusBitrateController(const OpusBitrateController &) = delete;
+  OpusBitrateController &operator=(const OpusBitrateController &) = delete;
+
+  void OnCongestion();
+  void Publish(const int32_t bitrate, const int32_t packet_loss_perc);
+
+  const Config config_;
+  std::mutex mutex_;  // guards the reported state below, ReportSend() and ReportDrop() come from different tasks
+  uint32_t healthy_sends_ = 0;
+  uint32_t sends_since_decrease_ = 0;
+  uint32_t loss_q16_ = 0;
+  std::atomic<int32_t> bitrate_ = 0;
+  std::atomic<int32_t> bandwidth_ = 0;
+  std::atomic<int32_t> packet_loss_perc_ = 0;
+  std::atomic<uint32_t> revision_ = 0;
+};
+
+#endif
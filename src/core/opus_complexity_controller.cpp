@@ -0,0 +1,45 @@
+#include "opus_complexity_controller.h"
+
+#include <algorithm>
+
+OpusComplexityController::OpusComplexityController(const Config &config, const uint32_t frame_duration)
+    : config_(config),
+      budget_us_(frame_duration * 1000),
+      complexity_(std::clamp(config.initial_complexity, config.min_complexity, config.max_complexity)) {
+}
+
+int32_t OpusComplexityController::Report(const uint32_t encode_time_us) {
+  const auto load_perc = budget_us_ == 0 ? 0 : static_cast<uint32_t>(static_cast<uint64_t>(encode_time_us) * 100 / budget_us_);
+  histogram_[std::min<size_t>(load_perc / 10, kHistogramBuckets - 1)].fetch_add(1, std::memory_order_relaxed);
+
+  if (load_perc >= 100) {
+    // Missed the deadline outright, the capture ring is already filling up.
+    window_count_ = 0;
+    window_load_sum_ = 0;
+    complexity_ = std::max(complexity_ - 1, config_.min_complexity);
+    return complexity_;
+  }
+
+  window_load_sum_ += load_perc;
+  if (++window_count_ < config_.window_frames) {
+    return complexity_;
+  }
+
+  const auto mean_load_perc = window_load_sum_ / window_count_;
+  window_count_ = 0;
+  window_load_sum_ = 0;
+  if (mean_load_perc > config_.target_load_perc) {
+    complexity_ = std::max(complexity_ - 1, config_.min_complexity);
+  } else if (mean_load_perc < config_.target_load_perc / 2) {
+    complexity_ = std::min(complexity_ + 1, config_.max_complexity);
+  }
+  return complexity_;
+}
+
+std::array<uint32_t, OpusComplexityController::kHistogramBuckets> OpusComplexityController::histogram() const {
+  std::array<uint32_t, kHistogramBuckets> histogram;
+  for (size_t i = 0; i < kHistogramBuckets; i++) {
+    histogram[i] = histogram_[i].load(std::memory_order_relaxed);
+  }
+  return histogram;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef _OPUS_COMPLEXITY_CONTROLLER_H_
+#define _OPUS_COMPLEXITY_CONTROLLER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Keeps the Opus encoder inside its CPU budget. Every encode is timed against the frame duration; once a window of
+ * frames has been seen the complexity is lowered if the mean load is above |target_load_perc| and raised again when
+ * there is plenty of headroom. A single encode that misses the frame deadline lowers it immediately.
+ *
+ * The time is wall-clock, so it includes whatever preempted the encoder meanwhile. That is deliberate: the deadline is
+ * missed all the same, and a lower complexity is the only thing the encoder can do about it.
+ */
+class OpusComplexityController {
+ public:
+  static constexpr size_t kHistogramBuckets = 11;  // 10% of the frame budget each, the last one counts deadline misses
+
+  struct Config {
+    int32_t min_complexity = 0;
+    int32_t max_complexity = 8;
+    int32_t initial_complexity = 5;
+    uint32_t target_load_perc = 50;  // mean encode time as a percentage of the frame duration
+    uint32_t window_frames = 16;     // frames averaged per adjustment
+  };
+
+  OpusComplexityController(const Config &config, const uint32_t frame_duration);
+
+  // Returns the complexity to use for the next encode.
+  int32_t Report(const uint32_t encode_time_us);
+
+  int32_t complexity() const {
+    return complexity_;
+  }
+
+  // Encode time distribution since construction, bucket i covers [i * 10%, (i + 1) * 10%) of the frame duration.
+  std::array<uint32_t, kHistogramBuckets> histogram() const;
+
+ private:
+  OpusComplexityController(const OpusComplexityController &) = delete;
+  OpusComplexityController &operator=(const OpusComplexityController &) = delete;
+
+  const Config config_;
+  const uint32_t budget_us_ = 0;
+  int32_t complexity_ = 0;
+  uint32_t window_count_ = 0;
+  uint32_t window_load_sum_ = 0;
+  std::array<std::atomic<uint32_t>, kHistogramBuckets> histogram_ = {};
+};
+
+#endif
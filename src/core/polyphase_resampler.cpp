@@ -0,0 +1,129 @@
+#include "polyphase_resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#ifndef CLOGGER_SEVERITY
+#define CLOGGER_SEVERITY CLOGGER_SEVERITY_WARN
+#endif
+#include "clogger/clogger.h"
+
+namespace {
+constexpr size_t kTaps = 16;        // per phase when upsampling, scaled by the decimation factor when downsampling
+constexpr float kBandwidth = 0.9f;  // of the lower Nyquist frequency
+
+// Four independent accumulators so the compiler can keep the multiply-accumulates in flight. The taps of a phase sum to
+// one, so the sum stays within 32 bits.
+int16_t Filter(const int16_t *input, const int16_t *coefficients, const size_t taps) {
+  int32_t sum0 = 0;
+  int32_t sum1 = 0;
+  int32_t sum2 = 0;
+  int32_t sum3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= taps; i += 4) {
+    sum0 += static_cast<int32_t>(input[i]) * coefficients[i];
+    sum1 += static_cast<int32_t>(input[i + 1]) * coefficients[i + 1];
+    sum2 += static_cast<int32_t>(input[i + 2]) * coefficients[i + 2];
+    sum3 += static_cast<int32_t>(input[i + 3]) * coefficients[i + 3];
+  }
+  for (; i < taps; i++) {
+    sum0 += static_cast<int32_t>(input[i]) * coefficients[i];
+  }
+  const int32_t value = (sum0 + sum1 + sum2 + sum3 + (1 << 14)) >> 15;
+  return static_cast<int16_t>(std::clamp<int32_t>(value, INT16_MIN, INT16_MAX));
+}
+}  // namespace
+
+PolyphaseResampler::PolyphaseResampler(const uint32_t input_sample_rate, const uint32_t output_sample_rate)
+    : Resampler(input_sample_rate, output_sample_rate) {
+  const auto divisor = std::gcd(input_sample_rate, output_sample_rate);
+  interpolation_ = output_sample_rate / divisor;
+  decimation_ = input_sample_rate / divisor;
+  taps_ = kTaps * ((decimation_ + interpolation_ - 1) / interpolation_);
+
+  // Windowed sinc at L times the input rate, cut off below the lower of the two Nyquist frequencies. Phase p weighs the
+  // input k samples back with tap p + k * L of it. The taps are computed a phase at a time in float, so construction
+  // needs no more than the coefficients themselves plus one phase, even for 44.1 kHz with thousands of taps.
+  const size_t length = interpolation_ * taps_;
+  const float cutoff = kBandwidth / 2 / std::max(interpolation_, decimation_);  // cycles per sample
+  const float center = (length - 1) / 2.0f;
+  const float window_step = 2 * static_cast<float>(M_PI) / (length - 1);
+  std::vector<float> phase_taps(taps_);
+  coefficients_.resize(length);
+  for (uint32_t phase = 0; phase < interpolation_; phase++) {
+    float sum = 0;
+    for (size_t k = 0; k < taps_; k++) {
+      const size_t i = phase + k * interpolation_;
+      const float t = 2 * static_cast<float>(M_PI) * cutoff * (i - center);
+      const float sinc = t == 0 ? 1.0f : std::sin(t) / t;
+      const float window = 0.42f - 0.5f * std::cos(window_step * i) + 0.08f * std::cos(2 * window_step * i);
+      phase_taps[k] = sinc * window;
+      sum += phase_taps[k];
+    }
+    // Every phase is normalized to unity gain.
+    for (size_t k = 0; k < taps_; k++) {
+      const auto value = std::lround(phase_taps[k] / sum * 32768);
+      coefficients_[phase * taps_ + taps_ - 1 - k] = static_cast<int16_t>(std::clamp<long>(value, INT16_MIN, INT16_MAX));
+    }
+  }
+
+  CLOGD("%" PRIu32 " -> %" PRIu32 " Hz, %" PRIu32 "/%" PRIu32 ", %zu taps per phase",
+        input_sample_rate,
+        output_sample_rate,
+        interpolation_,
+        decimation_,
+        taps_);
+  history_.reserve(taps_ * 2);
+  Reset();
+}
+
+size_t PolyphaseResampler::output_size(const size_t input_size) const {
+  const uint64_t available = static_cast<uint64_t>(history_.size() + input_size) * interpolation_;
+  const uint64_t position = static_cast<uint64_t>(next_) * interpolation_ + phase_;
+  return position < available ? static_cast<size_t>((available - position + decimation_ - 1) / decimation_) : 0;
+}
+
+uint32_t PolyphaseResampler::delay() const {
+  return static_cast<uint32_t>((interpolation_ * taps_ - 1) / 2 / decimation_);
+}
+
+size_t PolyphaseResampler::Resample(const int16_t *input, size_t input_size, int16_t *output, const size_t output_capacity) {
+  if (output_capacity < output_size(input_size)) {
+    CLOGE("output of %zu samples too small for %zu", output_capacity, output_size(input_size));
+    abort();
+  }
+
+  history_.insert(history_.end(), input, input + input_size);
+  size_t produced = 0;
+  if (interpolation_ == 1) {
+    while (next_ < history_.size()) {
+      output[produced++] = Filter(history_.data() + next_ + 1 - taps_, coefficients_.data(), taps_);
+      next_ += decimation_;
+    }
+  } else {
+    const size_t step = decimation_ / interpolation_;
+    const uint32_t remainder = decimation_ % interpolation_;
+    while (next_ < history_.size()) {
+      output[produced++] = Filter(history_.data() + next_ + 1 - taps_, coefficients_.data() + phase_ * taps_, taps_);
+      next_ += step;
+      phase_ += remainder;
+      if (phase_ >= interpolation_) {
+        phase_ -= interpolation_;
+        ++next_;
+      }
+    }
+  }
+
+  // Keep what the next output still reaches back to.
+  const size_t consumed = std::min(next_ + 1 - taps_, history_.size());
+  history_.erase(history_.begin(), history_.begin() + consumed);
+  next_ -= consumed;
+  return produced;
+}
+
+void PolyphaseResampler::Reset() {
+  history_.assign(taps_ - 1, 0);
+  next_ = taps_ - 1;
+  phase_ = 0;
+}
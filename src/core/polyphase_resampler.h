@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef _POLYPHASE_RESAMPLER_H_
+#define _POLYPHASE_RESAMPLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "resampler.h"
+
+/**
+ * Polyphase FIR resampler for any pair of rates, e.g. 44.1 kHz music to a 16 or 24 kHz device. The rate ratio is
+ * reduced to L/M, the Blackman windowed sinc is split into L phases of Q15 taps once at construction, and every output
+ * sample is one dot product of a phase with the most recent input.
+ *
+ * Pure decimation (L = 1, e.g. 2:1 and 3:1) takes a loop without phase bookkeeping. The filter is longer the more the
+ * rate drops, so the stopband holds for downsampling too. No platform dependencies.
+ */
+class PolyphaseResampler : public Resampler {
+ public:
+  PolyphaseResampler(const uint32_t input_sample_rate, const uint32_t output_sample_rate);
+
+  size_t output_size(const size_t input_size) const override;
+  uint32_t delay() const override;
+  size_t Resample(const int16_t *input, size_t input_size, int16_t *output, const size_t output_capacity) override;
+  using Resampler::Resample;
+  void Reset() override;
+
+ private:
+  PolyphaseResampler(const PolyphaseResampler &) = delete;
+  PolyphaseResampler &operator=(const PolyphaseResampler &) = delete;
+
+  uint32_t interpolation_ = 1;         // L
+  uint32_t decimation_ = 1;            // M
+  size_t taps_ = 0;                    // per phase
+  std::vector<int16_t> coefficients_;  // Q15, |taps_| per phase, oldest input first
+  std::vector<int16_t> history_;       // the last |taps_| - 1 input samples, then the input of the current call
+  size_t next_ = 0;                    // index in |history_| of the newest input sample of the next output
+  uint32_t phase_ = 0;                 // of the next output, below L
+};
+
+#endif
@@ -0,0 +1,18 @@
+#include "resampler.h"
+
+#include "polyphase_resampler.h"
+#include "silk_resampler.h"
+
+std::unique_ptr<Resampler> Resampler::Create(const uint32_t input_sample_rate, const uint32_t output_sample_rate, const Backend backend) {
+  const bool silk = backend == Backend::kSilk || (backend == Backend::kAuto && SilkResampler::Supports(input_sample_rate, output_sample_rate));
+  if (silk) {
+    return std::make_unique<SilkResampler>(input_sample_rate, output_sample_rate);
+  }
+  return std::make_unique<PolyphaseResampler>(input_sample_rate, output_sample_rate);
+}
+
+FlexArray<int16_t> Resampler::Resample(FlexArray<int16_t> &&input_pcm) {
+  FlexArray<int16_t> output_pcm(output_size(input_pcm.size()));
+  output_pcm.Resize(Resample(input_pcm.data(), input_pcm.size(), output_pcm.data(), output_pcm.size()));
+  return output_pcm;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef _RESAMPLER_H_
+#define _RESAMPLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "flex_array/flex_array.h"
+
+/**
+ * Streaming mono resampler. Input may be split at any sample, what a backend cannot convert yet is kept for the next
+ * call, so the output does not drift however the input is split.
+ */
+class Resampler {
+ public:
+  enum class Backend {
+    kAuto,       // SILK where it supports the rates, polyphase FIR otherwise
+    kSilk,       // libopus' SILK resampler, whole kHz rates only, cheapest
+    kPolyphase,  // polyphase FIR, any pair of rates
+  };
+
+  static std::unique_ptr<Resampler> Create(const uint32_t input_sample_rate,
+                                           const uint32_t output_sample_rate,
+                                           const Backend backend = Backend::kAuto);
+
+  Resampler(const uint32_t input_sample_rate, const uint32_t output_sample_rate)
+      : input_sample_rate_(input_sample_rate), output_sample_rate_(output_sample_rate) {
+  }
+  virtual ~Resampler() = default;
+
+  uint32_t input_sample_rate() const {
+    return input_sample_rate_;
+  }
+
+  uint32_t output_sample_rate() const {
+    return output_sample_rate_;
+  }
+
+  // Samples the next Resample() of |input_size| samples writes.
+  virtual size_t output_size(const size_t input_size) const = 0;
+
+  // Group delay in samples at the output rate, including the input held back for the next call.
+  virtual uint32_t delay() const = 0;
+
+  // Converts |input| into |output|, which must have room for output_size(|input_size|) samples. Returns the number of
+  // samples written.
+  virtual size_t Resample(const int16_t *input, size_t input_size, int16_t *output, const size_t output_capacity) = 0;
+
+  // Allocating convenience over the above.
+  FlexArray<int16_t> Resample(FlexArray<int16_t> &&input_pcm);
+
+  // Drops the held back input and the filter state, for a new stream.
+  virtual void Reset() = 0;
+
+ private:
+  Resampler(const Resampler &) = delete;
+  Resampler &operator=(const Resampler &) = delete;
+
+  const uint32_t input_sample_rate_ = 0;
+  const uint32_t output_sample_rate_ = 0;
+};
+
+#endif
@@ -1,5 +1,8 @@
 #include "silk_resampler.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "libopus/opus.h"
 #include "libopus/resampler_structs.h"
 
@@ -20,30 +23,93 @@ extern "C" opus_int silk_resampler(silk_resampler_state_struct *S, /* I/O  Resam
                                    opus_int32 inLen                /* I    Number of input samples                                     */
 );
 
+namespace {
+bool IsSilkRate(const uint32_t sample_rate, const bool output) {
+  switch (sample_rate) {
+    case 8000:
+    case 12000:
+    case 16000:
+      return true;
+    case 24000:
+    case 48000:
+      return !output;
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+// SILK only downsamples to 16 kHz and below, and only upsamples from there.
+bool SilkResampler::Supports(const uint32_t input_sample_rate, const uint32_t output_sample_rate) {
+  return input_sample_rate > output_sample_rate ? IsSilkRate(input_sample_rate, false) && IsSilkRate(output_sample_rate, true)
+                                                : IsSilkRate(input_sample_rate, true) && IsSilkRate(output_sample_rate, false);
+}
+
 SilkResampler::SilkResampler(const uint32_t input_sample_rate, const uint32_t output_sample_rate)
-    : input_sample_rate_(input_sample_rate), output_sample_rate_(output_sample_rate), silk_resampler_(new silk_resampler_state_struct) {
-  const auto ret = silk_resampler_init(reinterpret_cast<silk_resampler_state_struct *>(silk_resampler_),
-                                       input_sample_rate,
-                                       output_sample_rate,
-                                       input_sample_rate > output_sample_rate ? 1 : 0);
+    : Resampler(input_sample_rate, output_sample_rate),
+      input_samples_per_ms_(input_sample_rate / 1000),
+      output_samples_per_ms_(output_sample_rate / 1000),
+      silk_resampler_(new silk_resampler_state_struct) {
+  Reset();
+}
 
-  if (ret != 0) {
-    CLOGE("silk_resampler_init failed with: %d", ret);
+SilkResampler::~SilkResampler() {
+  delete reinterpret_cast<silk_resampler_state_struct *>(silk_resampler_);
+}
+
+uint32_t SilkResampler::delay() const {
+  const auto state = reinterpret_cast<const silk_resampler_state_struct *>(silk_resampler_);
+  return static_cast<uint32_t>((state->inputDelay + pending_size_) * output_sample_rate() / input_sample_rate());
+}
+
+size_t SilkResampler::Resample(const int16_t *input, size_t input_size, int16_t *output, const size_t output_capacity) {
+  if (output_capacity < output_size(input_size)) {
+    CLOGE("output of %zu samples too small for %zu", output_capacity, output_size(input_size));
     abort();
   }
+
+  size_t produced = 0;
+  if (pending_size_ > 0) {
+    const auto count = std::min(input_size, input_samples_per_ms_ - pending_size_);
+    std::memcpy(pending_ + pending_size_, input, count * sizeof(int16_t));
+    pending_size_ += count;
+    input += count;
+    input_size -= count;
+    if (pending_size_ < input_samples_per_ms_) {
+      return 0;
+    }
+    Process(pending_, pending_size_, output);
+    produced += output_samples_per_ms_;
+    pending_size_ = 0;
+  }
+
+  const auto milliseconds = input_size / input_samples_per_ms_;
+  if (milliseconds > 0) {
+    Process(input, milliseconds * input_samples_per_ms_, output + produced);
+    produced += milliseconds * output_samples_per_ms_;
+  }
+
+  pending_size_ = input_size - milliseconds * input_samples_per_ms_;
+  std::memcpy(pending_, input + milliseconds * input_samples_per_ms_, pending_size_ * sizeof(int16_t));
+  return produced;
 }
 
-SilkResampler::~SilkResampler() {
-  delete reinterpret_cast<silk_resampler_state_struct *>(silk_resampler_);
+void SilkResampler::Reset() {
+  const auto ret = silk_resampler_init(reinterpret_cast<silk_resampler_state_struct *>(silk_resampler_),
+                                       input_sample_rate(),
+                                       output_sample_rate(),
+                                       input_sample_rate() > output_sample_rate() ? 1 : 0);
+  if (ret != 0) {
+    CLOGE("silk_resampler_init failed with: %d", ret);
+    abort();
+  }
+  pending_size_ = 0;
 }
 
-FlexArray<int16_t> SilkResampler::Resample(FlexArray<int16_t> &&input_pcm) const {
-  FlexArray<int16_t> output_pcm(input_pcm.size() * output_sample_rate_ / input_sample_rate_);
-  const auto ret =
-      silk_resampler(reinterpret_cast<silk_resampler_state_struct *>(silk_resampler_), output_pcm.data(), input_pcm.data(), input_pcm.size());
+void SilkResampler::Process(const int16_t *input, const size_t input_size, int16_t *output) {
+  const auto ret = silk_resampler(reinterpret_cast<silk_resampler_state_struct *>(silk_resampler_), output, input, input_size);
   if (ret != 0) {
     CLOGE("silk_resampler_process failed with: %d", ret);
     abort();
   }
-  return output_pcm;
-}
\ No newline at end of file
+}
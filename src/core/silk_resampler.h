@@ -3,28 +3,47 @@
 #ifndef _SILK_RESAMPLER_H_
 #define _SILK_RESAMPLER_H_
 
+#include <cstddef>
 #include <cstdint>
 
-#include "flex_array/flex_array.h"
-
-class SilkResampler {
+#include "resampler.h"
+
+/**
+ * Streaming wrapper around the SILK resampler of libopus. Rates are whole kHz, 8 to 48; downsampling goes to 16 kHz
+ * and below, upsampling from there.
+ *
+ * SILK converts whole milliseconds only, so the input left over beyond the last whole millisecond is kept for the next
+ * call. The output is therefore exact however the input is split: after N input samples, exactly
+ * N / input rate * output rate samples have come out, rounded down to whole milliseconds.
+ */
+class SilkResampler : public Resampler {
  public:
+  // Whether SILK can convert between the two rates, the constructor aborts otherwise.
+  static bool Supports(const uint32_t input_sample_rate, const uint32_t output_sample_rate);
+
   SilkResampler(const uint32_t input_sample_rate, const uint32_t output_sample_rate);
-  ~SilkResampler();
-  inline uint32_t input_sample_rate() const {
-    return input_sample_rate_;
-  }
+  ~SilkResampler() override;
 
-  inline uint32_t output_sample_rate() const {
-    return output_sample_rate_;
+  size_t output_size(const size_t input_size) const override {
+    return (pending_size_ + input_size) / input_samples_per_ms_ * output_samples_per_ms_;
   }
 
-  FlexArray<int16_t> Resample(FlexArray<int16_t> &&input_pcm) const;
+  uint32_t delay() const override;
+  size_t Resample(const int16_t *input, size_t input_size, int16_t *output, const size_t output_capacity) override;
+  using Resampler::Resample;
+  void Reset() override;
 
  private:
-  const uint32_t input_sample_rate_ = 0;
-  const uint32_t output_sample_rate_ = 0;
+  SilkResampler(const SilkResampler &) = delete;
+  SilkResampler &operator=(const SilkResampler &) = delete;
+
+  void Process(const int16_t *input, const size_t input_size, int16_t *output);
+
+  const size_t input_samples_per_ms_ = 0;
+  const size_t output_samples_per_ms_ = 0;
   void *const silk_resampler_ = nullptr;
+  int16_t pending_[48];  // less than a millisecond of input
+  size_t pending_size_ = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,156 @@
+#include "time_stretcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+constexpr uint32_t kSequenceDuration = 40;  // ms
+constexpr uint32_t kOverlapDuration = 8;    // ms
+constexpr uint32_t kSeekDuration = 12;      // ms
+constexpr size_t kCoarseSeekStep = 4;       // samples, the best coarse match is then refined sample by sample
+
+// Four independent accumulators so the compiler can keep the multiply-accumulates in flight.
+int64_t Dot(const int16_t *a, const int16_t *b, const size_t size) {
+  int64_t sum0 = 0;
+  int64_t sum1 = 0;
+  int64_t sum2 = 0;
+  int64_t sum3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    sum0 += static_cast<int32_t>(a[i]) * b[i];
+    sum1 += static_cast<int32_t>(a[i + 1]) * b[i + 1];
+    sum2 += static_cast<int32_t>(a[i + 2]) * b[i + 2];
+    sum3 += static_cast<int32_t>(a[i + 3]) * b[i + 3];
+  }
+  for (; i < size; i++) {
+    sum0 += static_cast<int32_t>(a[i]) * b[i];
+  }
+  return sum0 + sum1 + sum2 + sum3;
+}
+}  // namespace
+
+TimeStretcher::TimeStretcher(const uint32_t sample_rate)
+    : sample_rate_(sample_rate),
+      sequence_(sample_rate / 1000 * kSequenceDuration),
+      overlap_(sample_rate / 1000 * kOverlapDuration),
+      seek_(sample_rate / 1000 * kSeekDuration) {
+  input_.reserve((sequence_ + seek_) * 3);
+  tail_.reserve(overlap_);
+}
+
+FlexArray<int16_t> TimeStretcher::Process(FlexArray<int16_t> &&pcm, uint32_t speed) {
+  speed = std::clamp(speed, kMinSpeed, kMaxSpeed);
+  if (speed == 100 && !active_) {
+    return std::move(pcm);
+  }
+
+  input_.insert(input_.end(), pcm.data(), pcm.data() + pcm.size());
+
+  if (speed == 100) {
+    // Back to normal speed: fade the held back tail into the input and pass everything through from now on.
+    FlexArray<int16_t> output(tail_.size() + input_.size());
+    auto out = output.data();
+    if (input_.size() >= overlap_) {
+      CrossFade(input_.data(), out);
+      std::copy(input_.begin() + overlap_, input_.end(), out + overlap_);
+      output.Resize(input_.size());
+    } else {
+      out = std::copy(tail_.begin(), tail_.end(), out);
+      std::copy(input_.begin(), input_.end(), out);
+    }
+    Reset();
+    return output;
+  }
+
+  if (!active_) {
+    if (input_.size() < overlap_) {
+      return FlexArray<int16_t>(0);
+    }
+    tail_.assign(input_.begin(), input_.begin() + overlap_);
+    input_.erase(input_.begin(), input_.begin() + overlap_);
+    active_ = true;
+  }
+
+  // Every sequence plays |sequence_ - overlap_| samples and moves the input on by that times the speed.
+  const uint32_t skip_q16 = static_cast<uint32_t>(static_cast<uint64_t>(sequence_ - overlap_) * speed * 65536 / 100);
+  const size_t sequences = input_.size() < sequence_ + seek_ ? 0 : (input_.size() - sequence_ - seek_) / (skip_q16 >> 16) + 1;
+  FlexArray<int16_t> output((sequence_ - overlap_) * sequences);
+  size_t produced = 0;
+  for (;;) {
+    const uint32_t skip = skip_remainder_ + skip_q16;
+    const size_t skip_samples = skip >> 16;
+    if (input_.size() < std::max(sequence_ + seek_, skip_samples) || produced + sequence_ - overlap_ > output.size()) {
+      break;
+    }
+
+    const auto offset = Seek();
+    auto out = output.data() + produced;
+    CrossFade(input_.data() + offset, out);
+    std::memcpy(out + overlap_, input_.data() + offset + overlap_, (sequence_ - 2 * overlap_) * sizeof(int16_t));
+    tail_.assign(input_.begin() + offset + sequence_ - overlap_, input_.begin() + offset + sequence_);
+    produced += sequence_ - overlap_;
+
+    input_.erase(input_.begin(), input_.begin() + skip_samples);
+    skip_remainder_ = skip & 0xFFFF;
+  }
+
+  output.Resize(produced);
+  return output;
+}
+
+FlexArray<int16_t> TimeStretcher::Flush() {
+  return Process(FlexArray<int16_t>(0), 100);
+}
+
+void TimeStretcher::Reset() {
+  active_ = false;
+  input_.clear();
+  tail_.clear();
+  skip_remainder_ = 0;
+}
+
+size_t TimeStretcher::Seek() const {
+  size_t best_offset = 0;
+  float best_score = Score(0);
+  for (size_t offset = kCoarseSeekStep; offset < seek_; offset += kCoarseSeekStep) {
+    const auto score = Score(offset);
+    if (score > best_score) {
+      best_score = score;
+      best_offset = offset;
+    }
+  }
+
+  const size_t begin = best_offset > kCoarseSeekStep - 1 ? best_offset - (kCoarseSeekStep - 1) : 0;
+  const size_t end = std::min(best_offset + kCoarseSeekStep, seek_);
+  const auto coarse_offset = best_offset;
+  for (size_t offset = begin; offset < end; offset++) {
+    if (offset == coarse_offset) {
+      continue;
+    }
+    const auto score = Score(offset);
+    if (score > best_score) {
+      best_score = score;
+      best_offset = offset;
+    }
+  }
+  return best_offset;
+}
+
+// Cross-correlation with the previous tail, normalized by the energy of the candidate so loud passages do not win.
+float TimeStretcher::Score(const size_t offset) const {
+  const auto candidate = input_.data() + offset;
+  const auto correlation = Dot(tail_.data(), candidate, overlap_);
+  const auto energy = Dot(candidate, candidate, overlap_);
+  return static_cast<float>(correlation) / std::sqrt(static_cast<float>(energy) + 1.0f);
+}
+
+// Linear cross-fade in Q15 from the previous tail to |to| over the overlap.
+void TimeStretcher::CrossFade(const int16_t *to, int16_t *output) const {
+  const int32_t step = (1 << 15) / static_cast<int32_t>(overlap_);
+  int32_t gain = 0;
+  for (size_t i = 0; i < overlap_; i++) {
+    output[i] = static_cast<int16_t>((tail_[i] * ((1 << 15) - gain) + to[i] * gain) >> 15);
+    gain += step;
+  }
+}
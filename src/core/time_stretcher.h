@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef _TIME_STRETCHER_H_
+#define _TIME_STRETCHER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "flex_array/flex_array.h"
+
+/**
+ * Changes the playback speed of mono PCM without changing its pitch, with WSOLA: the input is cut into overlapping
+ * sequences taken further apart (faster) or closer together (slower) than they are played, and each sequence is
+ * shifted within a short seek window to where it lines up best with the one before, then cross-faded with it.
+ *
+ * Samples and correlations are fixed-point, only the score of each candidate position takes a float division. At
+ * 100 % the input passes through untouched and costs nothing. The stretcher has no platform dependencies.
+ */
+class TimeStretcher {
+ public:
+  static constexpr uint32_t kMinSpeed = 50;   // percent
+  static constexpr uint32_t kMaxSpeed = 200;  // percent
+
+  explicit TimeStretcher(const uint32_t sample_rate);
+
+  // |speed| in percent, may change from call to call. The output is roughly |pcm| * 100 / |speed| samples; some input
+  // is held back between calls.
+  FlexArray<int16_t> Process(FlexArray<int16_t> &&pcm, uint32_t speed);
+
+  // Returns the held back input at normal speed, for the end of a turn.
+  FlexArray<int16_t> Flush();
+
+  // Drops the held back input, for a new turn.
+  void Reset();
+
+  uint32_t sample_rate() const {
+    return sample_rate_;
+  }
+
+ private:
+  TimeStretcher(const TimeStretcher &) = delete;
+  TimeStretcher &operator=(const TimeStretcher &) = delete;
+
+  // Offset within the seek window where the input lines up best with the tail of the previous sequence.
+  size_t Seek() const;
+  float Score(const size_t offset) const;
+  void CrossFade(const int16_t *to, int16_t *output) const;
+
+  const uint32_t sample_rate_ = 0;
+  const size_t sequence_ = 0;  // samples per sequence
+  const size_t overlap_ = 0;   // samples cross-faded between sequences
+  const size_t seek_ = 0;      // samples a sequence may be shifted by
+  bool active_ = false;
+  std::vector<int16_t> input_;   // from the nominal start of the next sequence
+  std::vector<int16_t> tail_;    // the end of the previous sequence, cross-faded into the next
+  uint32_t skip_remainder_ = 0;  // Q16
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "tts_cache.h"
+
+#include <cstring>
+
+#ifndef CLOGGER_SEVERITY
+#define CLOGGER_SEVERITY CLOGGER_SEVERITY_WARN
+#endif
+#include "clogger/clogger.h"
+
+TtsCache::TtsCache(const Config &config) : config_(config) {
+}
+
+uint32_t TtsCache::Hash(const std::string &text) {
+  uint32_t hash = 2166136261u;
+  for (const auto c : text) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool TtsCache::Replay(const std::string &text, const std::function<void(Packet &&)> &sink) {
+  const auto [begin, end] = index_.equal_range(Hash(text));
+  for (auto it = begin; it != end; ++it) {
+    const auto entry = it->second;
+    if (entry->text != text) {
+      continue;
+    }
+
+    entries_.splice(entries_.begin(), entries_, entry);
+    const auto data = entry->data.data();
+    for (size_t offset = 0; offset < entry->data.size();) {
+      uint16_t size = 0;
+      std::memcpy(&size, data + offset, sizeof(size));
+      offset += sizeof(size);
+      Packet packet(size);
+      std::memcpy(packet.data(), data + offset, size);
+      offset += size;
+      sink(std::move(packet));
+    }
+    ++hit_count_;
+    return true;
+  }
+
+  ++miss_count_;
+  return false;
+}
+
+void TtsCache::BeginRecording(const std::string &text) {
+  recording_ = true;
+  recording_text_ = text;
+  recorded_.clear();
+  recorded_packets_ = 0;
+}
+
+void TtsCache::Record(const uint8_t *packet, const size_t size) {
+  if (!recording_) {
+    return;
+  }
+
+  if (++recorded_packets_ > config_.max_packets || recorded_.size() + sizeof(uint16_t) + size > config_.budget) {
+    CancelRecording();
+    return;
+  }
+
+  const auto packet_size = static_cast<uint16_t>(size);
+  const auto offset = recorded_.size();
+  recorded_.resize(offset + sizeof(packet_size) + size);
+  std::memcpy(recorded_.data() + offset, &packet_size, sizeof(packet_size));
+  std::memcpy(recorded_.data() + offset + sizeof(packet_size), packet, size);
+}
+
+void TtsCache::EndRecording() {
+  if (!recording_) {
+    return;
+  }
+  recording_ = false;
+
+  const auto hash = Hash(recording_text_);
+  const auto [begin, end] = index_.equal_range(hash);
+  for (auto it = begin; it != end; ++it) {
+    if (it->second->text == recording_text_) {
+      return;  // already cached
+    }
+  }
+
+  if (recorded_.empty()) {
+    return;
+  }
+
+  Evict(recorded_.size());
+  FlexArray<uint8_t> data(recorded_.size(), MemoryPlacement::kSpiram);
+  if (data.data() == nullptr) {
+    CLOGW("out of memory");
+    return;
+  }
+
+  std::memcpy(data.data(), recorded_.data(), recorded_.size());
+  entries_.push_front(Entry{std::move(recording_text_), std::move(data)});
+  index_.emplace(hash, entries_.begin());
+  size_ += recorded_.size();
+  CLOGI("cached %zu bytes, %zu in total", recorded_.size(), size_);
+  recorded_.clear();
+}
+
+void TtsCache::CancelRecording() {
+  recording_ = false;
+  recorded_.clear();
+}
+
+void TtsCache::Evict(const size_t needed) {
+  while (!entries_.empty() && size_ + needed > config_.budget) {
+    auto &entry = entries_.back();
+    const auto [begin, end] = index_.equal_range(Hash(entry.text));
+    for (auto it = begin; it != end; ++it) {
+      if (&(*it->second) == &entry) {
+        index_.erase(it);
+        break;
+      }
+    }
+    size_ -= entry.data.size();
+    entries_.pop_back();
+  }
+}
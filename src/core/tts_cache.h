@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef _TTS_CACHE_H_
+#define _TTS_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "flex_array/flex_array.h"
+#include "flex_array/packet.h"
+
+/**
+ * Keeps the Opus packets of recently spoken TTS sentences, keyed by the sentence text, so a sentence the server says
+ * again can be played from memory at once. The engine task records the packets that arrive between sentence_start and
+ * sentence_end, and replays a recorded sentence when the same text is announced again.
+ *
+ * Sentences are evicted least recently used first once the total size exceeds the budget. The packets live in PSRAM
+ * when available. Only called from the engine task.
+ */
+class TtsCache {
+ public:
+  struct Config {
+    size_t budget = 256 << 10;  // bytes of packets kept in total
+    uint32_t max_packets = 40;  // longer sentences are not kept, they have to fit into the jitter buffer at once
+  };
+
+  explicit TtsCache(const Config &config);
+
+  // FNV-1a of the text, also what the server is told on a hit.
+  static uint32_t Hash(const std::string &text);
+
+  // Hands every packet of the sentence to |sink| in order and marks it most recently used. False if it is not cached.
+  bool Replay(const std::string &text, const std::function<void(Packet &&)> &sink);
+
+  // Starts recording the sentence |text|, dropping a recording that was not finished.
+  void BeginRecording(const std::string &text);
+  void Record(const uint8_t *packet, const size_t size);
+  // Keeps the recording, unless it is empty, too long or larger than the budget.
+  void EndRecording();
+  void CancelRecording();
+
+  size_t size() const {
+    return size_;
+  }
+
+  uint32_t hit_count() const {
+    return hit_count_;
+  }
+
+  uint32_t miss_count() const {
+    return miss_count_;
+  }
+
+ private:
+  TtsCache(const TtsCache &) = delete;
+  TtsCache &operator=(const TtsCache &) = delete;
+
+  struct Entry {
+    std::string text;
+    FlexArray<uint8_t> data;  // packets, each prefixed with its 16-bit size
+  };
+
+  void Evict(const size_t needed);
+
+  const Config config_;
+  std::list<Entry> entries_;  // most recently used first
+  std::unordered_multimap<uint32_t, std::list<Entry>::iterator> index_;
+  size_t size_ = 0;
+  bool recording_ = false;
+  std::string recording_text_;
+  std::vector<uint8_t> recorded_;
+  uint32_t recorded_packets_ = 0;
+  uint32_t hit_count_ = 0;
+  uint32_t miss_count_ = 0;
+};
+
+#endif
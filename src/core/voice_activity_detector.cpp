@@ -0,0 +1,44 @@
+#include "voice_activity_detector.h"
+
+VoiceActivityDetector::VoiceActivityDetector(const Config &config, const uint32_t frame_duration)
+    : config_(config), hangover_frames_(frame_duration == 0 ? 0 : (config.hangover_ms + frame_duration - 1) / frame_duration) {
+  Reset();
+}
+
+bool VoiceActivityDetector::Process(const int16_t *pcm, const size_t samples) {
+  if (samples == 0) {
+    return hangover_remaining_ > 0;
+  }
+
+  uint32_t sum = 0;
+  for (size_t i = 0; i < samples; i++) {
+    const int32_t value = pcm[i];
+    sum += value < 0 ? -value : value;
+  }
+  const uint32_t level_q4 = (sum / samples) << 4;
+
+  const bool active = level_q4 >= (config_.min_speech_level << 4) &&
+                      static_cast<uint64_t>(level_q4) << 8 > static_cast<uint64_t>(noise_floor_q4_) * config_.threshold_ratio_q8;
+
+  // The floor follows quiet frames quickly and loud frames slowly, and barely moves while speech is going on.
+  if (level_q4 < noise_floor_q4_) {
+    noise_floor_q4_ -= (noise_floor_q4_ - level_q4) >> 2;
+  } else {
+    noise_floor_q4_ += (level_q4 - noise_floor_q4_) >> (active ? 9 : 6);
+  }
+
+  if (active) {
+    hangover_remaining_ = hangover_frames_ + 1;
+  }
+
+  if (hangover_remaining_ > 0) {
+    --hangover_remaining_;
+    return true;
+  }
+  return false;
+}
+
+void VoiceActivityDetector::Reset() {
+  noise_floor_q4_ = config_.min_speech_level << 4;
+  hangover_remaining_ = 0;
+}
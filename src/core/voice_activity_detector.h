@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef _VOICE_ACTIVITY_DETECTOR_H_
+#define _VOICE_ACTIVITY_DETECTOR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Lightweight fixed-point energy detector. A frame is speech when its mean absolute amplitude exceeds the tracked noise
+ * floor by |threshold_ratio_q8|, speech is then held for |hangover_ms| so word endings and short pauses are kept.
+ */
+class VoiceActivityDetector {
+ public:
+  struct Config {
+    uint32_t threshold_ratio_q8 = 3 << 8;  // level / noise floor ratio, Q8
+    uint32_t min_speech_level = 64;        // mean absolute amplitude, quieter frames are never speech
+    uint32_t hangover_ms = 1000;
+  };
+
+  VoiceActivityDetector(const Config &config, const uint32_t frame_duration);
+
+  // Returns true if the frame is speech or still inside the hangover of a previous speech frame.
+  bool Process(const int16_t *pcm, const size_t samples);
+
+  void Reset();
+
+  uint32_t noise_floor() const {
+    return noise_floor_q4_ >> 4;
+  }
+
+ private:
+  const Config config_;
+  const uint32_t hangover_frames_ = 0;
+  uint32_t noise_floor_q4_ = 0;
+  uint32_t hangover_remaining_ = 0;
+};
+
+#endif
@@ -4,13 +4,14 @@
 
 #include <esp_afe_config.h>
 #include <esp_afe_sr_models.h>
+#include <esp_heap_caps.h>
 #include <esp_wn_models.h>
 #include <model_path.h>
 
+#include <algorithm>
 #include <cstring>
 
 #include "core/flex_array/flex_array.h"
-#include "core/silk_resampler.h"
 
 #ifndef CLOGGER_SEVERITY
 #define CLOGGER_SEVERITY CLOGGER_SEVERITY_WARN
@@ -24,11 +25,16 @@ constexpr uint8_t kSrmodels[] = {
 #include "srmodels.bin"
 };
 
-constexpr uint32_t kSampleRate = 16000;
+constexpr uint32_t kSampleRate = AudioCaptureHub::kSampleRate;
+constexpr size_t kQueueBlocks = 8;
 }  // namespace
 
-WakeNet::WakeNet(std::function<void()> &&handler, std::shared_ptr<ai_vox::AudioInputDevice> audio_input_device)
-    : handler_(std::move(handler)), audio_input_device_(std::move(audio_input_device)) {
+WakeNet::WakeNet(std::function<void()> &&handler, std::shared_ptr<AudioCaptureHub> capture_hub)
+    : handler_(std::move(handler)),
+      capture_hub_(std::move(capture_hub)),
+      subscriber_(kQueueBlocks),
+      feed_chunk_(0),
+      pre_roll_capacity_(kSampleRate / 1000 * kPreRollDuration) {
   srmodel_list_t *models = srmodel_load(kSrmodels);
   if (models) {
     for (int i = 0; i < models->num; i++) {
@@ -52,75 +58,150 @@ WakeNet::WakeNet(std::function<void()> &&handler, std::shared_ptr<ai_vox::AudioI
     CLOGE("afe create failed");
     abort();
   }
+  feed_chunk_.Resize(g_afe_handle.get_feed_chunksize(afe_data_) * g_afe_handle.get_total_channel_num(afe_data_));
+
+  pre_roll_ = static_cast<int16_t *>(heap_caps_malloc(pre_roll_capacity_ * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+  if (pre_roll_ == nullptr) {
+    pre_roll_ = static_cast<int16_t *>(heap_caps_malloc(pre_roll_capacity_ * sizeof(int16_t), MALLOC_CAP_8BIT | MALLOC_CAP_DEFAULT));
+  }
+  assert(pre_roll_ != nullptr);
+
+  feed_task_ = new ActiveTaskQueue("WakeNetFeed", 8 * 1024, tskIDLE_PRIORITY + 1);
+  detect_task_ = new ActiveTaskQueue("WakeNetDetect", 4 * 1024, tskIDLE_PRIORITY + 1);
 }
 
 WakeNet::~WakeNet() {
-  Stop();
+  Pause();
+  delete feed_task_;
+  delete detect_task_;
   g_afe_handle.destroy(afe_data_);
+  heap_caps_free(pre_roll_);
 }
 
-void WakeNet::Start() {
+void WakeNet::Resume() {
   CLOGI();
 
-  if (detect_task_ != nullptr || feed_task_ != nullptr) {
-    CLOGD("WakeNet already started");
+  if (!paused_) {
+    CLOGD("WakeNet already resumed");
     return;
   }
 
-  audio_input_device_->OpenInput(kSampleRate);
+  MarkPreRoll();
+  g_afe_handle.reset_buffer(afe_data_);
+  feed_chunk_fill_ = 0;
+  subscriber_.Clear();
+  paused_ = false;
 
-  if (audio_input_device_->input_sample_rate() != kSampleRate) {
-    resampler_ = std::make_unique<SilkResampler>(audio_input_device_->input_sample_rate(), kSampleRate);
-  }
+  const auto run = run_.load();
+  feed_task_->Enqueue([this, run]() mutable { FeedData(run); });
+  detect_task_->Enqueue([this, run]() { DetectWakeWord(run); });
+  capture_hub_->Attach(&subscriber_);
+  CLOGI("OK");
+}
 
-  feed_task_ = new ActiveTaskQueue("WakeNetFeed", 8 * 1024, tskIDLE_PRIORITY + 1);
-  detect_task_ = new ActiveTaskQueue("WakeNetDetect", 4 * 1024, tskIDLE_PRIORITY + 1);
+void WakeNet::Pause() {
+  if (paused_) {
+    return;
+  }
 
-  feed_task_->Enqueue(
-      [this, samples = g_afe_handle.get_feed_chunksize(afe_data_) * g_afe_handle.get_total_channel_num(afe_data_)]() mutable { FeedData(samples); });
-  detect_task_->Enqueue([this]() { DetectWakeWord(); });
+  paused_ = true;
+  ++run_;
+  subscriber_.Interrupt();
+  feed_task_->Sync();
+  detect_task_->Sync();
+  capture_hub_->Detach(&subscriber_);
+  subscriber_.Clear();
   CLOGI("OK");
 }
 
-void WakeNet::Stop() {
-  delete feed_task_;
-  feed_task_ = nullptr;
-
-  delete detect_task_;
-  detect_task_ = nullptr;
+void WakeNet::Suspend() {
+  if (paused_) {
+    return;
+  }
 
-  resampler_.reset();
-  audio_input_device_->CloseInput();
+  ++run_;
+  subscriber_.Interrupt();
+  feed_task_->Sync();
+  detect_task_->Sync();
   CLOGI("OK");
 }
 
-void WakeNet::FeedData(const uint32_t samples) {
-  auto pcm = ReadPcm(samples);
-  g_afe_handle.feed(afe_data_, pcm.data());
+void WakeNet::FeedData(const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
 
-  feed_task_->Enqueue([this, samples]() mutable { FeedData(samples); });
+  if (const auto block = subscriber_.Pop(pdMS_TO_TICKS(AudioCaptureHub::kBlockDuration * 4))) {
+    WritePreRoll(block.data(), block.size());
+    for (size_t offset = 0; offset < block.size();) {
+      const auto count = std::min(block.size() - offset, feed_chunk_.size() - feed_chunk_fill_);
+      memcpy(feed_chunk_.data() + feed_chunk_fill_, block.data() + offset, count * sizeof(int16_t));
+      feed_chunk_fill_ += count;
+      offset += count;
+      if (feed_chunk_fill_ == feed_chunk_.size()) {
+        feed_chunk_fill_ = 0;
+        g_afe_handle.feed(afe_data_, feed_chunk_.data());
+      }
+    }
+  }
+
+  feed_task_->Enqueue([this, run]() mutable { FeedData(run); });
 }
 
-void WakeNet::DetectWakeWord() {
+void WakeNet::DetectWakeWord(const uint32_t run) {
+  if (run != run_) {
+    return;
+  }
+
   afe_fetch_result_t *res = g_afe_handle.fetch(afe_data_);
   if (res != nullptr && res->wakeup_state == WAKENET_DETECTED) {
     CLOGI("Wake word detected");
+    MarkPreRoll();
     if (handler_) {
       handler_();
     }
   }
   taskYIELD();
-  detect_task_->Enqueue([this]() { DetectWakeWord(); });
+  detect_task_->Enqueue([this, run]() { DetectWakeWord(run); });
 }
 
-FlexArray<int16_t> WakeNet::ReadPcm(const uint32_t samples) {
-  FlexArray<int16_t> pcm(samples);
-  audio_input_device_->Read(pcm.data(), pcm.size());
-  if (resampler_) {
-    return resampler_->Resample(std::move(pcm));
-  } else {
-    return pcm;
+FlexArray<int16_t> WakeNet::TakePreRoll(const uint32_t end_sequence) {
+  // The feed task is stopped, what it left queued was captured after everything already in the pre-roll.
+  while (subscriber_.lag() > 0) {
+    const auto block = subscriber_.Pop(0);
+    if (static_cast<int32_t>(block.sequence() - end_sequence) >= 0) {
+      break;
+    }
+    WritePreRoll(block.data(), block.size());
   }
+  subscriber_.Clear();
+
+  std::lock_guard lock(pre_roll_mutex_);
+  const auto samples = static_cast<size_t>(std::min<uint64_t>(pre_roll_end_ - pre_roll_begin_, pre_roll_capacity_));
+  FlexArray<int16_t> pcm(samples);
+  const auto begin = static_cast<size_t>((pre_roll_end_ - samples) % pre_roll_capacity_);
+  const auto first = std::min(samples, pre_roll_capacity_ - begin);
+  memcpy(pcm.data(), pre_roll_ + begin, first * sizeof(int16_t));
+  memcpy(pcm.data() + first, pre_roll_, (samples - first) * sizeof(int16_t));
+  pre_roll_begin_ = pre_roll_end_;
+  return pcm;
+}
+
+void WakeNet::WritePreRoll(const int16_t *pcm, const size_t samples) {
+  // Only the newest |pre_roll_capacity_| samples can survive, older ones are overwritten.
+  const auto skipped = samples > pre_roll_capacity_ ? samples - pre_roll_capacity_ : 0;
+  const auto count = samples - skipped;
+  std::lock_guard lock(pre_roll_mutex_);
+  const auto begin = static_cast<size_t>((pre_roll_end_ + skipped) % pre_roll_capacity_);
+  const auto first = std::min(count, pre_roll_capacity_ - begin);
+  memcpy(pre_roll_ + begin, pcm + skipped, first * sizeof(int16_t));
+  memcpy(pre_roll_, pcm + skipped + first, (count - first) * sizeof(int16_t));
+  pre_roll_end_ += samples;
+}
+
+void WakeNet::MarkPreRoll() {
+  std::lock_guard lock(pre_roll_mutex_);
+  pre_roll_begin_ = pre_roll_end_;
 }
 
 #endif  // ARDUINO_ESP32S3_DEV
\ No newline at end of file
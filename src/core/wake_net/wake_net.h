@@ -3,36 +3,59 @@
 #ifndef _WAKE_NET_H_
 #define _WAKE_NET_H_
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 
-#include "audio_device/audio_input_device.h"
 #include "components/task_queue/active_task_queue.h"
+#include "core/audio_capture_hub.h"
 #include "core/flex_array/flex_array.h"
 
 struct esp_afe_sr_data_t;
-class SilkResampler;
 
 class WakeNet {
  public:
-  explicit WakeNet(std::function<void()>&& handler, std::shared_ptr<ai_vox::AudioInputDevice> audio_input_device);
+  static constexpr uint32_t kPreRollDuration = 1500;  // ms, covers the websocket and TLS handshake after the wake word
+
+  explicit WakeNet(std::function<void()>&& handler, std::shared_ptr<AudioCaptureHub> capture_hub);
   ~WakeNet();
-  void Start();
-  void Stop();
+
+  // Created paused. Pause() stops feeding and detection and unsubscribes from capture, the AFE and both tasks stay
+  // allocated.
+  void Resume();
+  void Pause();
+
+  // Stops feeding and detection but stays subscribed, so capture keeps queueing up for TakePreRoll(). Pause() lets go.
+  void Suspend();
+
+  // After Suspend(). Audio captured since the last wake word, up to the pre-roll capacity, and up to but not including
+  // block |end_sequence|, where the subscriber taking over from wake net starts. Queued blocks from there on are dropped.
+  FlexArray<int16_t> TakePreRoll(const uint32_t end_sequence);
 
  private:
   WakeNet(const WakeNet&) = delete;
   WakeNet& operator=(const WakeNet&) = delete;
-  void FeedData(const uint32_t samples);
-  void DetectWakeWord();
-  FlexArray<int16_t> ReadPcm(const uint32_t samples);
+  void FeedData(const uint32_t run);
+  void DetectWakeWord(const uint32_t run);
+  void WritePreRoll(const int16_t* pcm, const size_t samples);
+  void MarkPreRoll();
 
   std::function<void()> handler_;
-  std::shared_ptr<ai_vox::AudioInputDevice> audio_input_device_;
+  std::shared_ptr<AudioCaptureHub> capture_hub_;
+  AudioCaptureHub::Subscriber subscriber_;
   ActiveTaskQueue* detect_task_ = nullptr;
   ActiveTaskQueue* feed_task_ = nullptr;
-  std::unique_ptr<SilkResampler> resampler_;
   esp_afe_sr_data_t* afe_data_ = nullptr;
+  FlexArray<int16_t> feed_chunk_;  // capture blocks are regrouped into chunks of the size the AFE expects
+  size_t feed_chunk_fill_ = 0;
+  bool paused_ = true;
+  std::atomic<uint32_t> run_ = 0;
+  std::mutex pre_roll_mutex_;
+  int16_t* pre_roll_ = nullptr;
+  const size_t pre_roll_capacity_ = 0;
+  uint64_t pre_roll_begin_ = 0;  // total samples written when the pre-roll was last marked
+  uint64_t pre_roll_end_ = 0;    // total samples written
 };
 
 #endif  // _WAKE_NET_H_
\ No newline at end of file
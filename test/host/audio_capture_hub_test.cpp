@@ -0,0 +1,139 @@
+#include "audio_capture_hub.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "audio_input_device_mock.h"
+
+namespace {
+constexpr TickType_t kPopTimeout = pdMS_TO_TICKS(1000);
+// Half the duration of the mock's 240-sample frames at 16 kHz: faster than real time, yet the hub's task can fall 40 ms
+// behind on a loaded host before the 80 ms stream buffer overflows.
+constexpr auto kFeedInterval = std::chrono::microseconds(7500);
+
+// Calls DeliverFrame() every |kFeedInterval| while alive, like the receive interrupt would.
+class FrameFeeder {
+ public:
+  explicit FrameFeeder(ai_vox::MockAudioInputDevice &device)
+      : thread_([this, &device]() {
+          auto next = std::chrono::steady_clock::now();
+          while (!stop_) {
+            device.DeliverFrame();
+            next += kFeedInterval;
+            std::this_thread::sleep_until(next);
+          }
+        }) {
+  }
+
+  ~FrameFeeder() {
+    stop_ = true;
+    thread_.join();
+  }
+
+ private:
+  std::atomic<bool> stop_ = false;
+  std::thread thread_;
+};
+
+// Every sample of |block| is one more than the one before, starting at |*expected|.
+void ExpectRamp(const AudioBlockRef &block, int16_t *expected) {
+  for (size_t i = 0; i < block.size(); i++) {
+    ASSERT_EQ(block.data()[i], *expected) << "sample " << i << " of block " << block.sequence();
+    ++*expected;
+  }
+}
+}  // namespace
+
+TEST(AudioCaptureHubTest, PushModeDeliversTheRampInOrder) {
+  auto device = std::make_shared<ai_vox::MockAudioInputDevice>(AudioCaptureHub::kSampleRate);
+  AudioCaptureHub hub(device);
+  AudioCaptureHub::Subscriber subscriber(64);
+  hub.Attach(&subscriber);
+  EXPECT_EQ(subscriber.first_sequence(), 0u);
+
+  {
+    FrameFeeder feeder(*device);
+    int16_t expected = 0;
+    for (uint32_t sequence = 0; sequence < 50; sequence++) {
+      const auto block = subscriber.Pop(kPopTimeout);
+      ASSERT_TRUE(block);
+      ASSERT_EQ(block.size(), AudioCaptureHub::kBlockSamples);
+      EXPECT_EQ(block.sequence(), sequence);
+      ExpectRamp(block, &expected);
+    }
+  }
+
+  hub.Detach(&subscriber);
+  EXPECT_EQ(device->dropped_frames(), 0u);
+  EXPECT_EQ(subscriber.overrun_count(), 0u);
+}
+
+TEST(AudioCaptureHubTest, LateSubscriberStartsAtItsFirstSequence) {
+  auto device = std::make_shared<ai_vox::MockAudioInputDevice>(AudioCaptureHub::kSampleRate);
+  AudioCaptureHub hub(device);
+  AudioCaptureHub::Subscriber early(64);
+  AudioCaptureHub::Subscriber late(64);
+  hub.Attach(&early);
+
+  FrameFeeder feeder(*device);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(early.Pop(kPopTimeout));
+  }
+  hub.Attach(&late);
+  const auto seam = late.first_sequence();
+
+  // The early subscriber's blocks before the seam and the late one's from it are a single unbroken capture.
+  int16_t expected = static_cast<int16_t>(10 * AudioCaptureHub::kBlockSamples);
+  for (uint32_t sequence = 10; sequence < seam; sequence++) {
+    const auto block = early.Pop(kPopTimeout);
+    ASSERT_TRUE(block);
+    ASSERT_EQ(block.sequence(), sequence);
+    ExpectRamp(block, &expected);
+  }
+  for (uint32_t sequence = seam; sequence < seam + 10; sequence++) {
+    const auto block = late.Pop(kPopTimeout);
+    ASSERT_TRUE(block);
+    ASSERT_EQ(block.sequence(), sequence);
+    ExpectRamp(block, &expected);
+  }
+
+  hub.Detach(&late);
+  hub.Detach(&early);
+}
+
+TEST(AudioCaptureHubTest, InterruptIsNotAnUnderrun) {
+  auto device = std::make_shared<ai_vox::MockAudioInputDevice>(AudioCaptureHub::kSampleRate);
+  AudioCaptureHub hub(device);
+  AudioCaptureHub::Subscriber subscriber(8);
+  hub.Attach(&subscriber);
+
+  // No frames are delivered, so the only way out of Pop() is a timeout or an interrupt.
+  subscriber.Interrupt();
+  EXPECT_FALSE(subscriber.Pop(kPopTimeout));
+  EXPECT_EQ(subscriber.underrun_count(), 0u);
+
+  EXPECT_FALSE(subscriber.Pop(pdMS_TO_TICKS(10)));
+  EXPECT_EQ(subscriber.underrun_count(), 1u);
+
+  hub.Detach(&subscriber);
+  EXPECT_FALSE(subscriber.Pop(pdMS_TO_TICKS(10)));
+  EXPECT_EQ(subscriber.underrun_count(), 1u);
+}
+
+TEST(AudioCaptureHubTest, PolledDeviceIsResampled) {
+  auto device = std::make_shared<ai_vox::MockAudioInputDevice>(48000, 0);
+  AudioCaptureHub hub(device);
+  AudioCaptureHub::Subscriber subscriber(4);
+  hub.Attach(&subscriber);
+
+  const auto block = subscriber.Pop(kPopTimeout);
+  ASSERT_TRUE(block);
+  EXPECT_EQ(block.size(), AudioCaptureHub::kBlockSamples);
+  EXPECT_FALSE(device->DeliverFrame());
+
+  hub.Detach(&subscriber);
+}
@@ -0,0 +1,92 @@
+#include "audio_output_engine.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <vector>
+
+#include "opus_host.h"
+
+namespace {
+constexpr uint32_t kFrameDuration = 60;  // ms
+constexpr uint32_t kFrames = 10;
+
+class RecordingOutputDevice : public ai_vox::AudioOutputDevice {
+ public:
+  explicit RecordingOutputDevice(const uint32_t sample_rate) : sample_rate_(sample_rate) {
+  }
+
+  bool OpenOutput(uint32_t sample_rate) override {
+    return true;
+  }
+
+  void CloseOutput() override {
+  }
+
+  size_t Write(const int16_t *pcm, size_t samples) override {
+    std::lock_guard lock(mutex_);
+    played_.insert(played_.end(), pcm, pcm + samples);
+    return samples;
+  }
+
+  void set_volume(uint16_t volume) override {
+  }
+
+  uint16_t volume() const override {
+    return kMaxVolume;
+  }
+
+  uint32_t output_sample_rate() override {
+    return sample_rate_;
+  }
+
+  std::vector<int16_t> played() {
+    std::lock_guard lock(mutex_);
+    return played_;
+  }
+
+ private:
+  const uint32_t sample_rate_ = 0;
+  std::mutex mutex_;
+  std::vector<int16_t> played_;
+};
+
+// Plays |kFrames| packets as one turn on a device at |sample_rate|, returns what the device got.
+std::vector<int16_t> PlayTurn(const uint32_t sample_rate) {
+  auto device = std::make_shared<RecordingOutputDevice>(sample_rate);
+  AudioOutputEngine::Config config;
+  config.jitter_buffer.frame_duration = kFrameDuration;
+  AudioOutputEngine engine(device, kFrameDuration, config);
+  engine.Resume();
+  for (uint32_t i = 0; i < kFrames; i++) {
+    Packet packet(1);
+    packet.data()[0] = HostOpusPacket(kFrameDuration);
+    engine.Write(std::move(packet));
+  }
+
+  std::promise<void> ended;
+  engine.NotifyDataEnd([&ended]() { ended.set_value(); });
+  EXPECT_EQ(ended.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  engine.Pause();
+  return device->played();
+}
+}  // namespace
+
+// 16 kHz is an Opus rate, the decoder runs at it and its output reaches the device untouched.
+TEST(AudioOutputEngineTest, DecodesAtAnOpusDeviceRate) {
+  const auto played = PlayTurn(16000);
+  EXPECT_EQ(HostOpusDecoderSampleRate(), 16000);
+  ASSERT_EQ(played.size(), kFrames * 16 * kFrameDuration);
+  for (size_t i = 0; i < played.size(); i++) {
+    ASSERT_EQ(played[i], static_cast<int16_t>(played[0] + i)) << "sample " << i;
+  }
+}
+
+TEST(AudioOutputEngineTest, ResamplesForOtherDeviceRates) {
+  const auto played = PlayTurn(44100);
+  EXPECT_EQ(HostOpusDecoderSampleRate(), 24000);
+  // All of it but the resampler's delay.
+  EXPECT_NEAR(static_cast<double>(played.size()), kFrames * 44.1 * kFrameDuration, 44.1 * kFrameDuration / 2);
+}
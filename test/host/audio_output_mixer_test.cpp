@@ -0,0 +1,122 @@
+#include "audio_device/audio_output_mixer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr uint32_t kSampleRate = 16000;
+
+// Records what is played, taking the real time to play it like a device with a DMA queue would.
+class RecordingOutputDevice : public ai_vox::AudioOutputDevice {
+ public:
+  bool OpenOutput(uint32_t sample_rate) override {
+    return true;
+  }
+
+  void CloseOutput() override {
+  }
+
+  size_t Write(const int16_t *pcm, size_t samples) override {
+    {
+      std::lock_guard lock(mutex_);
+      played_.insert(played_.end(), pcm, pcm + samples);
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(samples * 1000000 / kSampleRate));
+    return samples;
+  }
+
+  void set_volume(uint16_t volume) override {
+  }
+
+  uint16_t volume() const override {
+    return kMaxVolume;
+  }
+
+  uint32_t output_sample_rate() override {
+    return kSampleRate;
+  }
+
+  bool WaitForDrained(const uint32_t timeout_ms) override {
+    return true;
+  }
+
+  std::vector<int16_t> played() {
+    std::lock_guard lock(mutex_);
+    return played_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<int16_t> played_;
+};
+}  // namespace
+
+// A source written in small pieces plays under one that always has a full buffer of silence. Whatever the two have
+// queued, the first one's audio has to come out in one piece.
+TEST(AudioOutputMixerTest, ShortSourceGetsNoGaps) {
+  constexpr int16_t kSamples = 16000;
+  auto device = std::make_shared<RecordingOutputDevice>();
+  auto mixer = std::make_shared<ai_vox::AudioOutputMixer>(device, kSampleRate);
+  auto speech = mixer->CreateSource({});
+  auto music = mixer->CreateSource({});
+  speech->OpenOutput(kSampleRate);
+  music->OpenOutput(kSampleRate);
+
+  std::atomic<bool> stop = false;
+  std::thread silence([&music, &stop]() {
+    const std::vector<int16_t> zeros(160, 0);
+    while (!stop) {
+      music->Write(zeros.data(), zeros.size());
+    }
+  });
+
+  // 37 samples every 2 ms is a little faster than they play, so the source's buffer is rarely full or empty.
+  std::vector<int16_t> ramp(kSamples);
+  for (int16_t i = 0; i < kSamples; i++) {
+    ramp[i] = i + 1;
+  }
+  // Paced against the clock, so a sleep running late does not make the writer fall behind for good.
+  auto next = std::chrono::steady_clock::now();
+  for (size_t offset = 0; offset < ramp.size(); offset += 37) {
+    speech->Write(ramp.data() + offset, std::min<size_t>(37, ramp.size() - offset));
+    next += std::chrono::milliseconds(2);
+    std::this_thread::sleep_until(next);
+  }
+
+  // Well before the timeout, with room for a loaded host.
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(speech->WaitForDrained(1000));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+
+  stop = true;
+  silence.join();
+  speech->CloseOutput();
+  music->CloseOutput();
+
+  const auto played = device->played();
+  const auto begin = std::find(played.begin(), played.end(), 1);
+  ASSERT_NE(begin, played.end());
+  ASSERT_GE(played.end() - begin, kSamples);
+  EXPECT_TRUE(std::equal(ramp.begin(), ramp.end(), begin));
+}
+
+TEST(AudioOutputMixerTest, WaitForDrainedReturnsOnceTheLastChunkIsWritten) {
+  auto device = std::make_shared<RecordingOutputDevice>();
+  auto mixer = std::make_shared<ai_vox::AudioOutputMixer>(device, kSampleRate);
+  auto source = mixer->CreateSource({});
+  source->OpenOutput(kSampleRate);
+
+  const std::vector<int16_t> pcm(kSampleRate / 10, 1000);
+  source->Write(pcm.data(), pcm.size());
+  EXPECT_TRUE(source->WaitForDrained(1000));
+  EXPECT_EQ(device->played().size(), pcm.size());
+
+  source->CloseOutput();
+  EXPECT_FALSE(source->WaitForDrained(10));
+}
@@ -0,0 +1,243 @@
+#include "jitter_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+constexpr uint32_t kFrameDuration = 60;  // ms
+
+Packet Numbered(const uint16_t number) {
+  Packet packet(sizeof(number));
+  std::memcpy(packet.data(), &number, sizeof(number));
+  return packet;
+}
+
+uint16_t NumberOf(const Packet &packet) {
+  uint16_t number = 0;
+  std::memcpy(&number, packet.data(), sizeof(number));
+  return number;
+}
+
+constexpr int kConcealed = -1;
+
+// Replays packets arriving at |arrivals_ms| (packet i at arrivals_ms[i]) against a playout that pops a frame every
+// |kFrameDuration| ms while playing and polls every ms while waiting, like the decode task. Marks the end of the turn
+// after the last arrival. Returns the packet numbers played in order, kConcealed for a concealed frame.
+std::vector<int> Replay(JitterBuffer &buffer, const std::vector<int64_t> &arrivals_ms, uint32_t *target_depth_max = nullptr) {
+  std::vector<int> played;
+  size_t next = 0;
+  int64_t next_pop_ms = 0;
+  for (int64_t now_ms = 0;; now_ms++) {
+    while (next < arrivals_ms.size() && arrivals_ms[next] <= now_ms) {
+      buffer.Push(Numbered(static_cast<uint16_t>(next)), arrivals_ms[next] * 1000);
+      if (++next == arrivals_ms.size()) {
+        buffer.MarkEnd();
+      }
+    }
+    if (target_depth_max != nullptr) {
+      *target_depth_max = std::max(*target_depth_max, buffer.target_depth());
+    }
+    if (now_ms < next_pop_ms) {
+      continue;
+    }
+
+    std::optional<Packet> packet;
+    switch (buffer.Pop(&packet)) {
+      case JitterBuffer::Action::kPlay:
+        played.push_back(NumberOf(*packet));
+        next_pop_ms = now_ms + kFrameDuration;
+        break;
+      case JitterBuffer::Action::kConceal:
+        played.push_back(kConcealed);
+        next_pop_ms = now_ms + kFrameDuration;
+        break;
+      case JitterBuffer::Action::kWait:
+        next_pop_ms = now_ms + 1;
+        break;
+      case JitterBuffer::Action::kDrained:
+        return played;
+    }
+  }
+}
+
+std::vector<int64_t> Steady(const size_t packets, const int64_t start_ms = 0) {
+  std::vector<int64_t> arrivals(packets);
+  for (size_t i = 0; i < packets; i++) {
+    arrivals[i] = start_ms + static_cast<int64_t>(i) * kFrameDuration;
+  }
+  return arrivals;
+}
+
+std::vector<int> Sequence(const int first, const int end) {
+  std::vector<int> numbers;
+  for (int i = first; i < end; i++) {
+    numbers.push_back(i);
+  }
+  return numbers;
+}
+
+JitterBuffer::Config TestConfig() {
+  JitterBuffer::Config config;
+  config.frame_duration = kFrameDuration;
+  return config;
+}
+}  // namespace
+
+TEST(JitterBufferTest, SteadyArrivalsPlayInOrderAtTheStartThreshold) {
+  JitterBuffer buffer(TestConfig());
+  uint32_t target_depth_max = 0;
+  EXPECT_EQ(Replay(buffer, Steady(100), &target_depth_max), Sequence(0, 100));
+  EXPECT_EQ(target_depth_max, TestConfig().start_threshold);
+  EXPECT_EQ(buffer.underrun_count(), 0u);
+  EXPECT_EQ(buffer.concealed_count(), 0u);
+  EXPECT_EQ(buffer.late_count(), 0u);
+  EXPECT_EQ(buffer.dropped_count(), 0u);
+}
+
+// For a while the packets come in bursts of four, 240 ms apart, then steady again: the target grows with the jitter,
+// within its bound, and comes back down once the network settles.
+TEST(JitterBufferTest, TargetDepthFollowsTheJitter) {
+  const auto config = TestConfig();
+  JitterBuffer buffer(config);
+  std::vector<int64_t> arrivals = Steady(300);
+  for (size_t i = 20; i < 120; i++) {
+    arrivals[i] = arrivals[i / 4 * 4 + 3];
+  }
+
+  uint32_t target_depth_max = 0;
+  const auto played = Replay(buffer, arrivals, &target_depth_max);
+  EXPECT_GT(target_depth_max, config.start_threshold);
+  RecordProperty("target_depth_max", std::to_string(target_depth_max));
+  EXPECT_LE(target_depth_max, config.max_target_depth);
+  EXPECT_LE(buffer.target_depth(), config.start_threshold + kFrameDuration / 2);
+
+  // Nothing is lost or played twice, whatever was concealed is made up for by dropping the late packets.
+  std::vector<int> numbers;
+  for (const auto number : played) {
+    if (number != kConcealed) {
+      numbers.push_back(number);
+    }
+  }
+  EXPECT_TRUE(std::is_sorted(numbers.begin(), numbers.end()));
+  EXPECT_EQ(std::adjacent_find(numbers.begin(), numbers.end()), numbers.end());
+  EXPECT_EQ(numbers.size() + buffer.late_count(), arrivals.size());
+}
+
+TEST(JitterBufferTest, TargetDepthStopsAtItsUpperBound) {
+  auto config = TestConfig();
+  config.max_target_depth = 300;
+  JitterBuffer buffer(config);
+  std::vector<int64_t> arrivals;
+  // Pairs of packets a second apart: every other one is 940 ms late.
+  for (int64_t i = 0; i < 40; i++) {
+    arrivals.push_back(i * 1000);
+    arrivals.push_back(i * 1000);
+  }
+  uint32_t target_depth_max = 0;
+  Replay(buffer, arrivals, &target_depth_max);
+  EXPECT_EQ(target_depth_max, config.max_target_depth);
+}
+
+// A 600 ms gap mid-turn: |max_conceal| worth of frames is concealed, then playout rebuffers. The packets of the
+// concealed frames are dropped when they show up, the rest play on in order.
+TEST(JitterBufferTest, GapIsConcealedUpToTheLimitThenRebuffers) {
+  const auto config = TestConfig();
+  JitterBuffer buffer(config);
+  auto arrivals = Steady(40);
+  for (size_t i = 20; i < arrivals.size(); i++) {
+    arrivals[i] += 600;
+  }
+  const auto played = Replay(buffer, arrivals);
+
+  constexpr int kConcealLimit = 120 / kFrameDuration;
+  const auto first_concealed = std::find(played.begin(), played.end(), kConcealed);
+  ASSERT_NE(first_concealed, played.end());
+  EXPECT_EQ(std::count(played.begin(), played.end(), kConcealed), kConcealLimit);
+  EXPECT_EQ(std::vector<int>(played.begin(), first_concealed), Sequence(0, first_concealed - played.begin()));
+
+  const auto resumed = first_concealed + kConcealLimit;
+  const int first_after = first_concealed - played.begin() + kConcealLimit;
+  EXPECT_EQ(std::vector<int>(resumed, played.end()), Sequence(first_after, 40));
+  EXPECT_EQ(buffer.underrun_count(), 1u);
+  EXPECT_EQ(buffer.concealed_count(), static_cast<uint32_t>(kConcealLimit));
+  EXPECT_EQ(buffer.late_count(), static_cast<uint32_t>(kConcealLimit));
+}
+
+// A stalled connection delivering 4 s at once: the oldest packets beyond |max_depth| go, the newest ones play.
+TEST(JitterBufferTest, BurstBeyondMaxDepthDropsTheOldest) {
+  const auto config = TestConfig();
+  JitterBuffer buffer(config);
+  std::vector<int64_t> arrivals(4000 / kFrameDuration, 0);
+  const auto played = Replay(buffer, arrivals);
+
+  const int dropped = static_cast<int>(arrivals.size() - config.max_depth / kFrameDuration);
+  EXPECT_EQ(buffer.dropped_count(), static_cast<uint32_t>(dropped));
+  EXPECT_EQ(played, Sequence(dropped, arrivals.size()));
+}
+
+TEST(JitterBufferTest, LocalPacketsDoNotCountTowardsTheDepth) {
+  JitterBuffer buffer(TestConfig());
+  for (uint16_t i = 0; i < 10; i++) {
+    buffer.PushLocal(Numbered(i));
+  }
+  EXPECT_EQ(buffer.depth(), 0u);
+  buffer.Push(Numbered(10), 0);
+  EXPECT_EQ(buffer.depth(), kFrameDuration);
+
+  std::optional<Packet> packet;
+  ASSERT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kPlay);
+  EXPECT_EQ(NumberOf(*packet), 0);
+}
+
+TEST(JitterBufferTest, MarkEndPlaysWhatIsBelowTheThreshold) {
+  JitterBuffer buffer(TestConfig());
+  std::optional<Packet> packet;
+  buffer.Push(Numbered(0), 0);
+  EXPECT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kWait);
+
+  buffer.MarkEnd();
+  ASSERT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kPlay);
+  EXPECT_EQ(NumberOf(*packet), 0);
+  EXPECT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kDrained);
+  // The next turn waits for its threshold again.
+  EXPECT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kWait);
+}
+
+TEST(JitterBufferTest, FlushKeepsAPendingEnd) {
+  JitterBuffer buffer(TestConfig());
+  std::optional<Packet> packet;
+  for (uint16_t i = 0; i < 5; i++) {
+    buffer.Push(Numbered(i), i * kFrameDuration * 1000);
+  }
+  buffer.Flush();
+  EXPECT_EQ(buffer.depth(), 0u);
+  EXPECT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kWait);
+
+  buffer.Push(Numbered(5), 5 * kFrameDuration * 1000);
+  buffer.MarkEnd();
+  buffer.Flush();
+  EXPECT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kDrained);
+}
+
+// A turn that ends while frames were being concealed owes nothing to the next one.
+TEST(JitterBufferTest, DrainForgetsTheConcealedFrames) {
+  JitterBuffer buffer(TestConfig());
+  std::optional<Packet> packet;
+  for (uint16_t i = 0; i < 2; i++) {
+    buffer.Push(Numbered(i), i * kFrameDuration * 1000);
+  }
+  EXPECT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kPlay);
+  EXPECT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kPlay);
+  EXPECT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kConceal);
+  buffer.MarkEnd();
+  EXPECT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kDrained);
+
+  buffer.Push(Numbered(100), 10000000);
+  buffer.MarkEnd();
+  ASSERT_EQ(buffer.Pop(&packet), JitterBuffer::Action::kPlay);
+  EXPECT_EQ(NumberOf(*packet), 100);
+  EXPECT_EQ(buffer.late_count(), 0u);
+}
@@ -0,0 +1,170 @@
+#include "opus_bitrate_controller.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+
+#include "libopus/opus_defines.h"
+
+namespace {
+constexpr uint32_t kFrameDuration = 60;  // ms
+
+OpusBitrateController::Config MakeConfig() {
+  OpusBitrateController::Config config;
+  config.frame_duration = kFrameDuration;
+  return config;
+}
+
+// The network task in front of a link of limited capacity: the encoder queues one packet per frame at the current
+// bitrate, the network task sends them one at a time and reports each send to the controller.
+class SlowSink {
+ public:
+  SlowSink(OpusBitrateController &controller, const size_t queue_limit) : controller_(controller), queue_limit_(queue_limit) {
+  }
+
+  void Run(const uint32_t duration_ms, const uint32_t link_bps) {
+    const int64_t end_us = now_us_ + static_cast<int64_t>(duration_ms) * 1000;
+    while (next_frame_us_ < end_us) {
+      while (next_frame_us_ <= now_us_) {
+        if (queue_.size() < queue_limit_) {
+          queue_.push_back(static_cast<int64_t>(controller_.bitrate()) * kFrameDuration / 1000);
+        } else {
+          ++dropped_count_;
+          controller_.ReportDrop();
+        }
+        next_frame_us_ += kFrameDuration * 1000;
+      }
+
+      if (queue_.empty()) {
+        now_us_ = next_frame_us_;
+        continue;
+      }
+
+      const auto bits = queue_.front();
+      queue_.pop_front();
+      const auto send_time_us = static_cast<uint32_t>(bits * 1000000 / link_bps);
+      now_us_ += send_time_us;
+      sent_bits_ += bits;
+      max_queue_depth_ = std::max(max_queue_depth_, queue_.size());
+      controller_.ReportSend(send_time_us, queue_.size());
+    }
+  }
+
+  void ResetStats() {
+    sent_bits_ = 0;
+    dropped_count_ = 0;
+    max_queue_depth_ = 0;
+  }
+
+  int64_t sent_bits() const {
+    return sent_bits_;
+  }
+
+  uint32_t dropped_count() const {
+    return dropped_count_;
+  }
+
+  size_t max_queue_depth() const {
+    return max_queue_depth_;
+  }
+
+ private:
+  OpusBitrateController &controller_;
+  const size_t queue_limit_ = 0;
+  std::deque<int64_t> queue_;  // bits per queued packet
+  int64_t now_us_ = 0;
+  int64_t next_frame_us_ = 0;
+  int64_t sent_bits_ = 0;
+  uint32_t dropped_count_ = 0;
+  size_t max_queue_depth_ = 0;
+};
+}  // namespace
+
+TEST(OpusBitrateControllerTest, StartsAtTheInitialBitrate) {
+  OpusBitrateController controller(MakeConfig());
+  EXPECT_EQ(controller.bitrate(), 24000);
+  EXPECT_EQ(controller.bandwidth(), OPUS_BANDWIDTH_WIDEBAND);
+  EXPECT_EQ(controller.packet_loss_perc(), 0);
+  EXPECT_EQ(controller.revision(), 1u);
+}
+
+TEST(OpusBitrateControllerTest, HealthySendsStepUpToTheMaximum) {
+  const auto config = MakeConfig();
+  OpusBitrateController controller(config);
+  for (uint32_t i = 0; i < config.increase_interval - 1; i++) {
+    controller.ReportSend(1000, 0);
+  }
+  EXPECT_EQ(controller.bitrate(), config.initial_bitrate);
+
+  const auto revision = controller.revision();
+  controller.ReportSend(1000, 0);
+  EXPECT_EQ(controller.bitrate(), config.initial_bitrate + config.increase_step);
+  EXPECT_NE(controller.revision(), revision);
+
+  for (uint32_t i = 0; i < config.increase_interval * 10; i++) {
+    controller.ReportSend(1000, 0);
+  }
+  EXPECT_EQ(controller.bitrate(), config.max_bitrate);
+}
+
+TEST(OpusBitrateControllerTest, CongestionCutsOncePerHoldoff) {
+  const auto config = MakeConfig();
+  OpusBitrateController controller(config);
+  controller.ReportSend(kFrameDuration * 1000 + 1, 0);
+  EXPECT_EQ(controller.bitrate(), config.initial_bitrate * 3 / 4);
+
+  // The queue needs a few sends to drain, congestion reported meanwhile does not cut again.
+  for (uint32_t i = 0; i < config.decrease_holdoff - 1; i++) {
+    controller.ReportSend(1000, config.congested_queue_depth);
+  }
+  EXPECT_EQ(controller.bitrate(), config.initial_bitrate * 3 / 4);
+
+  for (uint32_t i = 0; i < config.decrease_holdoff * 20; i++) {
+    controller.ReportSend(kFrameDuration * 2000, 0);
+  }
+  EXPECT_EQ(controller.bitrate(), config.min_bitrate);
+  EXPECT_EQ(controller.bandwidth(), OPUS_BANDWIDTH_NARROWBAND);
+}
+
+TEST(OpusBitrateControllerTest, DropsRaiseTheExpectedLossUpToTheCap) {
+  const auto config = MakeConfig();
+  OpusBitrateController controller(config);
+  controller.ReportDrop();
+  EXPECT_GT(controller.packet_loss_perc(), 0);
+
+  for (int i = 0; i < 100; i++) {
+    controller.ReportDrop();
+  }
+  EXPECT_EQ(controller.packet_loss_perc(), config.max_packet_loss_perc);
+
+  // Loss decays once packets go through again.
+  for (uint32_t i = 0; i < config.increase_interval * 4; i++) {
+    controller.ReportSend(1000, 0);
+  }
+  EXPECT_LT(controller.packet_loss_perc(), config.max_packet_loss_perc);
+}
+
+// On a link slower than the initial bitrate the controller settles below the link rate, so the queue stays short and
+// nothing is dropped once it has settled. When the link recovers the bitrate climbs back.
+TEST(OpusBitrateControllerTest, AdaptsToASlowLink) {
+  constexpr uint32_t kSlowLink = 14000;  // bps
+  const auto config = MakeConfig();
+  OpusBitrateController controller(config);
+  SlowSink sink(controller, 8);
+
+  sink.Run(10000, kSlowLink);
+  EXPECT_LT(controller.bitrate(), config.initial_bitrate);
+
+  sink.ResetStats();
+  constexpr uint32_t kSettledDuration = 60000;  // ms
+  sink.Run(kSettledDuration, kSlowLink);
+  EXPECT_EQ(sink.dropped_count(), 0u);
+  EXPECT_LT(sink.max_queue_depth(), config.congested_queue_depth);
+  EXPECT_LE(sink.sent_bits() * 1000 / kSettledDuration, kSlowLink);
+  EXPECT_GT(sink.sent_bits() * 1000 / kSettledDuration, kSlowLink / 2);
+
+  sink.Run(120000, 100000);
+  EXPECT_EQ(controller.bitrate(), config.max_bitrate);
+}
@@ -0,0 +1,140 @@
+#include "flex_array/packet.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "components/task_queue/active_task_queue.h"
+
+namespace {
+Packet Filled(const size_t size, const uint8_t first = 0) {
+  Packet packet(size);
+  std::iota(packet.data(), packet.data() + size, first);
+  return packet;
+}
+
+bool IsFilled(const Packet &packet, const uint8_t first = 0) {
+  for (size_t i = 0; i < packet.size(); i++) {
+    if (packet.data()[i] != static_cast<uint8_t>(first + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Packets per second handed to a task queue and consumed on its task, as the uplink hands them to the network task. The
+// producer holds back while a few are in flight, like the uplink drops packets once the queue backs up.
+template <typename Payload>
+int64_t QueueThroughput(const size_t size) {
+  constexpr size_t kPackets = 20000;
+  constexpr size_t kInFlight = 8;
+  ActiveTaskQueue queue("Network", 4096, 1);
+  std::atomic<size_t> consumed_bytes = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kPackets; i++) {
+    Payload payload(size);
+    payload.data()[0] = static_cast<uint8_t>(i);
+    while (queue.size() >= kInFlight) {
+      std::this_thread::yield();
+    }
+    queue.Enqueue([&consumed_bytes, payload = std::move(payload)]() { consumed_bytes += payload.size(); });
+  }
+  queue.Sync();
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  EXPECT_EQ(consumed_bytes, kPackets * size);
+  return static_cast<int64_t>(kPackets / elapsed);
+}
+
+bool IsInline(const Packet &packet) {
+  const auto begin = reinterpret_cast<const uint8_t *>(&packet);
+  return packet.data() >= begin && packet.data() < begin + sizeof(Packet);
+}
+}  // namespace
+
+TEST(PacketTest, VoicePacketsStayInline) {
+  const auto allocations = BufferPool::GetInstance().heap_allocation_count();
+  for (const size_t size : {size_t{0}, size_t{1}, size_t{120}, Packet::kInlineCapacity}) {
+    const auto packet = Filled(size);
+    EXPECT_TRUE(IsInline(packet)) << size << " bytes";
+    EXPECT_EQ(packet.size(), size);
+    EXPECT_EQ(packet.capacity(), Packet::kInlineCapacity);
+    EXPECT_TRUE(IsFilled(packet));
+  }
+  EXPECT_EQ(BufferPool::GetInstance().heap_allocation_count(), allocations);
+}
+
+TEST(PacketTest, LargerPayloadsComeFromThePool) {
+  const auto packet = Filled(Packet::kInlineCapacity + 1);
+  EXPECT_FALSE(IsInline(packet));
+  EXPECT_GE(packet.capacity(), packet.size());
+  EXPECT_TRUE(IsFilled(packet));
+}
+
+TEST(PacketTest, MoveKeepsThePayloadAndEmptiesTheSource) {
+  for (const size_t size : {100, 1000}) {
+    auto source = Filled(size, 7);
+    const auto heap = IsInline(source) ? nullptr : source.data();
+    Packet moved(std::move(source));
+    EXPECT_EQ(moved.size(), size);
+    EXPECT_TRUE(IsFilled(moved, 7));
+    EXPECT_EQ(source.size(), 0u);
+    EXPECT_TRUE(IsInline(source));
+    if (heap != nullptr) {
+      EXPECT_EQ(moved.data(), heap) << "a pooled payload is handed over, not copied";
+    }
+  }
+}
+
+TEST(PacketTest, ResizeKeepsTheBytes) {
+  auto packet = Filled(100);
+  packet.Resize(50);
+  EXPECT_TRUE(IsInline(packet));
+  EXPECT_TRUE(IsFilled(packet));
+
+  packet.Resize(Packet::kInlineCapacity);
+  EXPECT_TRUE(IsInline(packet));
+
+  packet.Resize(1000);
+  EXPECT_FALSE(IsInline(packet));
+  EXPECT_EQ(packet.size(), 1000u);
+  EXPECT_TRUE(std::equal(packet.data(), packet.data() + 50, Filled(50).data()));
+
+  const auto data = packet.data();
+  packet.Resize(10);
+  EXPECT_EQ(packet.data(), data) << "shrinking never moves the data";
+  EXPECT_TRUE(IsFilled(packet));
+}
+
+// Packets queued and dequeued like the decoder's input, the pool has to serve all of it once warmed up.
+TEST(PacketTest, QueueingDoesNotTouchTheHeapOnceWarm) {
+  auto &pool = BufferPool::GetInstance();
+  std::deque<Packet> queue;
+  size_t i = 0;
+  auto run = [&queue, &i](const size_t packets) {
+    for (const auto end = i + packets; i < end; i++) {
+      queue.push_back(Filled(i % 4 == 0 ? 400 : 80, static_cast<uint8_t>(i)));
+      if (queue.size() > 8) {
+        EXPECT_TRUE(IsFilled(queue.front(), static_cast<uint8_t>(i - 8)));
+        queue.pop_front();
+      }
+    }
+  };
+
+  run(64);
+  const auto allocations = pool.heap_allocation_count();
+  run(10000);
+  EXPECT_EQ(pool.heap_allocation_count(), allocations);
+}
+
+// Not a pass/fail check: a typical 60 ms voice packet through the task queue as a Packet and as the std::vector payload
+// it replaced, reported as test properties.
+TEST(PacketTest, QueueBenchmark) {
+  constexpr size_t kVoicePacketSize = 120;  // 60 ms at 16 kbit/s
+  RecordProperty("packet_per_second", std::to_string(QueueThroughput<Packet>(kVoicePacketSize)));
+  RecordProperty("vector_per_second", std::to_string(QueueThroughput<std::vector<uint8_t>>(kVoicePacketSize)));
+}
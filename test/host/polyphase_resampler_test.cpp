@@ -0,0 +1,169 @@
+#include "polyphase_resampler.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "silk_resampler.h"
+
+namespace {
+std::vector<int16_t> Sine(const uint32_t sample_rate, const float frequency, const size_t samples, const float amplitude = 16000) {
+  std::vector<int16_t> pcm(samples);
+  for (size_t i = 0; i < samples; i++) {
+    pcm[i] = static_cast<int16_t>(std::lround(amplitude * std::sin(2 * M_PI * frequency * i / sample_rate)));
+  }
+  return pcm;
+}
+
+std::vector<int16_t> ResampleInChunks(Resampler &resampler, const std::vector<int16_t> &input, const size_t chunk) {
+  std::vector<int16_t> output;
+  for (size_t offset = 0; offset < input.size(); offset += chunk) {
+    const size_t size = std::min(chunk, input.size() - offset);
+    std::vector<int16_t> part(resampler.output_size(size));
+    const auto produced = resampler.Resample(input.data() + offset, size, part.data(), part.size());
+    EXPECT_EQ(produced, part.size());
+    output.insert(output.end(), part.begin(), part.begin() + produced);
+  }
+  return output;
+}
+
+// Fits a sine of |frequency| to |pcm| past the filter's settling time, returns the power of the fit over the rest in dB.
+double SignalToNoise(const std::vector<int16_t> &pcm, const uint32_t sample_rate, const float frequency, const size_t skip) {
+  double sin_sum = 0;
+  double cos_sum = 0;
+  for (size_t i = skip; i < pcm.size(); i++) {
+    sin_sum += pcm[i] * std::sin(2 * M_PI * frequency * i / sample_rate);
+    cos_sum += pcm[i] * std::cos(2 * M_PI * frequency * i / sample_rate);
+  }
+  const double count = pcm.size() - skip;
+  const double a = 2 * sin_sum / count;
+  const double b = 2 * cos_sum / count;
+  double signal = 0;
+  double noise = 0;
+  for (size_t i = skip; i < pcm.size(); i++) {
+    const double fit = a * std::sin(2 * M_PI * frequency * i / sample_rate) + b * std::cos(2 * M_PI * frequency * i / sample_rate);
+    signal += fit * fit;
+    noise += (pcm[i] - fit) * (pcm[i] - fit);
+  }
+  return 10 * std::log10(signal / noise);
+}
+
+// Amplitude of the sine of |frequency| fitted to |pcm| past |skip|.
+double Amplitude(const std::vector<int16_t> &pcm, const uint32_t sample_rate, const float frequency, const size_t skip) {
+  double sin_sum = 0;
+  double cos_sum = 0;
+  for (size_t i = skip; i < pcm.size(); i++) {
+    sin_sum += pcm[i] * std::sin(2 * M_PI * frequency * i / sample_rate);
+    cos_sum += pcm[i] * std::cos(2 * M_PI * frequency * i / sample_rate);
+  }
+  const double count = pcm.size() - skip;
+  return 2 * std::hypot(sin_sum, cos_sum) / count;
+}
+
+double Rms(const std::vector<int16_t> &pcm, const size_t skip) {
+  double sum = 0;
+  for (size_t i = skip; i < pcm.size(); i++) {
+    sum += static_cast<double>(pcm[i]) * pcm[i];
+  }
+  return std::sqrt(sum / (pcm.size() - skip));
+}
+
+struct Rates {
+  uint32_t input;
+  uint32_t output;
+};
+
+std::string RatesName(const testing::TestParamInfo<Rates> &info) {
+  return std::to_string(info.param.input) + "To" + std::to_string(info.param.output);
+}
+
+class PolyphaseResamplerTest : public testing::TestWithParam<Rates> {};
+class PolyphaseDownsamplerTest : public testing::TestWithParam<Rates> {};
+}  // namespace
+
+TEST_P(PolyphaseResamplerTest, OutputCountIsExactHoweverTheInputIsSplit) {
+  const auto [input_rate, output_rate] = GetParam();
+  const auto input = Sine(input_rate, 440, input_rate);
+
+  PolyphaseResampler whole(input_rate, output_rate);
+  const auto reference = ResampleInChunks(whole, input, input.size());
+  // One second in, one second out, give or take the last output the filter still reaches ahead for.
+  EXPECT_NEAR(static_cast<double>(reference.size()), output_rate, 1);
+
+  for (const size_t chunk : {1, 7, 160, 441, 1000}) {
+    PolyphaseResampler split(input_rate, output_rate);
+    EXPECT_EQ(ResampleInChunks(split, input, chunk), reference) << "chunks of " << chunk;
+  }
+}
+
+TEST_P(PolyphaseResamplerTest, PassesAToneCleanly) {
+  const auto [input_rate, output_rate] = GetParam();
+  PolyphaseResampler resampler(input_rate, output_rate);
+  const auto output = ResampleInChunks(resampler, Sine(input_rate, 1000, input_rate / 2), 320);
+  const auto snr = SignalToNoise(output, output_rate, 1000, 4 * resampler.delay());
+  RecordProperty("snr_db", std::to_string(snr));
+  EXPECT_GT(snr, 60) << input_rate << " -> " << output_rate;
+  EXPECT_NEAR(Rms(output, 4 * resampler.delay()), 16000 / std::sqrt(2), 16000 * 0.01);
+}
+
+// Tones from 100 Hz to 60 % of the lower Nyquist frequency (4.8 kHz at 16 kHz), the gain must stay within kMaxRipple dB of unity.
+TEST_P(PolyphaseResamplerTest, PassbandIsFlat) {
+  constexpr double kMaxRipple = 0.1;  // dB
+  const auto [input_rate, output_rate] = GetParam();
+  const float edge = std::min(input_rate, output_rate) / 2 * 0.6f;
+  double min_gain = 0;
+  double max_gain = -100;
+  for (float frequency = 100; frequency <= edge; frequency += 100) {
+    PolyphaseResampler resampler(input_rate, output_rate);
+    const auto output = ResampleInChunks(resampler, Sine(input_rate, frequency, input_rate / 4), 320);
+    const auto gain = 20 * std::log10(Amplitude(output, output_rate, frequency, 4 * resampler.delay()) / 16000);
+    EXPECT_NEAR(gain, 0, kMaxRipple) << frequency << " Hz";
+    min_gain = std::min(min_gain, gain);
+    max_gain = std::max(max_gain, gain);
+  }
+  RecordProperty("ripple_db", std::to_string(max_gain - min_gain));
+}
+
+// Not a pass/fail check: input samples per second through each resampler, reported as test properties. SILK is the
+// shim's stand-in here rather than libopus, so its figure only covers the wrapper; the real one is linked on the target.
+TEST_P(PolyphaseResamplerTest, Benchmark) {
+  const auto [input_rate, output_rate] = GetParam();
+  const auto input = Sine(input_rate, 1000, input_rate * 10);
+  auto measure = [&input, input_rate = input_rate](Resampler &resampler) {
+    const auto start = std::chrono::steady_clock::now();
+    ResampleInChunks(resampler, input, input_rate / 1000 * 60);
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<int64_t>(input.size() / elapsed);
+  };
+
+  PolyphaseResampler polyphase(input_rate, output_rate);
+  RecordProperty("polyphase_samples_per_second", std::to_string(measure(polyphase)));
+  if (SilkResampler::Supports(input_rate, output_rate)) {
+    SilkResampler silk(input_rate, output_rate);
+    RecordProperty("silk_samples_per_second", std::to_string(measure(silk)));
+  }
+}
+
+TEST_P(PolyphaseDownsamplerTest, RejectsWhatCannotBeRepresented) {
+  const auto [input_rate, output_rate] = GetParam();
+  // Between the input and the output Nyquist frequency, so it can only alias.
+  const float frequency = (input_rate / 2 * 3 + output_rate / 2) / 4;
+  PolyphaseResampler resampler(input_rate, output_rate);
+  const auto output = ResampleInChunks(resampler, Sine(input_rate, frequency, input_rate / 2), 320);
+  const auto attenuation = 20 * std::log10(Rms(output, 4 * resampler.delay()) / (16000 / std::sqrt(2)));
+  RecordProperty("attenuation_db", std::to_string(attenuation));
+  EXPECT_LT(attenuation, -50) << input_rate << " -> " << output_rate;
+}
+
+INSTANTIATE_TEST_SUITE_P(Rates,
+                         PolyphaseResamplerTest,
+                         testing::Values(Rates{44100, 16000}, Rates{48000, 16000}, Rates{22050, 16000}, Rates{16000, 24000}, Rates{16000, 44100}),
+                         RatesName);
+
+// Only downsampling has anything above the output Nyquist frequency to reject.
+INSTANTIATE_TEST_SUITE_P(Rates,
+                         PolyphaseDownsamplerTest,
+                         testing::Values(Rates{44100, 16000}, Rates{48000, 16000}, Rates{22050, 16000}),
+                         RatesName);
@@ -0,0 +1,104 @@
+#include "silk_resampler.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+std::vector<int16_t> Ramp(const size_t samples) {
+  std::vector<int16_t> pcm(samples);
+  for (size_t i = 0; i < samples; i++) {
+    pcm[i] = static_cast<int16_t>(i);
+  }
+  return pcm;
+}
+
+// Feeds |input| in chunks of |chunk| samples, checking every call produces exactly what output_size() promised.
+std::vector<int16_t> ResampleInChunks(SilkResampler &resampler, const std::vector<int16_t> &input, const size_t chunk) {
+  std::vector<int16_t> output;
+  for (size_t offset = 0; offset < input.size(); offset += chunk) {
+    const size_t size = std::min(chunk, input.size() - offset);
+    std::vector<int16_t> part(resampler.output_size(size));
+    const auto produced = resampler.Resample(input.data() + offset, size, part.data(), part.size());
+    EXPECT_EQ(produced, part.size());
+    output.insert(output.end(), part.begin(), part.begin() + produced);
+  }
+  return output;
+}
+
+struct Rates {
+  uint32_t input;
+  uint32_t output;
+};
+
+class SilkResamplerTest : public testing::TestWithParam<Rates> {};
+}  // namespace
+
+TEST(SilkResamplerSupportTest, OnlyWholeKilohertzAroundSixteen) {
+  EXPECT_TRUE(SilkResampler::Supports(48000, 16000));
+  EXPECT_TRUE(SilkResampler::Supports(24000, 8000));
+  EXPECT_TRUE(SilkResampler::Supports(16000, 48000));
+  EXPECT_FALSE(SilkResampler::Supports(44100, 16000));
+  EXPECT_FALSE(SilkResampler::Supports(16000, 44100));
+  EXPECT_FALSE(SilkResampler::Supports(48000, 24000));
+  EXPECT_FALSE(SilkResampler::Supports(24000, 48000));
+}
+
+TEST_P(SilkResamplerTest, OutputIsExactHoweverTheInputIsSplit) {
+  const auto [input_rate, output_rate] = GetParam();
+  // A second and a bit, so some input is left over beyond the last whole millisecond.
+  const auto input = Ramp(input_rate + input_rate / 1000 / 2 + 1);
+
+  SilkResampler whole(input_rate, output_rate);
+  const auto reference = ResampleInChunks(whole, input, input.size());
+  EXPECT_EQ(reference.size(), output_rate);
+
+  for (const size_t chunk : {1, 7, 47, 160, 441, 1001}) {
+    SilkResampler split(input_rate, output_rate);
+    EXPECT_EQ(ResampleInChunks(split, input, chunk), reference) << "chunks of " << chunk;
+  }
+}
+
+// Four hours of capture, mostly in the 10 ms chunks the devices deliver with every fourth chunk of a random size up to
+// 20 ms. The count must not drift by a single sample.
+TEST_P(SilkResamplerTest, CountDoesNotDriftOverALongStream) {
+  constexpr uint64_t kDuration = 4 * 3600;  // s
+  const auto [input_rate, output_rate] = GetParam();
+  SilkResampler resampler(input_rate, output_rate);
+  std::mt19937 random(input_rate + output_rate);
+  std::uniform_int_distribution<size_t> odd_chunk(1, input_rate / 50);
+  std::vector<int16_t> input(input_rate / 50, 0);
+  std::vector<int16_t> output(resampler.output_size(input.size()));
+
+  const uint64_t total = input_rate * kDuration;
+  uint64_t consumed = 0;
+  uint64_t produced = 0;
+  for (uint64_t i = 0; consumed < total; i++) {
+    const size_t chunk = i % 4 == 3 ? odd_chunk(random) : input_rate / 100;
+    const auto size = static_cast<size_t>(std::min<uint64_t>(chunk, total - consumed));
+    const auto expected = resampler.output_size(size);
+    ASSERT_EQ(resampler.Resample(input.data(), size, output.data(), output.size()), expected);
+    consumed += size;
+    produced += expected;
+    ASSERT_EQ(produced, consumed / (input_rate / 1000) * (output_rate / 1000));
+  }
+  EXPECT_EQ(produced, total * output_rate / input_rate);
+}
+
+TEST_P(SilkResamplerTest, ResetDropsThePartialMillisecond) {
+  const auto [input_rate, output_rate] = GetParam();
+  SilkResampler resampler(input_rate, output_rate);
+  const auto input = Ramp(input_rate / 1000 - 1);
+  EXPECT_EQ(ResampleInChunks(resampler, input, input.size()).size(), 0u);
+  resampler.Reset();
+  EXPECT_EQ(resampler.output_size(1), 0u);
+  EXPECT_EQ(resampler.output_size(input_rate / 1000), output_rate / 1000);
+}
+
+INSTANTIATE_TEST_SUITE_P(Rates,
+                         SilkResamplerTest,
+                         testing::Values(Rates{48000, 16000}, Rates{24000, 16000}, Rates{16000, 8000}, Rates{16000, 24000}, Rates{8000, 48000}),
+                         [](const testing::TestParamInfo<Rates> &info) {
+                           return std::to_string(info.param.input) + "To" + std::to_string(info.param.output);
+                         });
@@ -0,0 +1,214 @@
+#include "components/ring_buffer/spsc_ring_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "audio_capture_hub.h"
+#include "audio_input_device_mock.h"
+
+TEST(SpscRingBufferTest, RoundsCapacityUpToPowerOfTwo) {
+  SpscRingBuffer<int16_t> ring(300);
+  EXPECT_EQ(ring.capacity(), 512u);
+  EXPECT_EQ(ring.size(), 0u);
+}
+
+TEST(SpscRingBufferTest, ReadsBackWhatWasWrittenAcrossTheWrap) {
+  SpscRingBuffer<int16_t> ring(8);
+  int16_t value = 0;
+  int16_t expected = 0;
+  for (int round = 0; round < 10; round++) {
+    int16_t in[5];
+    for (auto &sample : in) {
+      sample = value++;
+    }
+    ASSERT_EQ(ring.Write(in, 5), 5u);
+
+    int16_t out[5] = {};
+    ASSERT_TRUE(ring.Read(out, 5));
+    for (const auto sample : out) {
+      EXPECT_EQ(sample, expected++);
+    }
+  }
+  EXPECT_EQ(ring.overrun_count(), 0u);
+  EXPECT_EQ(ring.underrun_count(), 0u);
+}
+
+TEST(SpscRingBufferTest, CountsWhatDoesNotFitAsOverrun) {
+  SpscRingBuffer<int16_t> ring(8);
+  const std::vector<int16_t> in(11, 1);
+  EXPECT_EQ(ring.Write(in.data(), in.size()), 8u);
+  EXPECT_EQ(ring.overrun_count(), 3u);
+  EXPECT_EQ(ring.Write(in.data(), 2), 0u);
+  EXPECT_EQ(ring.overrun_count(), 5u);
+  EXPECT_EQ(ring.size(), 8u);
+}
+
+TEST(SpscRingBufferTest, ShortReadTakesNothingAndCountsUnderrun) {
+  SpscRingBuffer<int16_t> ring(8);
+  const int16_t in[3] = {1, 2, 3};
+  ring.Write(in, 3);
+
+  int16_t out[4] = {};
+  EXPECT_FALSE(ring.Read(out, 4));
+  EXPECT_EQ(ring.underrun_count(), 1u);
+  EXPECT_EQ(ring.size(), 3u);
+
+  EXPECT_TRUE(ring.Read(out, 3));
+  EXPECT_EQ(out[2], 3);
+}
+
+TEST(SpscRingBufferTest, ClearDropsEverythingReadable) {
+  SpscRingBuffer<int16_t> ring(8);
+  const int16_t in[6] = {};
+  ring.Write(in, 6);
+  ring.Clear();
+  EXPECT_EQ(ring.size(), 0u);
+  EXPECT_EQ(ring.Write(in, 6), 6u);
+}
+
+// A capture task writing 20 ms blocks against an encoder reading 60 ms frames with stalls: every sample is either read
+// in order or counted as overrun, none is lost silently.
+TEST(SpscRingBufferTest, AccountsForEverySampleUnderEncoderJitter) {
+  constexpr size_t kBlockSamples = 320;
+  constexpr size_t kFrameSamples = 960;
+  constexpr size_t kBlocks = 3000;
+  SpscRingBuffer<int32_t> ring(kFrameSamples * 4);
+  std::atomic<bool> done = false;
+
+  std::thread producer([&ring, &done]() {
+    std::vector<int32_t> block(kBlockSamples);
+    int32_t value = 0;
+    for (size_t i = 0; i < kBlocks; i++) {
+      for (auto &sample : block) {
+        sample = value++;
+      }
+      ring.Write(block.data(), block.size());
+      if (i % 8 == 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    }
+    done = true;
+  });
+
+  size_t read_samples = 0;
+  size_t skipped_samples = 0;
+  int32_t expected = 0;
+  std::vector<int32_t> frame(kFrameSamples);
+  for (size_t frames = 0; !done || ring.size() >= frame.size(); frames++) {
+    if (!ring.Read(frame.data(), frame.size())) {
+      std::this_thread::yield();
+      continue;
+    }
+    for (const auto sample : frame) {
+      // After an overrun the stream resumes further on, but never goes back.
+      ASSERT_GE(sample, expected);
+      skipped_samples += sample - expected;
+      expected = sample + 1;
+    }
+    read_samples += frame.size();
+    if (frames % 16 == 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));  // an encoder stall
+    }
+  }
+  producer.join();
+
+  EXPECT_EQ(read_samples + ring.size() + ring.overrun_count(), kBlocks * kBlockSamples);
+  EXPECT_LE(skipped_samples, ring.overrun_count());
+}
+
+namespace {
+// Calls DeliverFrame() every |interval| while alive, like the receive interrupt would.
+class FrameFeeder {
+ public:
+  FrameFeeder(ai_vox::MockAudioInputDevice &device, const std::chrono::microseconds interval)
+      : thread_([this, &device, interval]() {
+          auto next = std::chrono::steady_clock::now();
+          while (!stop_) {
+            device.DeliverFrame();
+            next += interval;
+            std::this_thread::sleep_until(next);
+          }
+        }) {
+  }
+
+  ~FrameFeeder() {
+    stop_ = true;
+    thread_.join();
+  }
+
+ private:
+  std::atomic<bool> stop_ = false;
+  std::thread thread_;
+};
+
+// Pop() also returns empty on a wake-up for a block that was already popped, only a timeout counts as an underrun.
+AudioBlockRef PopBlock(AudioCaptureHub::Subscriber &subscriber, const TickType_t timeout) {
+  const auto underruns = subscriber.underrun_count();
+  while (true) {
+    auto block = subscriber.Pop(timeout);
+    if (block || subscriber.underrun_count() != underruns) {
+      return block;
+    }
+  }
+}
+}  // namespace
+
+// The capture path end to end: the mock device's interrupt pushes its ramp at twice real time into the hub, whose
+// subscriber queues are SPSC rings, and a consumer that stalls for longer than its queue holds overruns. The blocks it
+// does get carry the ramp unbroken, every gap in it is a whole number of blocks, and these add up to the overrun count.
+TEST(SpscRingBufferTest, CapturePathAccountsForEveryBlockOfTheMockDevice) {
+  constexpr size_t kQueueBlocks = 4;
+  constexpr auto kFeedInterval = std::chrono::microseconds(7500);  // a 240-sample frame, 15 ms of audio
+  constexpr auto kStall = std::chrono::milliseconds(150);          // 20 blocks at twice real time
+  auto device = std::make_shared<ai_vox::MockAudioInputDevice>(AudioCaptureHub::kSampleRate);
+  AudioCaptureHub hub(device);
+  AudioCaptureHub::Subscriber subscriber(kQueueBlocks);
+  hub.Attach(&subscriber);
+
+  size_t popped_blocks = 0;
+  size_t skipped_blocks = 0;
+  uint32_t next_sequence = 0;
+  int16_t expected = 0;
+  const auto check = [&](const AudioBlockRef &block) {
+    ASSERT_EQ(block.size(), AudioCaptureHub::kBlockSamples);
+    ASSERT_GE(block.sequence(), next_sequence);
+    const auto skipped = block.sequence() - next_sequence;
+    skipped_blocks += skipped;
+    expected = static_cast<int16_t>(expected + skipped * AudioCaptureHub::kBlockSamples);
+    for (size_t i = 0; i < block.size(); i++) {
+      ASSERT_EQ(block.data()[i], expected) << "sample " << i << " of block " << block.sequence();
+      ++expected;
+    }
+    next_sequence = block.sequence() + 1;
+    ++popped_blocks;
+  };
+
+  {
+    FrameFeeder feeder(*device, kFeedInterval);
+    for (size_t i = 0; i < 200; i++) {
+      const auto block = PopBlock(subscriber, pdMS_TO_TICKS(1000));
+      ASSERT_TRUE(block) << "block " << i;
+      ASSERT_NO_FATAL_FAILURE(check(block));
+      if (i % 50 == 49) {
+        std::this_thread::sleep_for(kStall);
+      }
+    }
+  }
+  // What is left in the stream buffer and the queue.
+  while (const auto block = PopBlock(subscriber, pdMS_TO_TICKS(200))) {
+    ASSERT_NO_FATAL_FAILURE(check(block));
+  }
+  hub.Detach(&subscriber);
+
+  const size_t captured_blocks = device->produced_samples() / AudioCaptureHub::kBlockSamples;
+  EXPECT_EQ(device->dropped_frames(), 0u);
+  EXPECT_GT(subscriber.overrun_count(), 0u);
+  EXPECT_EQ(skipped_blocks + (captured_blocks - next_sequence), subscriber.overrun_count());
+  EXPECT_EQ(popped_blocks + subscriber.overrun_count(), captured_blocks);
+}
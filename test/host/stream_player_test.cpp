@@ -0,0 +1,198 @@
+#include "audio_device/stream_player.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "http_server_host.h"
+
+namespace {
+constexpr uint32_t kSampleRate = 8000;
+
+// Records what is played, taking |1 / speedup| of the real time to play it.
+class RecordingOutputDevice : public ai_vox::AudioOutputDevice {
+ public:
+  explicit RecordingOutputDevice(const uint32_t speedup) : speedup_(speedup) {
+  }
+
+  bool OpenOutput(uint32_t sample_rate) override {
+    return true;
+  }
+
+  void CloseOutput() override {
+  }
+
+  size_t Write(const int16_t *pcm, size_t samples) override {
+    {
+      std::lock_guard lock(mutex_);
+      played_.insert(played_.end(), pcm, pcm + samples);
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(samples * 1000000 / kSampleRate / speedup_));
+    return samples;
+  }
+
+  void set_volume(uint16_t volume) override {
+  }
+
+  uint16_t volume() const override {
+    return kMaxVolume;
+  }
+
+  uint32_t output_sample_rate() override {
+    return kSampleRate;
+  }
+
+  bool WaitForDrained(const uint32_t timeout_ms) override {
+    return true;
+  }
+
+  std::vector<int16_t> played() {
+    std::lock_guard lock(mutex_);
+    return played_;
+  }
+
+ private:
+  const uint32_t speedup_ = 1;
+  std::mutex mutex_;
+  std::vector<int16_t> played_;
+};
+
+std::vector<int16_t> Ramp(const size_t samples) {
+  std::vector<int16_t> pcm(samples);
+  for (size_t i = 0; i < samples; i++) {
+    pcm[i] = static_cast<int16_t>(i);
+  }
+  return pcm;
+}
+
+// Canonical 16-bit mono WAV.
+std::vector<uint8_t> Wav(const std::vector<int16_t> &pcm) {
+  const uint32_t data_size = pcm.size() * sizeof(int16_t);
+  const uint32_t byte_rate = kSampleRate * sizeof(int16_t);
+  std::vector<uint8_t> wav(44);
+  auto put = [&wav](const size_t offset, const uint32_t value, const size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+      wav[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+  };
+  std::memcpy(wav.data(), "RIFF", 4);
+  put(4, 36 + data_size, 4);
+  std::memcpy(wav.data() + 8, "WAVEfmt ", 8);
+  put(16, 16, 4);
+  put(20, 1, 2);  // PCM
+  put(22, 1, 2);  // mono
+  put(24, kSampleRate, 4);
+  put(28, byte_rate, 4);
+  put(32, sizeof(int16_t), 2);
+  put(34, 16, 2);
+  std::memcpy(wav.data() + 36, "data", 4);
+  put(40, data_size, 4);
+  const auto bytes = reinterpret_cast<const uint8_t *>(pcm.data());
+  wav.insert(wav.end(), bytes, bytes + data_size);
+  return wav;
+}
+
+// Polls until the player is idle again, returns the largest prefetch depth seen meanwhile.
+uint32_t WaitUntilIdle(const ai_vox::StreamPlayer &player) {
+  uint32_t max_prefetch = player.prefetch();
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (player.state() != ai_vox::StreamPlayer::State::kIdle && std::chrono::steady_clock::now() < deadline) {
+    max_prefetch = std::max(max_prefetch, player.prefetch());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(player.state(), ai_vox::StreamPlayer::State::kIdle);
+  return max_prefetch;
+}
+
+class StreamPlayerTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    HostHttpClear();
+  }
+};
+}  // namespace
+
+TEST_F(StreamPlayerTest, PlaysAFileSampleForSample) {
+  const auto pcm = Ramp(kSampleRate * 2);
+  const auto wav = Wav(pcm);
+  const auto path = testing::TempDir() + "stream_player_test.wav";
+  auto file = fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  fwrite(wav.data(), 1, wav.size(), file);
+  fclose(file);
+
+  auto device = std::make_shared<RecordingOutputDevice>(100);
+  ai_vox::StreamPlayer player(device);
+  ASSERT_TRUE(player.Play("file://" + path));
+  WaitUntilIdle(player);
+  remove(path.c_str());
+
+  EXPECT_EQ(device->played(), pcm);
+  EXPECT_EQ(player.stall_count(), 0u);
+  EXPECT_EQ(player.position(), 2u);
+}
+
+TEST_F(StreamPlayerTest, ResumesADroppedConnectionWithARangeRequest) {
+  const auto pcm = Ramp(kSampleRate * 2);
+  HostHttpResource resource;
+  resource.body = Wav(pcm);
+  resource.drop_at = {10000, 20001};
+  const auto &served = HostHttpServe("http://host.test/ramp.wav", std::move(resource));
+
+  auto device = std::make_shared<RecordingOutputDevice>(100);
+  ai_vox::StreamPlayer player(device);
+  ASSERT_TRUE(player.Play("http://host.test/ramp.wav"));
+  WaitUntilIdle(player);
+
+  EXPECT_EQ(device->played(), pcm);
+  EXPECT_EQ(player.reconnect_count(), 2u);
+  EXPECT_EQ(served.requests, 3u);
+}
+
+TEST_F(StreamPlayerTest, SkipsWhatAServerIgnoringTheRangeSendsAgain) {
+  const auto pcm = Ramp(kSampleRate * 2);
+  HostHttpResource resource;
+  resource.body = Wav(pcm);
+  resource.ranges = false;
+  resource.drop_at = {15001};
+  HostHttpServe("http://host.test/ramp.wav", std::move(resource));
+
+  auto device = std::make_shared<RecordingOutputDevice>(100);
+  ai_vox::StreamPlayer player(device);
+  ASSERT_TRUE(player.Play("http://host.test/ramp.wav"));
+  WaitUntilIdle(player);
+
+  EXPECT_EQ(device->played(), pcm);
+  EXPECT_EQ(player.reconnect_count(), 1u);
+}
+
+// A link at a quarter of the playback rate for the first two seconds of audio, then as fast as it is read.
+TEST_F(StreamPlayerTest, PrefetchRisesOnStallsAndDecaysOnceSmooth) {
+  constexpr uint32_t kSpeedup = 4;
+  const auto pcm = Ramp(kSampleRate * 8);
+  HostHttpResource resource;
+  resource.body = Wav(pcm);
+  resource.segments = {{kSampleRate * sizeof(int16_t) * 2, kSampleRate * sizeof(int16_t) * kSpeedup / 4}};
+  HostHttpServe("http://host.test/ramp.wav", std::move(resource));
+
+  ai_vox::StreamPlayer::Config config;
+  config.ring_size = 16 << 10;
+  config.min_prefetch = 2 << 10;
+  config.prefetch_decay = 1000;
+  auto device = std::make_shared<RecordingOutputDevice>(kSpeedup);
+  ai_vox::StreamPlayer player(device, config);
+  ASSERT_TRUE(player.Play("http://host.test/ramp.wav"));
+  const auto max_prefetch = WaitUntilIdle(player);
+
+  EXPECT_EQ(device->played(), pcm);
+  EXPECT_GE(player.stall_count(), 2u);
+  EXPECT_GE(max_prefetch, 8u << 10);
+  EXPECT_LE(max_prefetch, config.ring_size * 3 / 4);
+  // Six smooth seconds are plenty to halve the depth back down to the minimum.
+  EXPECT_EQ(player.prefetch(), config.min_prefetch);
+}
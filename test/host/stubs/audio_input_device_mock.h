@@ -0,0 +1,125 @@
+#pragma once
+
+#ifndef _AUDIO_INPUT_DEVICE_MOCK_H_
+#define _AUDIO_INPUT_DEVICE_MOCK_H_
+
+#include <esp_attr.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "audio_device/audio_input_device.h"
+
+namespace ai_vox {
+
+/**
+ * Input device without hardware, for tests. It captures a 16-bit ramp that steps by one every sample, so a consumer can
+ * tell lost, repeated or reordered samples from the values alone.
+ *
+ * Read() produces the samples on demand. In push mode, DeliverFrame() stands in for the receive interrupt: it hands one
+ * DMA frame to an IRAM converter like the I2S devices do and sends the result to the stream with
+ * xStreamBufferSendFromISR(). A |frame_samples| of 0 makes StartStream() unsupported, for the polled path.
+ */
+class MockAudioInputDevice : public AudioInputDevice {
+ public:
+  explicit MockAudioInputDevice(const uint32_t sample_rate, const size_t frame_samples = 240)
+      : sample_rate_(sample_rate), dma_buffer_(frame_samples), pcm_(frame_samples) {
+  }
+
+  ~MockAudioInputDevice() {
+    CloseInput();
+  }
+
+  bool OpenInput(uint32_t sample_rate) override {
+    open_ = true;
+    return true;
+  }
+
+  void CloseInput() override {
+    StopStream();
+    open_ = false;
+  }
+
+  size_t Read(int16_t* buffer, uint32_t samples) override {
+    const uint16_t first = next_value_.fetch_add(samples);
+    for (uint32_t i = 0; i < samples; i++) {
+      buffer[i] = static_cast<int16_t>(first + i);
+    }
+    produced_samples_ += samples;
+    return samples;
+  }
+
+  uint32_t input_sample_rate() override {
+    return sample_rate_;
+  }
+
+  bool StartStream(StreamBufferHandle_t stream) override {
+    if (!open_ || pcm_.empty() || stream == nullptr) {
+      return false;
+    }
+    std::lock_guard lock(mutex_);
+    stream_ = stream;
+    return true;
+  }
+
+  void StopStream() override {
+    std::lock_guard lock(mutex_);
+    stream_ = nullptr;
+  }
+
+  // Receives one DMA frame in push mode, from any task. Returns false if no stream is started.
+  bool DeliverFrame() {
+    std::lock_guard lock(mutex_);
+    if (stream_ == nullptr) {
+      return false;
+    }
+
+    const uint16_t first = next_value_.fetch_add(dma_buffer_.size());
+    for (size_t i = 0; i < dma_buffer_.size(); i++) {
+      dma_buffer_[i] = static_cast<int16_t>(first + i);
+    }
+    produced_samples_ += dma_buffer_.size();
+
+    const auto samples = ConvertSamples(dma_buffer_.data(), dma_buffer_.size() * sizeof(int16_t), pcm_.data(), pcm_.size());
+    BaseType_t task_woken = pdFALSE;
+    const auto sent = xStreamBufferSendFromISR(stream_, pcm_.data(), samples * sizeof(int16_t), &task_woken);
+    if (sent != samples * sizeof(int16_t)) {
+      ++dropped_frames_;
+    }
+    return true;
+  }
+
+  size_t produced_samples() const {
+    return produced_samples_;
+  }
+
+  // Frames the stream had no room for, whole or in part.
+  uint32_t dropped_frames() const {
+    return dropped_frames_;
+  }
+
+ private:
+  MockAudioInputDevice(const MockAudioInputDevice&) = delete;
+  MockAudioInputDevice& operator=(const MockAudioInputDevice&) = delete;
+
+  static size_t IRAM_ATTR ConvertSamples(const void* dma_buffer, size_t bytes, int16_t* pcm, size_t max_samples) {
+    const size_t samples = bytes / sizeof(int16_t) < max_samples ? bytes / sizeof(int16_t) : max_samples;
+    memcpy(pcm, dma_buffer, samples * sizeof(int16_t));
+    return samples;
+  }
+
+  const uint32_t sample_rate_ = 0;
+  std::atomic<bool> open_ = false;
+  std::mutex mutex_;
+  StreamBufferHandle_t stream_ = nullptr;  // guarded by |mutex_|, like the interrupt is by disabling the channel
+  std::vector<int16_t> dma_buffer_;
+  std::vector<int16_t> pcm_;
+  std::atomic<uint16_t> next_value_ = 0;  // Read() and DeliverFrame() may run on different tasks
+  std::atomic<size_t> produced_samples_ = 0;
+  std::atomic<uint32_t> dropped_frames_ = 0;
+};
+}  // namespace ai_vox
+
+#endif
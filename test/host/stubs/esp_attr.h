@@ -0,0 +1,8 @@
+#pragma once
+
+#ifndef _HOST_ESP_ATTR_H_
+#define _HOST_ESP_ATTR_H_
+
+#define IRAM_ATTR
+
+#endif
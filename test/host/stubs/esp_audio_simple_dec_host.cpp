@@ -0,0 +1,116 @@
+// Host stand-in for esp_audio_simple_dec, which the library links prebuilt for the ESP32 only. It decodes canonical
+// 16-bit PCM WAV, the 44 byte header followed by the samples, which is enough to follow a stream through the player
+// byte for byte. Every other type fails to open.
+
+#include <cstring>
+#include <new>
+
+#include "components/espressif/esp_audio_codec/esp_aac_dec.h"
+#include "components/espressif/esp_audio_codec/esp_audio_simple_dec.h"
+#include "components/espressif/esp_audio_codec/esp_flac_dec.h"
+#include "components/espressif/esp_audio_codec/esp_m4a_dec.h"
+#include "components/espressif/esp_audio_codec/esp_mp3_dec.h"
+#include "components/espressif/esp_audio_codec/esp_pcm_dec.h"
+#include "components/espressif/esp_audio_codec/esp_ts_dec.h"
+#include "components/espressif/esp_audio_codec/esp_wav_dec.h"
+
+namespace {
+constexpr uint32_t kHeaderSize = 44;
+constexpr uint32_t kFrameSize = 1024;  // bytes of PCM per decoded frame
+
+struct WavDecoder {
+  bool parsed = false;
+  esp_audio_simple_dec_info_t info = {};
+};
+
+uint32_t Read16(const uint8_t *data) {
+  return data[0] | data[1] << 8;
+}
+
+uint32_t Read32(const uint8_t *data) {
+  return Read16(data) | Read16(data + 2) << 16;
+}
+}  // namespace
+
+esp_audio_err_t esp_mp3_dec_register(void) {
+  return ESP_AUDIO_ERR_OK;
+}
+
+esp_audio_err_t esp_aac_dec_register(void) {
+  return ESP_AUDIO_ERR_OK;
+}
+
+esp_audio_err_t esp_flac_dec_register(void) {
+  return ESP_AUDIO_ERR_OK;
+}
+
+esp_audio_err_t esp_pcm_dec_register(void) {
+  return ESP_AUDIO_ERR_OK;
+}
+
+esp_audio_err_t esp_m4a_dec_register(void) {
+  return ESP_AUDIO_ERR_OK;
+}
+
+esp_audio_err_t esp_ts_dec_register(void) {
+  return ESP_AUDIO_ERR_OK;
+}
+
+esp_audio_err_t esp_wav_dec_register(void) {
+  return ESP_AUDIO_ERR_OK;
+}
+
+esp_audio_err_t esp_audio_simple_dec_open(esp_audio_simple_dec_cfg_t *cfg, esp_audio_simple_dec_handle_t *dec_handle) {
+  if (cfg->dec_type != ESP_AUDIO_SIMPLE_DEC_TYPE_WAV) {
+    return ESP_AUDIO_ERR_NOT_SUPPORT;
+  }
+  *dec_handle = new WavDecoder;
+  return ESP_AUDIO_ERR_OK;
+}
+
+esp_audio_err_t esp_audio_simple_dec_process(esp_audio_simple_dec_handle_t dec_handle,
+                                             esp_audio_simple_dec_raw_t *raw,
+                                             esp_audio_simple_dec_out_t *frame) {
+  auto decoder = static_cast<WavDecoder *>(dec_handle);
+  raw->consumed = 0;
+  frame->decoded_size = 0;
+  if (!decoder->parsed) {
+    if (raw->len < kHeaderSize) {
+      return ESP_AUDIO_ERR_OK;
+    }
+    if (std::memcmp(raw->buffer, "RIFF", 4) != 0 || Read16(raw->buffer + 34) != 16) {
+      return ESP_AUDIO_ERR_HEADER_PARSE;
+    }
+    decoder->info.channel = Read16(raw->buffer + 22);
+    decoder->info.sample_rate = Read32(raw->buffer + 24);
+    decoder->info.bits_per_sample = 16;
+    decoder->info.bitrate = decoder->info.sample_rate * decoder->info.channel * 16;
+    decoder->parsed = true;
+    raw->consumed = kHeaderSize;
+    return ESP_AUDIO_ERR_OK;
+  }
+
+  if (frame->len < kFrameSize) {
+    frame->needed_size = kFrameSize;
+    return ESP_AUDIO_ERR_BUFF_NOT_ENOUGH;
+  }
+  const uint32_t block = 2 * decoder->info.channel;
+  const uint32_t size = (raw->len < kFrameSize ? raw->len : kFrameSize) / block * block;
+  std::memcpy(frame->buffer, raw->buffer, size);
+  raw->consumed = size;
+  frame->decoded_size = size;
+  return ESP_AUDIO_ERR_OK;
+}
+
+esp_audio_err_t esp_audio_simple_dec_get_info(esp_audio_simple_dec_handle_t dec_handle, esp_audio_simple_dec_info_t *info) {
+  auto decoder = static_cast<WavDecoder *>(dec_handle);
+  if (!decoder->parsed) {
+    return ESP_AUDIO_ERR_FAIL;
+  }
+  *info = decoder->info;
+  return ESP_AUDIO_ERR_OK;
+}
+
+void esp_audio_simple_dec_close(esp_audio_simple_dec_handle_t dec_handle) {
+  delete static_cast<WavDecoder *>(dec_handle);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#ifndef _HOST_ESP_CRT_BUNDLE_H_
+#define _HOST_ESP_CRT_BUNDLE_H_
+
+#include "esp_err.h"
+
+// The HTTP stand-in does no TLS, the bundle is never attached.
+inline esp_err_t esp_crt_bundle_attach(void *conf) {
+  return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#ifndef _HOST_ESP_ERR_H_
+#define _HOST_ESP_ERR_H_
+
+#include <cstdint>
+
+typedef int esp_err_t;
+
+#define ESP_OK (0)
+#define ESP_FAIL (-1)
+
+inline const char *esp_err_to_name(esp_err_t code) {
+  return code == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+#endif
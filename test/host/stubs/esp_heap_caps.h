@@ -0,0 +1,24 @@
+#pragma once
+
+#ifndef _HOST_ESP_HEAP_CAPS_H_
+#define _HOST_ESP_HEAP_CAPS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#define MALLOC_CAP_EXEC (1 << 0)
+#define MALLOC_CAP_32BIT (1 << 1)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+// Everything comes from the host heap, which counts as internal memory: the host has no PSRAM.
+void *heap_caps_malloc(const size_t size, const uint32_t caps);
+void *heap_caps_aligned_alloc(const size_t alignment, const size_t size, const uint32_t caps);
+void *heap_caps_realloc(void *ptr, const size_t size, const uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_total_size(const uint32_t caps);
+
+#endif
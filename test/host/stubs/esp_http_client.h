@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef _HOST_ESP_HTTP_CLIENT_H_
+#define _HOST_ESP_HTTP_CLIENT_H_
+
+#include <cstdint>
+
+#include "esp_err.h"
+
+// The subset of esp_http_client the library uses, served by the in-process stand-in of http_server_host.h.
+
+typedef struct HostHttpClient *esp_http_client_handle_t;
+
+struct esp_http_client_config_t {
+  const char *url;
+  int timeout_ms;
+  int buffer_size;
+  esp_err_t (*crt_bundle_attach)(void *conf);
+};
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+
+#endif
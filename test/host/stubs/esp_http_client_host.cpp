@@ -0,0 +1,127 @@
+#include <esp_http_client.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "http_server_host.h"
+
+namespace {
+std::mutex g_mutex;
+std::map<std::string, HostHttpResource> g_resources;
+}  // namespace
+
+struct HostHttpClient {
+  std::string url;
+  size_t range_start = 0;
+  HostHttpResource *resource = nullptr;
+  size_t position = 0;
+  int status_code = 0;
+  bool dropped = false;
+};
+
+HostHttpResource &HostHttpServe(const std::string &url, HostHttpResource resource) {
+  std::lock_guard lock(g_mutex);
+  return g_resources[url] = std::move(resource);
+}
+
+void HostHttpClear() {
+  std::lock_guard lock(g_mutex);
+  g_resources.clear();
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+  auto client = new HostHttpClient;
+  client->url = config->url;
+  return client;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value) {
+  size_t start = 0;
+  if (strcmp(key, "Range") == 0 && sscanf(value, "bytes=%zu-", &start) == 1) {
+    client->range_start = start;
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+  std::lock_guard lock(g_mutex);
+  auto it = g_resources.find(client->url);
+  if (it == g_resources.end()) {
+    client->status_code = 404;
+    return ESP_OK;
+  }
+  client->resource = &it->second;
+  ++client->resource->requests;
+  if (client->range_start > 0 && client->resource->ranges) {
+    client->status_code = 206;
+    client->position = std::min(client->range_start, client->resource->body.size());
+  } else {
+    client->status_code = 200;
+  }
+  return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+  if (client->resource == nullptr) {
+    return 0;
+  }
+  return client->resource->body.size() - client->position;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+  return client->status_code;
+}
+
+// Paces every read to the rate of the segment it starts in.
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len) {
+  uint32_t bytes_per_second = 0;
+  size_t count = 0;
+  {
+    std::lock_guard lock(g_mutex);
+    auto &resource = *client->resource;
+    size_t end = resource.body.size();
+    for (const auto &segment : resource.segments) {
+      if (client->position < segment.end) {
+        bytes_per_second = segment.bytes_per_second;
+        break;
+      }
+    }
+    for (auto drop = resource.drop_at.begin(); drop != resource.drop_at.end(); ++drop) {
+      if (*drop == client->position) {
+        resource.drop_at.erase(drop);
+        client->dropped = true;
+        return -1;
+      }
+      if (*drop > client->position) {
+        end = std::min(end, *drop);
+      }
+    }
+    count = std::min<size_t>(len, end - client->position);
+    std::memcpy(buffer, resource.body.data() + client->position, count);
+    client->position += count;
+  }
+
+  if (bytes_per_second > 0 && count > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(count * 1000000 / bytes_per_second));
+  }
+  return static_cast<int>(count);
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client) {
+  std::lock_guard lock(g_mutex);
+  return client->resource != nullptr && !client->dropped && client->position == client->resource->body.size();
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+  return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+  delete client;
+  return ESP_OK;
+}
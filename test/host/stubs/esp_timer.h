@@ -0,0 +1,11 @@
+#pragma once
+
+#ifndef _HOST_ESP_TIMER_H_
+#define _HOST_ESP_TIMER_H_
+
+#include <cstdint>
+
+// Microseconds since the process started.
+int64_t esp_timer_get_time();
+
+#endif
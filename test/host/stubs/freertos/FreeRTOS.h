@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+// Host stand-in for the parts of FreeRTOS the library uses. Tasks are threads, one tick is one millisecond.
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_attr.h"
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+struct StaticTask_t {
+  void *reserved;
+};
+
+#define configTICK_RATE_HZ (1000)
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY (static_cast<TickType_t>(0xffffffffUL))
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(static_cast<uint64_t>(ms) * configTICK_RATE_HZ / 1000))
+
+#define pdFALSE (static_cast<BaseType_t>(0))
+#define pdTRUE (static_cast<BaseType_t>(1))
+#define pdPASS (pdTRUE)
+#define pdFAIL (pdFALSE)
+
+#define tskIDLE_PRIORITY (static_cast<UBaseType_t>(0U))
+#define tskNO_AFFINITY (static_cast<BaseType_t>(0x7FFFFFFF))
+
+#define portYIELD_FROM_ISR(woken) (void)(woken)
+
+// The library's sources get these through the ESP-IDF include chain.
+#include "semphr.h"
+
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#ifndef _HOST_FREERTOS_SEMPHR_H_
+#define _HOST_FREERTOS_SEMPHR_H_
+
+#include "FreeRTOS.h"
+
+typedef struct HostSemaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateCounting(const UBaseType_t max_count, const UBaseType_t initial_count);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *task_woken);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, const TickType_t ticks);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif
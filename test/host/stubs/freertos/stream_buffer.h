@@ -0,0 +1,28 @@
+#pragma once
+
+#ifndef _HOST_FREERTOS_STREAM_BUFFER_H_
+#define _HOST_FREERTOS_STREAM_BUFFER_H_
+
+#include "FreeRTOS.h"
+
+typedef struct HostStreamBuffer *StreamBufferHandle_t;
+
+struct StaticStreamBuffer_t {
+  void *reserved;
+};
+
+StreamBufferHandle_t xStreamBufferCreate(const size_t size, const size_t trigger_level);
+// |storage| is not used, the host buffer allocates its own.
+StreamBufferHandle_t xStreamBufferCreateStatic(const size_t size, const size_t trigger_level, uint8_t *storage, StaticStreamBuffer_t *buffer);
+void vStreamBufferDelete(StreamBufferHandle_t stream);
+
+size_t xStreamBufferSend(StreamBufferHandle_t stream, const void *data, const size_t size, const TickType_t ticks);
+size_t xStreamBufferSendFromISR(StreamBufferHandle_t stream, const void *data, const size_t size, BaseType_t *task_woken);
+size_t xStreamBufferReceive(StreamBufferHandle_t stream, void *data, const size_t size, const TickType_t ticks);
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t stream);
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t stream);
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t stream);
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t stream);
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#ifndef _HOST_FREERTOS_TASK_H_
+#define _HOST_FREERTOS_TASK_H_
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct HostTask *TaskHandle_t;
+
+// The stack and task buffers are not used, every task is a detached thread.
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function,
+                                           const char *name,
+                                           const uint32_t stack_depth,
+                                           void *parameter,
+                                           UBaseType_t priority,
+                                           StackType_t *stack_buffer,
+                                           StaticTask_t *task_buffer,
+                                           const BaseType_t core_id);
+
+// Threads cannot be killed, a deleted task has to be blocked for good already, e.g. in vTaskDelay(portMAX_DELAY).
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(const TickType_t ticks);
+TickType_t xTaskGetTickCount();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+void taskYIELD();
+
+#endif
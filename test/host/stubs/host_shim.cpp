@@ -0,0 +1,254 @@
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+const auto kStartTime = std::chrono::steady_clock::now();
+
+// Waits on |condition| until |ready| holds or |ticks| have passed, returns |ready|.
+template <typename Predicate>
+bool WaitFor(std::condition_variable &condition, std::unique_lock<std::mutex> &lock, const TickType_t ticks, Predicate ready) {
+  if (ticks == portMAX_DELAY) {
+    condition.wait(lock, ready);
+    return true;
+  }
+  return condition.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), ready);
+}
+}  // namespace
+
+struct HostTask {};
+
+struct HostSemaphore {
+  std::mutex mutex;
+  std::condition_variable condition;
+  UBaseType_t count = 0;
+  UBaseType_t max_count = 1;
+};
+
+struct HostStreamBuffer {
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::vector<uint8_t> data;
+  size_t head = 0;  // next byte to read
+  size_t size = 0;  // bytes readable
+  size_t trigger_level = 1;
+};
+
+// Tasks.
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function,
+                                           const char *name,
+                                           const uint32_t stack_depth,
+                                           void *parameter,
+                                           UBaseType_t priority,
+                                           StackType_t *stack_buffer,
+                                           StaticTask_t *task_buffer,
+                                           const BaseType_t core_id) {
+  std::thread(function, parameter).detach();
+  return new HostTask;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  delete task;
+}
+
+void vTaskDelay(const TickType_t ticks) {
+  if (ticks == portMAX_DELAY) {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::unique_lock lock(mutex);
+    condition.wait(lock, []() { return false; });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+TickType_t xTaskGetTickCount() {
+  return static_cast<TickType_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - kStartTime).count() /
+                                 portTICK_PERIOD_MS);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return 0;
+}
+
+void taskYIELD() {
+  std::this_thread::yield();
+}
+
+// Semaphores.
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(const UBaseType_t max_count, const UBaseType_t initial_count) {
+  auto semaphore = new HostSemaphore;
+  semaphore->max_count = max_count;
+  semaphore->count = initial_count;
+  return semaphore;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  {
+    std::lock_guard lock(semaphore->mutex);
+    if (semaphore->count >= semaphore->max_count) {
+      return pdFALSE;
+    }
+    ++semaphore->count;
+  }
+  semaphore->condition.notify_one();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *task_woken) {
+  if (task_woken != nullptr) {
+    *task_woken = pdFALSE;
+  }
+  return xSemaphoreGive(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, const TickType_t ticks) {
+  std::unique_lock lock(semaphore->mutex);
+  if (!WaitFor(semaphore->condition, lock, ticks, [semaphore]() { return semaphore->count > 0; })) {
+    return pdFALSE;
+  }
+  --semaphore->count;
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+  delete semaphore;
+}
+
+// Stream buffers.
+
+StreamBufferHandle_t xStreamBufferCreate(const size_t size, const size_t trigger_level) {
+  auto stream = new HostStreamBuffer;
+  stream->data.resize(size);
+  stream->trigger_level = std::max<size_t>(trigger_level, 1);
+  return stream;
+}
+
+StreamBufferHandle_t xStreamBufferCreateStatic(const size_t size, const size_t trigger_level, uint8_t *storage, StaticStreamBuffer_t *buffer) {
+  return xStreamBufferCreate(size, trigger_level);
+}
+
+void vStreamBufferDelete(StreamBufferHandle_t stream) {
+  delete stream;
+}
+
+namespace {
+size_t Write(HostStreamBuffer *stream, const uint8_t *data, const size_t size) {
+  const auto capacity = stream->data.size();
+  const auto count = std::min(size, capacity - stream->size);
+  for (size_t i = 0; i < count; i++) {
+    stream->data[(stream->head + stream->size + i) % capacity] = data[i];
+  }
+  stream->size += count;
+  return count;
+}
+}  // namespace
+
+// Like FreeRTOS, waits for room for all of |size|, or a full buffer's worth if that is less, and writes what fits once
+// the wait times out.
+size_t xStreamBufferSend(StreamBufferHandle_t stream, const void *data, const size_t size, const TickType_t ticks) {
+  size_t sent = 0;
+  {
+    std::unique_lock lock(stream->mutex);
+    const auto required = std::min(size, stream->data.size());
+    WaitFor(stream->condition, lock, ticks, [stream, required]() { return stream->data.size() - stream->size >= required; });
+    sent = Write(stream, static_cast<const uint8_t *>(data), size);
+  }
+  stream->condition.notify_all();
+  return sent;
+}
+
+size_t xStreamBufferSendFromISR(StreamBufferHandle_t stream, const void *data, const size_t size, BaseType_t *task_woken) {
+  if (task_woken != nullptr) {
+    *task_woken = pdFALSE;
+  }
+  return xStreamBufferSend(stream, data, size, 0);
+}
+
+// Like FreeRTOS, waits until the trigger level is reached and returns what is there once the wait times out.
+size_t xStreamBufferReceive(StreamBufferHandle_t stream, void *data, const size_t size, const TickType_t ticks) {
+  size_t received = 0;
+  {
+    std::unique_lock lock(stream->mutex);
+    WaitFor(stream->condition, lock, ticks, [stream]() { return stream->size >= stream->trigger_level; });
+    const auto capacity = stream->data.size();
+    received = std::min(size, stream->size);
+    for (size_t i = 0; i < received; i++) {
+      static_cast<uint8_t *>(data)[i] = stream->data[(stream->head + i) % capacity];
+    }
+    stream->head = (stream->head + received) % capacity;
+    stream->size -= received;
+  }
+  stream->condition.notify_all();
+  return received;
+}
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t stream) {
+  {
+    std::lock_guard lock(stream->mutex);
+    stream->head = 0;
+    stream->size = 0;
+  }
+  stream->condition.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t stream) {
+  std::lock_guard lock(stream->mutex);
+  return stream->size == 0 ? pdTRUE : pdFALSE;
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t stream) {
+  std::lock_guard lock(stream->mutex);
+  return stream->size;
+}
+
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t stream) {
+  std::lock_guard lock(stream->mutex);
+  return stream->data.size() - stream->size;
+}
+
+// Heap.
+
+void *heap_caps_malloc(const size_t size, const uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) != 0 ? nullptr : std::malloc(size);
+}
+
+void *heap_caps_aligned_alloc(const size_t alignment, const size_t size, const uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) != 0 ? nullptr : std::aligned_alloc(alignment, size);
+}
+
+void *heap_caps_realloc(void *ptr, const size_t size, const uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) != 0 ? nullptr : std::realloc(ptr, size);
+}
+
+void heap_caps_free(void *ptr) {
+  std::free(ptr);
+}
+
+size_t heap_caps_get_total_size(const uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) != 0 ? 0 : 512 << 10;
+}
+
+// Timer.
+
+int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - kStartTime).count();
+}
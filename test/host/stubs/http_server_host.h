@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef _HOST_HTTP_SERVER_H_
+#define _HOST_HTTP_SERVER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the esp_http_client stand-in answers for one URL.
+struct HostHttpResource {
+  // The body up to |end| is delivered at |bytes_per_second|, 0 for as fast as it is read. Past the last segment the
+  // body comes as fast as it is read.
+  struct Segment {
+    size_t end = 0;
+    uint32_t bytes_per_second = 0;
+  };
+
+  std::vector<uint8_t> body;
+  std::vector<Segment> segments;
+  bool ranges = true;           // whether Range requests are honored, otherwise the whole body comes again with 200
+  std::vector<size_t> drop_at;  // offsets at which the connection is dropped, each once
+  size_t requests = 0;         // counted by the stand-in
+};
+
+// Serves |resource| at |url| until HostHttpClear(). Returns the served copy, to inspect its request count.
+HostHttpResource &HostHttpServe(const std::string &url, HostHttpResource resource);
+void HostHttpClear();
+
+#endif
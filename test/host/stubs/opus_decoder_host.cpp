@@ -0,0 +1,64 @@
+// Host stand-in for the Opus decoder of libopus, which the library links prebuilt for the ESP32 only. A packet is a
+// single byte holding its duration in ms and decodes to a ramp that continues from packet to packet, concealment
+// included, so a test can tell whether the decoded PCM reached the device untouched.
+
+#include <atomic>
+#include <cstdarg>
+
+#include "libopus/opus.h"
+#include "opus_host.h"
+
+namespace {
+std::atomic<int32_t> g_sample_rate = 0;
+}  // namespace
+
+struct OpusDecoder {
+  opus_int32 sample_rate = 0;
+  opus_int16 next_value = 0;
+};
+
+int32_t HostOpusDecoderSampleRate() {
+  return g_sample_rate;
+}
+
+OpusDecoder *opus_decoder_create(opus_int32 Fs, int channels, int *error) {
+  auto decoder = new OpusDecoder;
+  *error = opus_decoder_init(decoder, Fs, channels);
+  if (*error != OPUS_OK) {
+    delete decoder;
+    return nullptr;
+  }
+  return decoder;
+}
+
+int opus_decoder_init(OpusDecoder *st, opus_int32 Fs, int channels) {
+  if ((Fs != 8000 && Fs != 12000 && Fs != 16000 && Fs != 24000 && Fs != 48000) || channels != 1) {
+    return OPUS_BAD_ARG;
+  }
+  *st = {};
+  st->sample_rate = Fs;
+  g_sample_rate = Fs;
+  return OPUS_OK;
+}
+
+int opus_decode(OpusDecoder *st, const unsigned char *data, opus_int32 len, opus_int16 *pcm, int frame_size, int decode_fec) {
+  const int samples = data == nullptr ? frame_size : st->sample_rate / 1000 * data[0];
+  if (data != nullptr && len != 1) {
+    return OPUS_INVALID_PACKET;
+  }
+  if (samples > frame_size) {
+    return OPUS_BUFFER_TOO_SMALL;
+  }
+  for (int i = 0; i < samples; i++) {
+    pcm[i] = st->next_value++;
+  }
+  return samples;
+}
+
+int opus_decoder_ctl(OpusDecoder *st, int request, ...) {
+  return request == OPUS_RESET_STATE ? OPUS_OK : OPUS_UNIMPLEMENTED;
+}
+
+void opus_decoder_destroy(OpusDecoder *st) {
+  delete st;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#ifndef _HOST_OPUS_H_
+#define _HOST_OPUS_H_
+
+#include <cstdint>
+
+// The rate the Opus decoder stand-in was last created or initialized at.
+int32_t HostOpusDecoderSampleRate();
+
+// A packet for the Opus decoder stand-in that decodes to |duration| ms.
+inline uint8_t HostOpusPacket(const uint32_t duration) {
+  return static_cast<uint8_t>(duration);
+}
+
+#endif
@@ -0,0 +1,28 @@
+// Host stand-in for the SILK resampler of libopus, which the library links prebuilt for the ESP32 only. It keeps the
+// contract SilkResampler relies on, whole milliseconds in and out, and fails any other input length. Each output
+// sample is the nearest input sample, good enough to follow a signal through the wrapper.
+
+#include "libopus/opus_types.h"
+#include "libopus/resampler_structs.h"
+
+extern "C" opus_int silk_resampler_init(silk_resampler_state_struct *S, opus_int32 Fs_Hz_in, opus_int32 Fs_Hz_out, opus_int forEnc) {
+  if (Fs_Hz_in % 1000 != 0 || Fs_Hz_out % 1000 != 0 || Fs_Hz_in > 48000 || Fs_Hz_out > 48000) {
+    return -1;
+  }
+  *S = {};
+  S->Fs_in_kHz = Fs_Hz_in / 1000;
+  S->Fs_out_kHz = Fs_Hz_out / 1000;
+  return 0;
+}
+
+extern "C" opus_int silk_resampler(silk_resampler_state_struct *S, opus_int16 out[], const opus_int16 in[], opus_int32 inLen) {
+  if (S->Fs_in_kHz == 0 || inLen % S->Fs_in_kHz != 0) {
+    return -1;
+  }
+  for (opus_int32 ms = 0; ms < inLen / S->Fs_in_kHz; ms++) {
+    for (opus_int i = 0; i < S->Fs_out_kHz; i++) {
+      out[ms * S->Fs_out_kHz + i] = in[ms * S->Fs_in_kHz + i * S->Fs_in_kHz / S->Fs_out_kHz];
+    }
+  }
+  return 0;
+}
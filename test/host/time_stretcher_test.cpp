@@ -0,0 +1,110 @@
+#include "time_stretcher.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace {
+constexpr uint32_t kSampleRate = 16000;
+constexpr size_t kFrameSamples = kSampleRate / 1000 * 60;
+
+std::vector<int16_t> Sine(const float frequency, const size_t samples) {
+  std::vector<int16_t> pcm(samples);
+  for (size_t i = 0; i < samples; i++) {
+    pcm[i] = static_cast<int16_t>(std::lround(12000 * std::sin(2 * M_PI * frequency * i / kSampleRate)));
+  }
+  return pcm;
+}
+
+FlexArray<int16_t> Frame(const std::vector<int16_t> &pcm, const size_t offset) {
+  FlexArray<int16_t> frame(kFrameSamples);
+  std::copy(pcm.begin() + offset, pcm.begin() + offset + kFrameSamples, frame.data());
+  return frame;
+}
+
+// Feeds |pcm| frame by frame at |speed|, then flushes.
+std::vector<int16_t> Stretch(TimeStretcher &stretcher, const std::vector<int16_t> &pcm, const uint32_t speed) {
+  std::vector<int16_t> output;
+  for (size_t offset = 0; offset + kFrameSamples <= pcm.size(); offset += kFrameSamples) {
+    const auto stretched = stretcher.Process(Frame(pcm, offset), speed);
+    output.insert(output.end(), stretched.data(), stretched.data() + stretched.size());
+  }
+  const auto rest = stretcher.Flush();
+  output.insert(output.end(), rest.data(), rest.data() + rest.size());
+  return output;
+}
+
+// Frequency from the rate of upward zero crossings.
+double Frequency(const std::vector<int16_t> &pcm) {
+  size_t crossings = 0;
+  for (size_t i = 1; i < pcm.size(); i++) {
+    if (pcm[i - 1] < 0 && pcm[i] >= 0) {
+      ++crossings;
+    }
+  }
+  return static_cast<double>(crossings) * kSampleRate / pcm.size();
+}
+}  // namespace
+
+TEST(TimeStretcherTest, PassesThroughAtNormalSpeed) {
+  TimeStretcher stretcher(kSampleRate);
+  const auto pcm = Sine(440, kFrameSamples * 4);
+  for (size_t offset = 0; offset < pcm.size(); offset += kFrameSamples) {
+    const auto output = stretcher.Process(Frame(pcm, offset), 100);
+    ASSERT_EQ(output.size(), kFrameSamples);
+    EXPECT_TRUE(std::equal(output.data(), output.data() + output.size(), pcm.begin() + offset));
+  }
+  EXPECT_EQ(stretcher.Flush().size(), 0u);
+}
+
+class TimeStretcherSpeedTest : public testing::TestWithParam<uint32_t> {};
+
+TEST_P(TimeStretcherSpeedTest, ChangesTheDurationButNotThePitch) {
+  const auto speed = GetParam();
+  TimeStretcher stretcher(kSampleRate);
+  const auto pcm = Sine(1000, kSampleRate * 5 / kFrameSamples * kFrameSamples);
+  const auto output = Stretch(stretcher, pcm, speed);
+
+  const double expected = static_cast<double>(pcm.size()) * 100 / speed;
+  EXPECT_NEAR(output.size(), expected, expected * 0.02) << "at " << speed << " %";
+  EXPECT_NEAR(Frequency(output), 1000, 20) << "at " << speed << " %";
+}
+
+INSTANTIATE_TEST_SUITE_P(Speeds, TimeStretcherSpeedTest, testing::Values(50, 80, 125, 150, 200));
+
+TEST(TimeStretcherTest, ReturnsToPassThroughWithoutLosingSamples) {
+  TimeStretcher stretcher(kSampleRate);
+  const auto pcm = Sine(440, kFrameSamples * 20);
+  size_t produced = 0;
+  for (size_t i = 0; i < 20; i++) {
+    // A catch-up burst in the middle.
+    produced += stretcher.Process(Frame(pcm, i * kFrameSamples), i >= 5 && i < 10 ? 150 : 100).size();
+  }
+  produced += stretcher.Flush().size();
+
+  const double expected = kFrameSamples * 15 + kFrameSamples * 5 * 100.0 / 150;
+  EXPECT_NEAR(produced, expected, kFrameSamples / 2);
+}
+
+TEST(TimeStretcherTest, ResetDropsTheHeldBackInput) {
+  TimeStretcher stretcher(kSampleRate);
+  const auto pcm = Sine(440, kFrameSamples * 2);
+  stretcher.Process(Frame(pcm, 0), 150);
+  stretcher.Reset();
+
+  const auto output = stretcher.Process(Frame(pcm, kFrameSamples), 100);
+  ASSERT_EQ(output.size(), kFrameSamples);
+  EXPECT_TRUE(std::equal(output.data(), output.data() + output.size(), pcm.begin() + kFrameSamples));
+}
+
+// Not a pass/fail check: host time per second of speech at 150 %, reported as a test property.
+TEST(TimeStretcherTest, Benchmark) {
+  TimeStretcher stretcher(kSampleRate);
+  const auto pcm = Sine(220, kSampleRate * 20 / kFrameSamples * kFrameSamples);
+  const auto start = std::chrono::steady_clock::now();
+  Stretch(stretcher, pcm, 150);
+  const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  RecordProperty("us_per_second_of_speech", std::to_string(static_cast<int64_t>(elapsed * kSampleRate / pcm.size())));
+}